@@ -0,0 +1,129 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <thread>
+
+#include <unistd.h>
+
+BenchmarkRunner::BenchmarkRunner(double minSeconds, const std::string& filter) : minSeconds(minSeconds) {
+    std::stringstream list {filter};
+    std::string item;
+
+    while (std::getline(list, item, ',')) {
+        if (!item.empty()) filters.push_back(item);
+    }
+}
+
+static double timeBatch(const std::function<void()>& body, uint64_t iterations) {
+    auto start = std::chrono::steady_clock::now();
+
+    for (uint64_t i = 0; i < iterations; i++) body();
+
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+void BenchmarkRunner::run(const std::string& group, const std::string& name, uint64_t bytes, uint64_t items, const std::function<void()>& body) {
+    std::string fullName = group + "/" + name;
+
+    if (!filters.empty() && std::none_of(filters.begin(), filters.end(), [&](const std::string& filter) {
+        return fullName.find(filter) != std::string::npos;
+    })) return;
+
+    double batchTarget = minSeconds * 1e9 / REPETITIONS;
+    uint64_t iterations = 1;
+    double elapsed = timeBatch(body, iterations);
+
+    // the first call also warms the caches up, it is never kept
+    while (elapsed < batchTarget) {
+        double scale = elapsed > 0 ? batchTarget / elapsed : 100;
+        iterations = std::max<uint64_t>(iterations + 1, (uint64_t) ((double) iterations * std::min(scale * 1.2, 100.0)));
+        elapsed = timeBatch(body, iterations);
+    }
+
+    double best = elapsed / (double) iterations;
+
+    for (size_t i = 1; i < REPETITIONS; i++) {
+        best = std::min(best, timeBatch(body, iterations) / (double) iterations);
+    }
+
+    results.push_back(BenchmarkResult{ group, name, iterations, best, bytes, items });
+
+    const BenchmarkResult& result = results.back();
+    fprintf(stderr, "%-12s %-36s %12.3f ns/offset %9.3f GB/s\n", group.c_str(), name.c_str(), result.nsPerItem(), result.gigabytesPerSecond());
+}
+
+json BenchmarkRunner::toJson() const {
+    json entries = json::array();
+
+    for (const BenchmarkResult& result : results) {
+        entries.push_back({
+            { "group", result.group },
+            { "name", result.name },
+            { "iterations", result.iterations },
+            { "ns_per_iteration", result.nsPerIteration },
+            { "bytes_per_iteration", result.bytesPerIteration },
+            { "items_per_iteration", result.itemsPerIteration },
+            { "ns_per_item", result.nsPerItem() },
+            { "gb_per_second", result.gigabytesPerSecond() }
+        });
+    }
+
+    return { { "machine", machineInfo() }, { "results", entries } };
+}
+
+void BenchmarkRunner::printTable(std::ostream& out) const {
+    char line[128];
+
+    snprintf(line, sizeof(line), "%-12s %-36s %14s %10s\n", "group", "name", "ns/offset", "GB/s");
+    out << line;
+
+    for (const BenchmarkResult& result : results) {
+        snprintf(line, sizeof(line), "%-12s %-36s %14.3f %10.3f\n", result.group.c_str(), result.name.c_str(), result.nsPerItem(), result.gigabytesPerSecond());
+        out << line;
+    }
+}
+
+std::vector<BenchmarkRegression> BenchmarkRunner::findRegressions(const json& baseline, double tolerance, size_t& compared) const {
+    std::vector<BenchmarkRegression> regressions;
+    compared = 0;
+
+    if (!baseline.contains("results")) return regressions;
+
+    for (const BenchmarkResult& result : results) {
+        for (const json& entry : baseline["results"]) {
+            if (entry.value("group", "") != result.group || entry.value("name", "") != result.name) continue;
+
+            double previous = entry.value("ns_per_item", 0.0);
+            if (previous <= 0) continue;
+
+            compared++;
+
+            if (result.nsPerItem() > previous * (1 + tolerance)) {
+                regressions.push_back(BenchmarkRegression{ result.group + "/" + result.name, previous, result.nsPerItem() });
+            }
+        }
+    }
+
+    return regressions;
+}
+
+json BenchmarkRunner::machineInfo() {
+    char host[256] = {};
+    gethostname(host, sizeof(host) - 1);
+
+#ifdef NDEBUG
+    const char* buildType = "release";
+#else
+    const char* buildType = "debug";
+#endif
+
+    return {
+        { "host", host },
+        { "cores", std::thread::hardware_concurrency() },
+        { "compiler", __VERSION__ },
+        { "build", buildType }
+    };
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "../lib/json.h"
+
+using json = nlohmann::json;
+
+struct BenchmarkResult {
+    std::string group;
+    std::string name;
+    uint64_t iterations;
+    double nsPerIteration;
+    // bytes and offsets covered by one iteration, used for the throughput
+    uint64_t bytesPerIteration;
+    uint64_t itemsPerIteration;
+
+    double nsPerItem() const { return itemsPerIteration > 0 ? nsPerIteration / (double) itemsPerIteration : 0; }
+    double gigabytesPerSecond() const { return nsPerIteration > 0 ? (double) bytesPerIteration / nsPerIteration : 0; }
+};
+
+struct BenchmarkRegression {
+    std::string name;
+    double baselineNsPerItem;
+    double currentNsPerItem;
+};
+
+// Minimal benchmark harness: every case runs in batches grown until a batch lasts a fraction of
+// the minimum time, the fastest of a few batches is kept to filter out scheduling noise.
+class BenchmarkRunner {
+public:
+    static constexpr size_t REPETITIONS = 3;
+
+    // the filter is a comma separated list, a case runs when "group/name" contains one of them
+    explicit BenchmarkRunner(double minSeconds = 0.3, const std::string& filter = "");
+
+    void run(const std::string& group, const std::string& name, uint64_t bytes, uint64_t items, const std::function<void()>& body);
+
+    const std::vector<BenchmarkResult>& getResults() const { return results; }
+
+    json toJson() const;
+    void printTable(std::ostream& out) const;
+
+    // cases slower per item than in a previous toJson() by more than tolerance (0.1 for 10 %),
+    // cases missing from the baseline are not compared, compared counts the others
+    std::vector<BenchmarkRegression> findRegressions(const json& baseline, double tolerance, size_t& compared) const;
+
+    // host, cores, compiler and build type, so that runs from different machines are not mixed up
+    static json machineInfo();
+
+private:
+    double minSeconds;
+    std::vector<std::string> filters;
+    std::vector<BenchmarkResult> results;
+};
+
+// keeps the compiler from dropping a computation whose result is otherwise unused
+template<typename T>
+inline void doNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
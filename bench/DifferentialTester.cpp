@@ -0,0 +1,883 @@
+#include "DifferentialTester.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <dirent.h>
+#include <unistd.h>
+
+#include "../scanner/ByteExporter.h"
+#include "../scanner/CompressedInput.h"
+#include "../scanner/ResultWriter.h"
+#include "../scanner/Scanner.h"
+#include "../scanner/StreamScanner.h"
+#include "../scanner/StructureParser.h"
+#include "../process/Snapshot.h"
+
+#include "DumpGenerator.h"
+
+#ifdef WALKER_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef WALKER_HAVE_LZ4
+#include <lz4.h>
+#endif
+
+#ifdef WALKER_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+static constexpr size_t DIFF_THREADS = 4;
+static constexpr size_t MAX_FIELDS = 4;
+static constexpr size_t MAX_DYNAMIC_SIZE = 8;
+static constexpr size_t MAX_COMPRESSED_BLOCK = 64;
+static constexpr size_t MAX_SNAPSHOT_REGIONS = 8;
+
+static std::string hexOffset(uint64_t offset) {
+    char text[24];
+    snprintf(text, sizeof(text), "0x%lx", (unsigned long) offset);
+    return text;
+}
+
+// first offset found by one side only, described for the failure message
+static std::string describeDifference(const std::vector<uint64_t>& expected, const std::vector<uint64_t>& actual) {
+    std::vector<uint64_t> missing, unexpected;
+
+    std::set_difference(expected.begin(), expected.end(), actual.begin(), actual.end(), std::back_inserter(missing));
+    std::set_difference(actual.begin(), actual.end(), expected.begin(), expected.end(), std::back_inserter(unexpected));
+
+    std::string reason = std::to_string(actual.size()) + " results instead of " + std::to_string(expected.size());
+    if (!missing.empty()) reason += ", missing " + hexOffset(missing[0]);
+    if (!unexpected.empty()) reason += ", unexpected " + hexOffset(unexpected[0]);
+
+    return reason;
+}
+
+// the value index only holds values aligned to their own size, so only matches where every field it
+// could look up is aligned are sure to be found
+static bool isIndexAligned(const CompiledStructure& structure, const DiffCase&, uint64_t offset) {
+    const std::vector<ScannerField>& fields = structure.getFields();
+
+    for (size_t i = 0; i < fields.size(); i++) {
+        size_t width;
+
+        switch (fields[i].primitive) {
+            case SCANNER_PRIMITIVE_UINT32:
+            case SCANNER_PRIMITIVE_INT32:
+                width = 4;
+                break;
+            case SCANNER_PRIMITIVE_UINT64:
+            case SCANNER_PRIMITIVE_INT64:
+            case SCANNER_PRIMITIVE_POINTER:
+                width = 8;
+                break;
+            default:
+                continue;
+        }
+
+        if ((offset + structure.getLayout().getFieldOffset(i)) % width != 0) return false;
+    }
+
+    return true;
+}
+
+[[maybe_unused]] static void appendLittle32(std::vector<char>& output, uint32_t value) {
+    for (size_t i = 0; i < 4; i++) output.push_back((char) (value >> (8 * i)));
+}
+
+// the formats this build can decompress
+static std::vector<CompressedFormat> compressedFormats() {
+    std::vector<CompressedFormat> formats;
+
+    for (const auto& details : COMPRESSED_FORMAT_DETAILS) {
+        if (CompressedInput::isSupported(std::get<CompressedFormat>(details))) formats.push_back(std::get<CompressedFormat>(details));
+    }
+
+    return formats;
+}
+
+// compresses every blockSize bytes on their own: BGZF members, zstd frames, or the blocks of an LZ4
+// frame. With variant, zstd frames leave out their size and are followed by a seek table, and LZ4
+// blocks refer to the previous ones so the frame is decompressed by a single thread. The cases are
+// those of the libraries this build has, possibly none.
+static bool compressBlocks(CompressedFormat format, [[maybe_unused]] const std::vector<char>& data, [[maybe_unused]] size_t blockSize,
+                           [[maybe_unused]] bool variant, [[maybe_unused]] std::vector<char>& output) {
+    switch (format) {
+#ifdef WALKER_HAVE_ZLIB
+        case COMPRESSED_FORMAT_GZIP: {
+            for (size_t offset = 0; offset < data.size(); offset += blockSize) {
+                size_t length = std::min(blockSize, data.size() - offset);
+                z_stream stream{};
+
+                if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) return false;
+
+                std::vector<char> deflated(deflateBound(&stream, length));
+                stream.next_in = (Bytef*) data.data() + offset;
+                stream.avail_in = (uInt) length;
+                stream.next_out = (Bytef*) deflated.data();
+                stream.avail_out = (uInt) deflated.size();
+
+                int status = deflate(&stream, Z_FINISH);
+                deflated.resize(deflated.size() - stream.avail_out);
+                deflateEnd(&stream);
+
+                if (status != Z_STREAM_END) return false;
+
+                // gzip header with a BC extra field holding the member size minus one
+                size_t memberSize = 18 + deflated.size() + 8;
+                const char header[] = { 0x1F, (char) 0x8B, 8, 4, 0, 0, 0, 0, 0, (char) 0xFF, 6, 0, 'B', 'C', 2, 0,
+                                        (char) (memberSize - 1), (char) ((memberSize - 1) >> 8) };
+
+                output.insert(output.end(), header, header + sizeof(header));
+                output.insert(output.end(), deflated.begin(), deflated.end());
+                appendLittle32(output, (uint32_t) crc32(0, (const Bytef*) data.data() + offset, (uInt) length));
+                appendLittle32(output, (uint32_t) length);
+            }
+
+            return true;
+        }
+#endif
+#ifdef WALKER_HAVE_ZSTD
+        case COMPRESSED_FORMAT_ZSTD: {
+            ZSTD_CCtx* context = ZSTD_createCCtx();
+            if (context == nullptr) return false;
+
+            ZSTD_CCtx_setParameter(context, ZSTD_c_contentSizeFlag, variant ? 0 : 1);
+
+            std::vector<std::pair<uint32_t, uint32_t>> frames;
+            bool success = true;
+
+            for (size_t offset = 0; offset < data.size() && success; offset += blockSize) {
+                size_t length = std::min(blockSize, data.size() - offset);
+                size_t start = output.size();
+
+                output.resize(start + ZSTD_compressBound(length));
+                size_t frameSize = ZSTD_compress2(context, output.data() + start, output.size() - start, data.data() + offset, length);
+
+                success = !ZSTD_isError(frameSize);
+                output.resize(success ? start + frameSize : start);
+                frames.emplace_back((uint32_t) frameSize, (uint32_t) length);
+            }
+
+            ZSTD_freeCCtx(context);
+
+            // seek table: a skippable frame of (compressed, decompressed) sizes, the count, a descriptor and the magic
+            if (success && variant) {
+                appendLittle32(output, 0x184D2A5E);
+                appendLittle32(output, (uint32_t) (frames.size() * 8 + 9));
+
+                for (const auto& frame : frames) {
+                    appendLittle32(output, frame.first);
+                    appendLittle32(output, frame.second);
+                }
+
+                appendLittle32(output, (uint32_t) frames.size());
+                output.push_back(0);
+                appendLittle32(output, 0x8F92EAB1);
+            }
+
+            return success;
+        }
+#endif
+#ifdef WALKER_HAVE_LZ4
+        case COMPRESSED_FORMAT_LZ4: {
+            // frame descriptor: version 1, independent blocks unless variant, 64 KiB blocks, and a
+            // header checksum the reader does not verify
+            appendLittle32(output, 0x184D2204);
+            output.push_back(variant ? 0x40 : 0x60);
+            output.push_back(0x40);
+            output.push_back(0);
+
+            LZ4_stream_t* stream = LZ4_createStream();
+            if (stream == nullptr) return false;
+
+            std::vector<char> compressed(LZ4_compressBound((int) blockSize));
+
+            for (size_t offset = 0; offset < data.size(); offset += blockSize) {
+                int length = (int) std::min(blockSize, data.size() - offset);
+                if (!variant) LZ4_resetStream_fast(stream);
+
+                // the previous blocks stay in data, where the linked blocks refer to them
+                int compressedSize = LZ4_compress_fast_continue(stream, data.data() + offset, compressed.data(), length, (int) compressed.size(), 1);
+
+                if (compressedSize > 0 && compressedSize < length) {
+                    appendLittle32(output, (uint32_t) compressedSize);
+                    output.insert(output.end(), compressed.begin(), compressed.begin() + compressedSize);
+                } else {
+                    appendLittle32(output, (uint32_t) length | 0x80000000);
+                    output.insert(output.end(), data.begin() + (long) offset, data.begin() + (long) offset + length);
+                }
+            }
+
+            LZ4_freeStream(stream);
+            appendLittle32(output, 0);
+
+            return true;
+        }
+#endif
+        default:
+            return false;
+    }
+}
+
+// the case compressed in the format and blocks of a few bytes its engine seed picks, false when
+// this build cannot compress at all
+static bool compressCase(const DiffCase& testCase, std::vector<char>& compressed) {
+    std::vector<CompressedFormat> formats = compressedFormats();
+    if (formats.empty()) return false;
+
+    CompressedFormat format = formats[testCase.engineSeed % formats.size()];
+    size_t blockSize = 1 + (testCase.engineSeed >> 8) % MAX_COMPRESSED_BLOCK;
+
+    return compressBlocks(format, testCase.data, blockSize, (testCase.engineSeed >> 16) % 2 != 0, compressed);
+}
+
+// the case cut in up to MAX_SNAPSHOT_REGIONS regions, spread over the address space with gaps
+static std::vector<SnapshotRegion> snapshotRegions(const DiffCase& testCase) {
+    std::mt19937_64 cuts {~testCase.engineSeed};
+    std::vector<uint64_t> bounds = { 0, testCase.data.size() };
+
+    for (size_t i = cuts() % MAX_SNAPSHOT_REGIONS; i > 0; i--) bounds.push_back(cuts() % (testCase.data.size() + 1));
+
+    std::sort(bounds.begin(), bounds.end());
+    bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+
+    std::vector<SnapshotRegion> regions;
+    uint64_t address = 0x00007F3A11000000;
+
+    for (size_t i = 0; i + 1 < bounds.size(); i++) {
+        SnapshotRegion region{};
+        region.start = address;
+        region.end = address + (bounds[i + 1] - bounds[i]);
+        region.flatOffset = bounds[i];
+        regions.push_back(region);
+
+        address = region.end + 0x1000 * (1 + cuts() % 16);
+    }
+
+    return regions;
+}
+
+// a result of the snapshot scan is kept when all its bytes are in a single region
+static bool isInOneRegion(const CompiledStructure& structure, const DiffCase& testCase, uint64_t offset) {
+    for (const SnapshotRegion& region : snapshotRegions(testCase)) {
+        if (offset >= region.flatOffset && offset + structure.getSize() <= region.flatOffset + (region.end - region.start)) return true;
+    }
+
+    return false;
+}
+
+// removes the files of a directory, then the directory
+static void removeDirectory(const std::string& path) {
+    DIR* directory = opendir(path.c_str());
+
+    if (directory != nullptr) {
+        while (dirent* entry = readdir(directory)) {
+            if (entry->d_type != DT_DIR) unlink((path + "/" + entry->d_name).c_str());
+        }
+
+        closedir(directory);
+    }
+
+    rmdir(path.c_str());
+}
+
+DifferentialTester::DifferentialTester(uint64_t seed, size_t maxSize, std::string workDirectory)
+    : random(seed), maxSize(maxSize), workDirectory(std::move(workDirectory)), pool(DIFF_THREADS) {
+    dumpPath = this->workDirectory + "/walker_diff_" + std::to_string(getpid()) + ".bin";
+    exportPath = this->workDirectory + "/walker_diff_" + std::to_string(getpid()) + ".export";
+
+    // creates the work directory too, run fails when it could not
+    cache = std::make_unique<ResultCache>(this->workDirectory + "/walker_diff_cache_" + std::to_string(getpid()));
+
+    engines.push_back(Engine{ "compiled", [](const std::shared_ptr<const CompiledStructure>& structure, const DiffCase& testCase, ResultSink& sink) {
+        structure->scan(testCase.data.data(), testCase.data.size(), sink);
+        return true;
+    }, nullptr, nullptr, false });
+
+    engines.push_back(Engine{ "scanner", [](const std::shared_ptr<const CompiledStructure>& structure, const DiffCase& testCase, ResultSink& sink) {
+        Scanner scanner;
+        scanner.setStructure(structure);
+        scanner.setView((const uint8_t*) testCase.data.data(), testCase.data.size());
+        scanner.scan(sink);
+        return true;
+    }, nullptr, nullptr, false });
+
+    // chunks of a few bytes, so structures straddle many chunk boundaries
+    engines.push_back(Engine{ "parallel", [this](const std::shared_ptr<const CompiledStructure>& structure, const DiffCase& testCase, ResultSink& sink) {
+        Scanner scanner;
+        scanner.setStructure(structure);
+        scanner.setView((const uint8_t*) testCase.data.data(), testCase.data.size());
+        scanner.setThreadPool(&pool, 1 + testCase.engineSeed % 64);
+        scanner.scan(sink);
+        return true;
+    }, nullptr, nullptr, false });
+
+    // with progress a single thread scans in chunks too
+    engines.push_back(Engine{ "progress", [](const std::shared_ptr<const CompiledStructure>& structure, const DiffCase& testCase, ResultSink& sink) {
+        ScanProgress progress;
+        Scanner scanner;
+        scanner.setStructure(structure);
+        scanner.setView((const uint8_t*) testCase.data.data(), testCase.data.size());
+        scanner.setThreadPool(nullptr, 1 + testCase.engineSeed % 64);
+        scanner.setProgress(&progress);
+        scanner.scan(sink);
+        return true;
+    }, nullptr, nullptr, false });
+
+    engines.push_back(Engine{ "stream", [](const std::shared_ptr<const CompiledStructure>& structure, const DiffCase& testCase, ResultSink& sink) {
+        std::mt19937_64 pieces {testCase.engineSeed};
+        StreamScanner stream {structure, sink};
+        size_t maxPiece = 2 * structure->getSize() + 8;
+
+        for (size_t offset = 0; offset < testCase.data.size();) {
+            size_t length = std::min<size_t>(1 + pieces() % maxPiece, testCase.data.size() - offset);
+            if (!stream.feed(testCase.data.data() + offset, length)) break;
+            offset += length;
+        }
+
+        return true;
+    }, nullptr, nullptr, false });
+
+    engines.push_back(Engine{ "value-index", [this](const std::shared_ptr<const CompiledStructure>& structure, const DiffCase&, ResultSink& sink) {
+        size_t candidates = 0;
+        return valueIndex->scan(*structure, (const char*) dump->data(), dump->size(), sink, candidates);
+    }, nullptr, isIndexAligned, true });
+
+    engines.push_back(Engine{ "suffix-index", [this](const std::shared_ptr<const CompiledStructure>& structure, const DiffCase&, ResultSink& sink) {
+        size_t candidates = 0;
+        return suffixIndex->scan(*structure, (const char*) dump->data(), dump->size(), sink, candidates);
+    }, nullptr, nullptr, true });
+
+    // blocks of a few bytes, so structures straddle many of them and the decompressed pieces
+    engines.push_back(Engine{ "compressed", [this](const std::shared_ptr<const CompiledStructure>& structure, const DiffCase& testCase, ResultSink& sink) {
+        std::vector<char> compressed;
+        if (!compressCase(testCase, compressed)) return false;
+
+        CompressedInput input {(const uint8_t*) compressed.data(), compressed.size(), &pool};
+        StreamScanner stream {structure, sink};
+
+        input.read([&stream](const char* data, size_t size) {
+            return stream.feed(data, size);
+        });
+
+        return true;
+    }, nullptr, nullptr, false });
+
+    // the exported bytes of a compressed case are only in the decompressed pieces while they are scanned
+    engines.push_back(Engine{ "compressed-export", [this](const std::shared_ptr<const CompiledStructure>& structure, const DiffCase& testCase, ResultSink& sink) {
+        std::vector<char> compressed;
+        if (!compressCase(testCase, compressed)) return false;
+
+        std::vector<uint64_t> offsets;
+        ByteExporter exporter {exportPath};
+        if (!exporter.isOpen()) return false;
+
+        CallbackSink both {[&](const ScannerResult& result) {
+            offsets.push_back(result.offset);
+            bool exporting = exporter.push(result);
+            return sink.push(result) && exporting;
+        }};
+
+        CompressedInput input {(const uint8_t*) compressed.data(), compressed.size(), &pool};
+        StreamScanner stream {structure, both};
+
+        input.read([&stream](const char* data, size_t size) {
+            return stream.feed(data, size);
+        });
+
+        if (!exporter.close()) {
+            engineError = "the bytes could not be exported";
+            return true;
+        }
+
+        std::ifstream file {exportPath, std::ios::binary};
+        std::string exported {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+        std::string matched;
+
+        for (uint64_t offset : offsets) matched.append(testCase.data.data() + offset, structure->getSize());
+
+        if (exported.size() != matched.size()) {
+            engineError = std::to_string(exported.size()) + " bytes exported instead of the " + std::to_string(matched.size()) + " matched";
+        } else if (exported != matched) {
+            engineError = "the exported bytes are not the matched ones";
+        }
+
+        return true;
+    }, nullptr, nullptr, false });
+
+    // the cache holds the results of a previous version, a few bytes away from the case and of
+    // another size, and rebuilds the case from them with chunks of a few bytes
+    engines.push_back(Engine{ "incremental", [this](const std::shared_ptr<const CompiledStructure>& structure, const DiffCase& testCase, ResultSink& sink) {
+        std::mt19937_64 changes {testCase.engineSeed};
+        std::vector<char> previousData = testCase.data;
+
+        previousData.resize(changes() % 2 ? previousData.size() + changes() % 16 : previousData.size() - std::min<size_t>(previousData.size(), changes() % 16));
+
+        for (size_t i = changes() % 4; i > 0 && !previousData.empty(); i--) {
+            previousData[changes() % previousData.size()] ^= (char) (1 + changes() % 255);
+        }
+
+        size_t chunkSize = 1 + changes() % 32;
+        ChunkTree previous = ChunkTree::build((const uint8_t*) previousData.data(), previousData.size(), nullptr, chunkSize);
+        ChunkTree current = ChunkTree::build(dump->data(), dump->size(), nullptr, chunkSize);
+        uint64_t structureHash = ResultCache::hashStructure(*structure);
+
+        if (previous.empty()) return false;
+
+        {
+            ResultWriter writer {cache->temporaryPath(previous.getRoot(), structureHash), RESULT_FORMAT_BINARY, structure->getFields()};
+            WriterSink output {writer};
+
+            Scanner scanner;
+            scanner.setStructure(structure);
+            scanner.setView((const uint8_t*) previousData.data(), previousData.size());
+            scanner.scanReference(output);
+
+            if (!writer.isOpen() || !writer.close() || !cache->commit(previous.getRoot(), structureHash)) return false;
+        }
+
+        size_t rescanned = 0;
+        return cache->loadIncremental(structureHash, previous, current, *structure, *dump, sink, rescanned);
+    }, nullptr, nullptr, true });
+
+    // chunks of a few bytes, results straddling two regions are dropped by the address sink
+    engines.push_back(Engine{ "snapshot-addresses", [this](const std::shared_ptr<const CompiledStructure>& structure, const DiffCase& testCase, ResultSink& sink) {
+        std::vector<SnapshotRegion> regions = snapshotRegions(testCase);
+        if (regions.empty()) return false;
+
+        // back to flat offsets, to compare with the reference loop
+        CallbackSink flat {[&](const ScannerResult& result) {
+            auto region = std::upper_bound(regions.begin(), regions.end(), result.offset, [](uint64_t address, const SnapshotRegion& candidate) {
+                return address < candidate.start;
+            }) - 1;
+
+            return sink.push(ScannerResult{ result.valueSize, region->flatOffset + (result.offset - region->start), result.value });
+        }};
+
+        SnapshotAddressSink addresses {regions, flat};
+
+        Scanner scanner;
+        scanner.setStructure(structure);
+        scanner.setView((const uint8_t*) testCase.data.data(), testCase.data.size());
+        scanner.setThreadPool(&pool, 1 + testCase.engineSeed % 64);
+        scanner.scan(addresses);
+
+        return true;
+    }, isInOneRegion, nullptr, false });
+}
+
+DifferentialTester::~DifferentialTester() {
+    dump.reset();
+    unlink(dumpPath.c_str());
+    unlink((dumpPath + VALUE_INDEX_EXTENSION).c_str());
+    unlink((dumpPath + SUFFIX_INDEX_EXTENSION).c_str());
+    unlink(exportPath.c_str());
+
+    removeDirectory(cache->getDirectory() + "/fingerprints");
+    removeDirectory(cache->getDirectory());
+}
+
+bool DifferentialTester::run(size_t cases, DiffFailure& failure) {
+    if (!cache->isOpen()) {
+        failure = DiffFailure{ "", "cannot create the work directory " + workDirectory, DiffCase{} };
+        return false;
+    }
+
+    for (size_t i = 0; i < cases; i++) {
+        DiffCase testCase = generate();
+
+        if (check(testCase, "", failure)) continue;
+
+        // the work directory is not usable, there is nothing to shrink
+        if (failure.engine.empty()) return false;
+
+        failure.testCase = shrink(failure);
+        check(failure.testCase, failure.engine, failure);
+
+        return false;
+    }
+
+    return true;
+}
+
+json DifferentialTester::generateValue(ScannerPrimitive primitive, size_t size) {
+    // boundaries and small values come up often, so comparisons go both ways in the generated dumps
+    bool small = random() % 2 == 0;
+    bool boundary = random() % 8 == 0;
+
+    switch (primitive) {
+        case SCANNER_PRIMITIVE_UINT8:
+            return boundary ? (random() % 2 ? UINT8_MAX : 0) : (uint8_t) random();
+        case SCANNER_PRIMITIVE_UINT16:
+            return boundary ? (random() % 2 ? UINT16_MAX : 0) : small ? random() % 1024 : (uint16_t) random();
+        case SCANNER_PRIMITIVE_UINT32:
+            return boundary ? (random() % 2 ? UINT32_MAX : 0) : small ? random() % 1024 : (uint32_t) random();
+        case SCANNER_PRIMITIVE_UINT64:
+            return boundary ? (random() % 2 ? UINT64_MAX : 0) : small ? random() % 1024 : random();
+        case SCANNER_PRIMITIVE_INT8:
+            return boundary ? (random() % 2 ? INT8_MAX : INT8_MIN) : (int8_t) random();
+        case SCANNER_PRIMITIVE_INT16:
+            return boundary ? (random() % 2 ? INT16_MAX : INT16_MIN) : small ? (int64_t) (random() % 2048) - 1024 : (int16_t) random();
+        case SCANNER_PRIMITIVE_INT32:
+            return boundary ? (random() % 2 ? INT32_MAX : INT32_MIN) : small ? (int64_t) (random() % 2048) - 1024 : (int32_t) random();
+        case SCANNER_PRIMITIVE_INT64:
+            return boundary ? (random() % 2 ? INT64_MAX : INT64_MIN) : small ? (int64_t) (random() % 2048) - 1024 : (int64_t) random();
+        case SCANNER_PRIMITIVE_FLOAT:
+        case SCANNER_PRIMITIVE_DOUBLE:
+            return boundary ? 0.0 : std::uniform_real_distribution<double>(-1024, 1024)(random);
+        case SCANNER_PRIMITIVE_POINTER:
+            return small ? 0x00007F3A11000000 + random() % 4096 * 16 : random();
+        case SCANNER_PRIMITIVE_BYTES: {
+            std::string pattern;
+            char hex[4];
+
+            for (size_t i = 0; i < size; i++) {
+                if (i > 0) pattern += ' ';
+
+                if (random() % 4 == 0) {
+                    pattern += "??";
+                } else {
+                    snprintf(hex, sizeof(hex), "%02X", small ? (unsigned) (random() % 4) : (unsigned) (uint8_t) random());
+                    pattern += hex;
+                }
+            }
+
+            return pattern;
+        }
+        case SCANNER_PRIMITIVE_STRING: {
+            // the matcher compares size bytes of the value, a small alphabet gives accidental matches
+            std::string value;
+            for (size_t i = 0; i < size; i++) value += (char) ('a' + random() % 3);
+            return value;
+        }
+        case SCANNER_PRIMITIVE_NONE:
+            break;
+    }
+
+    return nullptr;
+}
+
+json DifferentialTester::generateField() {
+    // every primitive but none
+    const auto& primitiveDetails = PRIM_DETAILS[1 + random() % (PRIM_DETAILS.size() - 1)];
+    auto primitive = std::get<ScannerPrimitive>(primitiveDetails);
+    size_t size = std::get<size_t>(primitiveDetails);
+
+    json field = { { "type", std::get<std::string>(primitiveDetails) } };
+
+    if (std::get<bool>(primitiveDetails)) {
+        size = 1 + random() % MAX_DYNAMIC_SIZE;
+        field["size"] = size;
+    }
+
+    std::vector<size_t> supported;
+
+    for (size_t i = 0; i < CRIT_DETAILS.size(); i++) {
+        const auto& primitives = std::get<std::vector<ScannerPrimitive>>(CRIT_DETAILS[i]);
+        if (primitives.empty() || std::find(primitives.begin(), primitives.end(), primitive) != primitives.end()) supported.push_back(i);
+    }
+
+    json criterias = json::array();
+
+    for (size_t i = 1 + random() % 2; i > 0; i--) {
+        const auto& criteriaDetails = CRIT_DETAILS[supported[random() % supported.size()]];
+        json criteria = { { "type", std::get<std::vector<std::string>>(criteriaDetails)[0] } };
+
+        if (std::get<bool>(criteriaDetails)) criteria["value"] = generateValue(primitive, size);
+
+        criterias.push_back(criteria);
+    }
+
+    field["criterias"] = criterias;
+
+    return field;
+}
+
+DiffCase DifferentialTester::generate() {
+    DiffCase testCase;
+    testCase.structure = json::array();
+
+    for (size_t i = 1 + random() % MAX_FIELDS; i > 0; i--) testCase.structure.push_back(generateField());
+
+    testCase.engineSeed = random();
+
+    CompiledStructure structure {StructureParser::parseJson(testCase.structure)};
+    size_t structureSize = structure.getSize();
+
+    // some buffers are barely larger, or smaller, than the structure
+    size_t size;
+
+    switch (random() % 8) {
+        case 0:
+            size = random() % (structureSize + 1);
+            break;
+        case 1:
+            size = structureSize + random() % 8;
+            break;
+        default:
+            size = random() % (maxSize + 1);
+    }
+
+    ContentMix mix;
+    mix.zero = (double) (random() % 4);
+    mix.heap = (double) (random() % 4);
+    mix.strings = (double) (random() % 4);
+    mix.random = (double) (1 + random() % 4);
+
+    DumpGenerator generator {random(), mix};
+
+    testCase.data.resize(size);
+    generator.fill(testCase.data.data(), size);
+
+    if (size < structureSize) return testCase;
+
+    // instances at both ends of the buffer, near its end, and anywhere, overlapping or not
+    size_t last = size - structureSize;
+    std::vector<uint64_t> offsets = { 0, last, last - std::min<size_t>(last, random() % 8) };
+    std::vector<char> instance(structureSize);
+
+    for (size_t i = random() % 8; i > 0; i--) offsets.push_back(random() % (last + 1));
+
+    for (uint64_t offset : offsets) {
+        if (!generator.instantiate(structure, instance.data())) break;
+        memcpy(testCase.data.data() + offset, instance.data(), structureSize);
+    }
+
+    return testCase;
+}
+
+bool DifferentialTester::writeDump(const DiffCase& testCase) {
+    dump.reset();
+
+    {
+        std::ofstream file {dumpPath, std::ios::binary | std::ios::trunc};
+        file.write(testCase.data.data(), (std::streamsize) testCase.data.size());
+        if (!file) return false;
+    }
+
+    dump = std::make_unique<MappedFile>();
+    if (!dump->open(dumpPath)) return false;
+
+    // small chunks make the value index merge several sorted runs
+    size_t chunkSize = testCase.engineSeed % 2 ? 512 : ValueIndex::DEFAULT_CHUNK_SIZE;
+
+    if (!ValueIndex::build(*dump, dumpPath + VALUE_INDEX_EXTENSION, 2, chunkSize)) return false;
+    if (!SuffixIndex::build(*dump, dumpPath + SUFFIX_INDEX_EXTENSION)) return false;
+
+    valueIndex = std::make_unique<ValueIndex>();
+    suffixIndex = std::make_unique<SuffixIndex>();
+
+    return valueIndex->open(dumpPath + VALUE_INDEX_EXTENSION, *dump) && suffixIndex->open(dumpPath + SUFFIX_INDEX_EXTENSION, *dump);
+}
+
+bool DifferentialTester::checkEngine(const Engine& engine, const std::shared_ptr<const CompiledStructure>& structure, const DiffCase& testCase,
+                                     const std::vector<uint64_t>& reference, std::string& reason) {
+    std::vector<uint64_t> expected;
+
+    for (uint64_t offset : reference) {
+        if (!engine.expected || engine.expected(*structure, testCase, offset)) expected.push_back(offset);
+    }
+
+    std::vector<uint64_t> actual;
+    bool wrongSize = false;
+    size_t limit = SIZE_MAX;
+
+    CallbackSink sink {[&](const ScannerResult& result) {
+        if (result.valueSize != structure->getSize()) wrongSize = true;
+        actual.push_back(result.offset);
+        return actual.size() < limit;
+    }};
+
+    engineError.clear();
+    if (!engine.scan(structure, testCase, sink)) return true;
+
+    comparisons++;
+
+    if (!engineError.empty()) {
+        reason = engineError;
+        return false;
+    }
+
+    if (wrongSize) {
+        reason = "results do not have the size of the structure";
+        return false;
+    }
+
+    if (std::adjacent_find(actual.begin(), actual.end(), std::greater_equal<uint64_t>()) != actual.end()) {
+        reason = "results are not in increasing order";
+        return false;
+    }
+
+    if (!engine.required) {
+        if (actual != expected) {
+            reason = describeDifference(expected, actual);
+            return false;
+        }
+    } else {
+        std::vector<uint64_t> required;
+
+        for (uint64_t offset : expected) {
+            if (engine.required(*structure, testCase, offset)) required.push_back(offset);
+        }
+
+        if (!std::includes(expected.begin(), expected.end(), actual.begin(), actual.end()) ||
+            !std::includes(actual.begin(), actual.end(), required.begin(), required.end())) {
+            reason = describeDifference(required, actual);
+            return false;
+        }
+
+        return true;
+    }
+
+    // a sink stopping the scan must get exactly the first results
+    if (expected.empty()) return true;
+
+    limit = 1 + testCase.engineSeed % expected.size();
+    actual.clear();
+    engineError.clear();
+    engine.scan(structure, testCase, sink);
+
+    if (!engineError.empty()) {
+        reason = "stopped after " + std::to_string(limit) + " results: " + engineError;
+        return false;
+    }
+
+    if (actual.size() != limit || !std::equal(actual.begin(), actual.end(), expected.begin())) {
+        reason = "stopped after " + std::to_string(limit) + " results: " + describeDifference({ expected.begin(), expected.begin() + (long) limit }, actual);
+        return false;
+    }
+
+    return true;
+}
+
+bool DifferentialTester::check(const DiffCase& testCase, const std::string& engine, DiffFailure& failure) {
+    std::vector<ScannerField> fields = StructureParser::parseJson(testCase.structure);
+    if (fields.empty()) return true;
+
+    auto structure = std::make_shared<const CompiledStructure>(std::move(fields));
+
+    Scanner reference;
+    reference.setStructure(structure);
+    reference.setView((const uint8_t*) testCase.data.data(), testCase.data.size());
+
+    std::vector<uint64_t> expected;
+    CallbackSink referenceSink {[&](const ScannerResult& result) {
+        expected.push_back(result.offset);
+        return true;
+    }};
+
+    reference.scanReference(referenceSink);
+
+    bool dumpWritten = false;
+
+    for (const Engine& candidate : engines) {
+        if (!engine.empty() && candidate.name != engine) continue;
+
+        if (candidate.needsFile) {
+            // empty files cannot be mapped
+            if (testCase.data.empty()) continue;
+
+            if (!dumpWritten && !writeDump(testCase)) {
+                failure = DiffFailure{ "", "cannot write and index " + dumpPath, testCase };
+                return false;
+            }
+
+            dumpWritten = true;
+        }
+
+        std::string reason;
+
+        if (!checkEngine(candidate, structure, testCase, expected, reason)) {
+            failure = DiffFailure{ candidate.name, reason, testCase };
+            return false;
+        }
+    }
+
+    return true;
+}
+
+DiffCase DifferentialTester::shrink(const DiffFailure& failure) {
+    DiffCase best = failure.testCase;
+    DiffFailure ignored;
+
+    auto fails = [&](const DiffCase& candidate) {
+        return !check(candidate, failure.engine, ignored) && !ignored.engine.empty();
+    };
+
+    bool progress = true;
+
+    while (progress) {
+        progress = false;
+
+        // fewer fields, then fewer criteria
+        for (size_t i = 0; best.structure.size() > 1 && i < best.structure.size(); i++) {
+            DiffCase candidate = best;
+            candidate.structure.erase(i);
+
+            if (fails(candidate)) {
+                best = std::move(candidate);
+                progress = true;
+                i--;
+            }
+        }
+
+        for (size_t i = 0; i < best.structure.size(); i++) {
+            for (size_t j = 0; best.structure[i]["criterias"].size() > 1 && j < best.structure[i]["criterias"].size(); j++) {
+                DiffCase candidate = best;
+                candidate.structure[i]["criterias"].erase(j);
+
+                if (fails(candidate)) {
+                    best = std::move(candidate);
+                    progress = true;
+                    j--;
+                }
+            }
+        }
+
+        // fewer bytes, then zeroes in place of the bytes that must stay
+        for (size_t step = std::max<size_t>(best.data.size() / 2, 1); step > 0 && !best.data.empty(); step /= 2) {
+            for (size_t start = 0; start < best.data.size();) {
+                size_t end = std::min(start + step, best.data.size());
+                DiffCase candidate = best;
+                candidate.data.erase(candidate.data.begin() + (long) start, candidate.data.begin() + (long) end);
+
+                if (fails(candidate)) {
+                    best = std::move(candidate);
+                    progress = true;
+                } else {
+                    start = end;
+                }
+            }
+        }
+
+        for (size_t step = std::max<size_t>(best.data.size() / 2, 1); step > 0 && !best.data.empty(); step /= 2) {
+            for (size_t start = 0; start < best.data.size(); start += step) {
+                size_t end = std::min(start + step, best.data.size());
+                if (std::all_of(best.data.begin() + (long) start, best.data.begin() + (long) end, [](char c) { return c == 0; })) continue;
+
+                DiffCase candidate = best;
+                std::fill(candidate.data.begin() + (long) start, candidate.data.begin() + (long) end, 0);
+
+                if (fails(candidate)) {
+                    best = std::move(candidate);
+                    progress = true;
+                }
+            }
+        }
+    }
+
+    return best;
+}
+
+bool DifferentialTester::save(const DiffCase& testCase, const std::string& prefix) {
+    std::ofstream structure {prefix + ".json"};
+    structure << testCase.structure.dump(2) << std::endl;
+
+    std::ofstream data {prefix + ".bin", std::ios::binary};
+    data.write(testCase.data.data(), (std::streamsize) testCase.data.size());
+
+    return structure.good() && data.good();
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../scanner/CompiledStructure.h"
+#include "../scanner/MappedFile.h"
+#include "../scanner/ThreadPool.h"
+#include "../cache/ResultCache.h"
+#include "../index/ValueIndex.h"
+#include "../index/SuffixIndex.h"
+
+// A structure and the buffer it is scanned in. The engines draw their chunk and piece sizes from
+// engineSeed, so a case always splits the same way while it is being shrunk.
+struct DiffCase {
+    json structure;
+    std::vector<char> data;
+    uint64_t engineSeed = 0;
+};
+
+// First disagreement found between an engine and the reference loop
+struct DiffFailure {
+    std::string engine;
+    std::string reason;
+    DiffCase testCase;
+};
+
+// Runs every scan engine on random structures and buffers and compares their results with
+// Scanner::scanReference. Structures are drawn from PRIM_DETAILS and CRIT_DETAILS, and instances are
+// planted at random offsets, at the start and in the last bytes of the buffer. A failing case is
+// shrunk by removing fields, criteria and bytes for as long as the engine still disagrees.
+//
+// Besides the scanners and the indexes, the case is decompressed from blocks of a few bytes (BGZF
+// members, zstd frames or LZ4 blocks), with and without exporting the matched bytes, rebuilt by the
+// result cache from a changed previous version, and cut in snapshot regions whose results are
+// translated to addresses and back.
+class DifferentialTester {
+public:
+    DifferentialTester(uint64_t seed, size_t maxSize, std::string workDirectory);
+    ~DifferentialTester();
+
+    // false at the first case an engine gets wrong, failure then holds the shrunk case
+    bool run(size_t cases, DiffFailure& failure);
+
+    size_t getComparisons() const { return comparisons; }
+
+    // writes <prefix>.json and <prefix>.bin, scanned again with walker -f <prefix>.bin -s <prefix>.json
+    static bool save(const DiffCase& testCase, const std::string& prefix);
+
+private:
+    // scans the case into the sink, false when the engine does not handle it
+    typedef std::function<bool(const std::shared_ptr<const CompiledStructure>& structure, const DiffCase& testCase, ResultSink& sink)> EngineScan;
+    // picks among the results of the reference loop
+    typedef std::function<bool(const CompiledStructure& structure, const DiffCase& testCase, uint64_t offset)> ResultFilter;
+
+    struct Engine {
+        std::string name;
+        EngineScan scan;
+        // the results the engine returns, all of them when null
+        ResultFilter expected;
+        // results an engine that is allowed to skip matches must still find, every result for exact engines
+        ResultFilter required;
+        // the indexes are built from the case written to dumpPath
+        bool needsFile;
+    };
+
+    DiffCase generate();
+    json generateField();
+    json generateValue(ScannerPrimitive primitive, size_t size);
+
+    // checks one engine, or all of them when engine is empty; false with the reason on a mismatch
+    bool check(const DiffCase& testCase, const std::string& engine, DiffFailure& failure);
+    bool checkEngine(const Engine& engine, const std::shared_ptr<const CompiledStructure>& structure, const DiffCase& testCase,
+                     const std::vector<uint64_t>& reference, std::string& reason);
+
+    DiffCase shrink(const DiffFailure& failure);
+
+    bool writeDump(const DiffCase& testCase);
+
+    std::mt19937_64 random;
+    size_t maxSize;
+    std::string workDirectory;
+    std::string dumpPath;
+    std::string exportPath;
+    ThreadPool pool;
+
+    // holds the entries of the previous versions, removed with the tester
+    std::unique_ptr<ResultCache> cache;
+
+    std::unique_ptr<MappedFile> dump;
+    std::unique_ptr<ValueIndex> valueIndex;
+    std::unique_ptr<SuffixIndex> suffixIndex;
+
+    std::vector<Engine> engines;
+    // set by an engine whose output besides the results is wrong, such as the exported bytes
+    std::string engineError;
+    size_t comparisons = 0;
+};
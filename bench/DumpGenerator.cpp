@@ -0,0 +1,336 @@
+#include "DumpGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <sstream>
+
+static constexpr size_t MAX_ATTEMPTS = 256;
+static constexpr size_t MAX_BREAK_ROUNDS = 16;
+
+static const char* WORDS[] = {
+    "walker", "process", "memory", "player", "health", "position", "inventory", "config", "session", "buffer",
+    "https://example.com/", "C:\\Windows\\System32\\", "/usr/lib/x86_64-linux-gnu/", "error", "warning", "token"
+};
+
+bool ContentMix::parse(const std::string& description, ContentMix& mix) {
+    ContentMix parsed{ 0, 0, 0, 0 };
+    std::stringstream stream {description};
+    std::string item;
+
+    while (std::getline(stream, item, ',')) {
+        size_t separator = item.find('=');
+        if (separator == std::string::npos) return false;
+
+        std::string name = item.substr(0, separator);
+        double share = strtod(item.c_str() + separator + 1, nullptr);
+
+        if (share < 0) return false;
+
+        if (name == "zero") {
+            parsed.zero = share;
+        } else if (name == "heap") {
+            parsed.heap = share;
+        } else if (name == "strings") {
+            parsed.strings = share;
+        } else if (name == "random") {
+            parsed.random = share;
+        } else {
+            return false;
+        }
+    }
+
+    if (parsed.zero + parsed.heap + parsed.strings + parsed.random <= 0) return false;
+
+    mix = parsed;
+    return true;
+}
+
+DumpGenerator::DumpGenerator(uint64_t seed, ContentMix mix) : random(seed), mix(mix) {}
+
+void DumpGenerator::fill(char* data, size_t size) {
+    double total = mix.zero + mix.heap + mix.strings + mix.random;
+
+    for (size_t offset = 0; offset < size; offset += BLOCK_SIZE) {
+        size_t length = std::min(BLOCK_SIZE, size - offset);
+        double pick = std::uniform_real_distribution<double>(0, total)(random);
+
+        if (pick < mix.zero) {
+            memset(data + offset, 0, length);
+        } else if (pick < mix.zero + mix.heap) {
+            fillHeap(data + offset, length);
+        } else if (pick < mix.zero + mix.heap + mix.strings) {
+            fillStrings(data + offset, length);
+        } else {
+            for (size_t i = 0; i < length; i += 8) {
+                uint64_t value = random();
+                memcpy(data + offset + i, &value, std::min<size_t>(8, length - i));
+            }
+        }
+    }
+}
+
+// aligned 8 byte slots: pointers into a few heap and library ranges, small integers and zeros
+void DumpGenerator::fillHeap(char* data, size_t size) {
+    static const uint64_t BASES[] = { 0x000055D4C3A00000, 0x00007F3A11000000, 0x00007FFC9E000000 };
+
+    for (size_t i = 0; i < size; i += 8) {
+        uint64_t kind = random() % 10;
+        uint64_t value = 0;
+
+        if (kind < 6) {
+            value = BASES[random() % 3] + (random() % (64 * 1024 * 1024) & ~(uint64_t) 15);
+        } else if (kind < 8) {
+            value = random() % 1024;
+        }
+
+        memcpy(data + i, &value, std::min<size_t>(8, size - i));
+    }
+}
+
+// NUL separated words, every fourth one in UTF-16LE
+void DumpGenerator::fillStrings(char* data, size_t size) {
+    size_t offset = 0;
+
+    while (offset < size) {
+        const char* word = WORDS[random() % (sizeof(WORDS) / sizeof(WORDS[0]))];
+        size_t length = strlen(word);
+        bool wide = random() % 4 == 0;
+
+        for (size_t i = 0; i < length && offset < size; i++) {
+            data[offset++] = word[i];
+            if (wide && offset < size) data[offset++] = 0;
+        }
+
+        for (size_t i = 0; i < (wide ? 2 : 1) && offset < size; i++) data[offset++] = 0;
+    }
+}
+
+// closest value above or below, for the strict comparisons
+template<typename T>
+static T nextValue(T value, bool up) {
+    if constexpr (std::is_floating_point<T>::value) {
+        return std::nextafter(value, up ? std::numeric_limits<T>::max() : std::numeric_limits<T>::lowest());
+    } else {
+        return (T) (up ? value + 1 : value - 1);
+    }
+}
+
+template<typename T>
+bool DumpGenerator::pickNumeric(const ScannerField& field, T& value) {
+    T low = std::numeric_limits<T>::lowest();
+    T high = std::numeric_limits<T>::max();
+
+    for (const ScannerCriteria& criteria : field.criterias) {
+        if (criteria.value == nullptr) continue;
+
+        T bound = *(const T*) criteria.value;
+
+        switch (criteria.type) {
+            case SCANNER_CRITERIA_EQUAL:
+                value = bound;
+                return true;
+            case SCANNER_CRITERIA_GREATER_THAN:
+                if (bound == std::numeric_limits<T>::max()) return false;
+                low = std::max(low, nextValue(bound, true));
+                break;
+            case SCANNER_CRITERIA_GREATER_THAN_OR_EQUAL:
+                low = std::max(low, bound);
+                break;
+            case SCANNER_CRITERIA_LESS_THAN:
+                if (bound == std::numeric_limits<T>::lowest()) return false;
+                high = std::min(high, nextValue(bound, false));
+                break;
+            case SCANNER_CRITERIA_LESS_THAN_OR_EQUAL:
+                high = std::min(high, bound);
+                break;
+            default:
+                break;
+        }
+    }
+
+    if (low > high) return false;
+
+    if constexpr (std::is_floating_point<T>::value) {
+        // unbounded sides are kept to values that print and compare normally
+        double from = std::max((double) low, -1e9), to = std::min((double) high, 1e9);
+        if (from > to) from = to = (double) (from > 0 ? low : high);
+
+        value = (T) std::uniform_real_distribution<double>(from, std::nextafter(to, INFINITY))(random);
+        value = std::min(std::max(value, low), high);
+    } else if constexpr (std::is_signed<T>::value) {
+        value = (T) std::uniform_int_distribution<int64_t>(low, high)(random);
+    } else {
+        value = (T) std::uniform_int_distribution<uint64_t>(low, high)(random);
+    }
+
+    return true;
+}
+
+bool DumpGenerator::instantiateField(const ScannerField& field, size_t fieldSize, char* out) {
+    for (size_t attempt = 0; attempt < MAX_ATTEMPTS; attempt++) {
+        // random bytes first, then whatever the criteria pin down
+        for (size_t i = 0; i < fieldSize; i++) out[i] = (char) random();
+
+        bool valid = true;
+
+        switch (field.primitive) {
+            case SCANNER_PRIMITIVE_UINT8: { uint8_t v; valid = pickNumeric(field, v); memcpy(out, &v, sizeof(v)); break; }
+            case SCANNER_PRIMITIVE_UINT16: { uint16_t v; valid = pickNumeric(field, v); memcpy(out, &v, sizeof(v)); break; }
+            case SCANNER_PRIMITIVE_UINT32: { uint32_t v; valid = pickNumeric(field, v); memcpy(out, &v, sizeof(v)); break; }
+            case SCANNER_PRIMITIVE_UINT64: { uint64_t v; valid = pickNumeric(field, v); memcpy(out, &v, sizeof(v)); break; }
+            case SCANNER_PRIMITIVE_INT8: { int8_t v; valid = pickNumeric(field, v); memcpy(out, &v, sizeof(v)); break; }
+            case SCANNER_PRIMITIVE_INT16: { int16_t v; valid = pickNumeric(field, v); memcpy(out, &v, sizeof(v)); break; }
+            case SCANNER_PRIMITIVE_INT32: { int32_t v; valid = pickNumeric(field, v); memcpy(out, &v, sizeof(v)); break; }
+            case SCANNER_PRIMITIVE_INT64: { int64_t v; valid = pickNumeric(field, v); memcpy(out, &v, sizeof(v)); break; }
+            case SCANNER_PRIMITIVE_FLOAT: { float v; valid = pickNumeric(field, v); memcpy(out, &v, sizeof(v)); break; }
+            case SCANNER_PRIMITIVE_DOUBLE: { double v; valid = pickNumeric(field, v); memcpy(out, &v, sizeof(v)); break; }
+            case SCANNER_PRIMITIVE_POINTER:
+                for (const ScannerCriteria& criteria : field.criterias) {
+                    if (criteria.type == SCANNER_CRITERIA_EQUAL) memcpy(out, criteria.value, sizeof(uintptr_t));
+                    if (criteria.type == SCANNER_CRITERIA_PTR_NULL) memset(out, 0, sizeof(uintptr_t));
+                }
+                break;
+            case SCANNER_PRIMITIVE_BYTES:
+                for (const ScannerCriteria& criteria : field.criterias) {
+                    if (criteria.type != SCANNER_CRITERIA_BYTES_MATCH) continue;
+
+                    std::vector<int> pattern = ScanUtils::parsePattern(*(const std::string*) criteria.value);
+
+                    for (size_t i = 0; i < pattern.size() && i < fieldSize; i++) {
+                        if (pattern[i] >= 0) out[i] = (char) pattern[i];
+                    }
+                }
+                break;
+            case SCANNER_PRIMITIVE_STRING:
+                for (const ScannerCriteria& criteria : field.criterias) {
+                    if (criteria.type != SCANNER_CRITERIA_EQUAL) continue;
+
+                    // the value is NUL terminated, the matcher compares fieldSize bytes of it
+                    size_t length = std::min(strlen((const char*) criteria.value) + 1, fieldSize);
+                    memcpy(out, criteria.value, length);
+                }
+                break;
+            case SCANNER_PRIMITIVE_NONE:
+                return false;
+        }
+
+        if (!valid) return false;
+        if (ScanUtils::matchesField(out, field)) return true;
+    }
+
+    return false;
+}
+
+bool DumpGenerator::instantiate(const CompiledStructure& structure, char* out) {
+    const StructureLayout& layout = structure.getLayout();
+    const std::vector<ScannerField>& fields = structure.getFields();
+
+    for (size_t i = 0; i < fields.size(); i++) {
+        if (!instantiateField(fields[i], layout.getFieldSize(i), out + layout.getFieldOffset(i))) return false;
+    }
+
+    return structure.matches(out);
+}
+
+bool DumpGenerator::plant(const CompiledStructure& structure, char* data, size_t size, size_t count, size_t alignment, std::vector<uint64_t>& offsets) {
+    size_t structureSize = structure.getSize();
+
+    if (count == 0) return true;
+    if (alignment == 0 || structureSize == 0) return false;
+
+    // one instance per slot, anywhere in its slot, so instances never overlap
+    size_t slot = size / count;
+    if (slot < structureSize + alignment) return false;
+
+    std::vector<char> instance(structureSize);
+
+    for (size_t i = 0; i < count; i++) {
+        uint64_t positions = (slot - structureSize) / alignment + 1;
+        uint64_t start = (i * slot + alignment - 1) / alignment * alignment;
+        uint64_t offset = start + random() % positions * alignment;
+
+        if (offset + structureSize > (i + 1) * slot) offset = start;
+        if (!instantiate(structure, instance.data())) return false;
+
+        memcpy(data + offset, instance.data(), structureSize);
+        offsets.push_back(offset);
+    }
+
+    return true;
+}
+
+// the plain field by field evaluation, shares no code with the compiled scan
+static bool matchesAt(const std::vector<ScannerField>& fields, const StructureLayout& layout, const char* data) {
+    for (size_t i = 0; i < fields.size(); i++) {
+        if (!ScanUtils::matchesField((void*) (data + layout.getFieldOffset(i)), fields[i])) return false;
+    }
+
+    return true;
+}
+
+void DumpGenerator::breakAccidentalMatches(const CompiledStructure& structure, char* data, size_t size, const std::vector<uint64_t>& planted, std::vector<uint64_t>& accidental) {
+    size_t structureSize = structure.getSize();
+    const StructureLayout& layout = structure.getLayout();
+    const std::vector<ScannerField>& fields = structure.getFields();
+
+    accidental.clear();
+    if (structureSize == 0 || fields.empty() || size < structureSize) return;
+
+    // bytes of the fields that have a real criteria, changing the others cannot break a match
+    std::vector<size_t> selective;
+
+    for (size_t i = 0; i < fields.size(); i++) {
+        bool constrained = std::any_of(fields[i].criterias.begin(), fields[i].criterias.end(), [](const ScannerCriteria& criteria) {
+            return criteria.type != SCANNER_CRITERIA_ANY;
+        });
+
+        for (size_t j = 0; constrained && j < layout.getFieldSize(i); j++) selective.push_back(layout.getFieldOffset(i) + j);
+    }
+
+    auto isPlantedByte = [&](uint64_t offset) {
+        auto it = std::upper_bound(planted.begin(), planted.end(), offset);
+        return it != planted.begin() && offset < *(it - 1) + structureSize;
+    };
+
+    for (uint64_t offset = 0; offset + structureSize <= size; offset++) {
+        if (matchesAt(fields, layout, data + offset) && !std::binary_search(planted.begin(), planted.end(), offset)) accidental.push_back(offset);
+    }
+
+    for (size_t round = 0; round < MAX_BREAK_ROUNDS && !accidental.empty() && !selective.empty(); round++) {
+        // the offsets covering a changed byte may stop or start matching, the others cannot
+        std::vector<uint64_t> candidates;
+        bool changed = false;
+
+        for (uint64_t offset : accidental) {
+            candidates.push_back(offset);
+
+            for (size_t attempt = 0; attempt < selective.size(); attempt++) {
+                uint64_t position = offset + selective[random() % selective.size()];
+                if (isPlantedByte(position)) continue;
+
+                data[position] = (char) (data[position] ^ (char) (1 + random() % 255));
+
+                uint64_t first = position >= structureSize - 1 ? position - (structureSize - 1) : 0;
+                uint64_t last = std::min<uint64_t>(position, size - structureSize);
+                for (uint64_t candidate = first; candidate <= last; candidate++) candidates.push_back(candidate);
+                changed = true;
+                break;
+            }
+        }
+
+        if (!changed) break;
+
+        std::sort(candidates.begin(), candidates.end());
+        candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+        std::vector<uint64_t> remaining;
+
+        for (uint64_t offset : candidates) {
+            if (matchesAt(fields, layout, data + offset) && !std::binary_search(planted.begin(), planted.end(), offset)) remaining.push_back(offset);
+        }
+
+        accidental = std::move(remaining);
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../scanner/CompiledStructure.h"
+
+// Share of each kind of content in a generated dump
+struct ContentMix {
+    double zero = 0.2;
+    double heap = 0.4;
+    double strings = 0.2;
+    double random = 0.2;
+
+    // "zero=20,heap=40,strings=20,random=20", shares are relative to their sum
+    static bool parse(const std::string& description, ContentMix& mix);
+};
+
+// Builds deterministic dumps for benchmarks and tests: the same seed always gives the same bytes.
+//
+// The dump is made of blocks of zero pages, pointer-dense heap memory, ASCII and UTF-16 strings and
+// random bytes. Instances of a structure are planted at known offsets, and the matches that happen
+// by accident are broken by changing one of their bytes, so the list of offsets where the structure
+// matches is known without running a scan engine.
+class DumpGenerator {
+public:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+    DumpGenerator(uint64_t seed, ContentMix mix);
+
+    void fill(char* data, size_t size);
+
+    // writes bytes matching the structure, false when its criteria cannot be satisfied
+    bool instantiate(const CompiledStructure& structure, char* out);
+
+    // plants count non overlapping instances at offsets multiple of alignment, in increasing order
+    bool plant(const CompiledStructure& structure, char* data, size_t size, size_t count, size_t alignment, std::vector<uint64_t>& offsets);
+
+    // changes bytes outside the planted instances until the structure only matches where it was
+    // planted, the accidental matches that could not be broken are returned in accidental.
+    // Matches are found by evaluating every field with ScanUtils::matchesField at every offset,
+    // not by the scan engines the dump is meant to check
+    void breakAccidentalMatches(const CompiledStructure& structure, char* data, size_t size, const std::vector<uint64_t>& planted, std::vector<uint64_t>& accidental);
+
+private:
+    void fillHeap(char* data, size_t size);
+    void fillStrings(char* data, size_t size);
+    bool instantiateField(const ScannerField& field, size_t fieldSize, char* out);
+
+    template<typename T>
+    bool pickNumeric(const ScannerField& field, T& value);
+
+    std::mt19937_64 random;
+    ContentMix mix;
+};
@@ -0,0 +1,231 @@
+#include "MacroBenchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <iostream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../scanner/MappedFile.h"
+#include "../scanner/Scanner.h"
+#include "../scanner/StructureParser.h"
+#include "../scanner/ThreadPool.h"
+
+#include "Benchmark.h"
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+double Roofline::readBandwidth(size_t threads) const {
+    for (const auto& [count, bandwidth] : readGigabytesPerSecond) {
+        if (count == threads) return bandwidth;
+    }
+
+    return 0;
+}
+
+MacroBenchmark::MacroBenchmark(std::vector<std::string> corpus, std::string structurePath, size_t maxThreads, size_t repetitions, std::string outputPath)
+    : corpus(std::move(corpus)), structurePath(std::move(structurePath)), maxThreads(std::max<size_t>(1, maxThreads)),
+      repetitions(std::max<size_t>(1, repetitions)), outputPath(std::move(outputPath)) {}
+
+std::vector<size_t> MacroBenchmark::threadCounts(size_t maxThreads) {
+    std::vector<size_t> counts;
+
+    for (size_t threads = 1; threads < maxThreads; threads *= 2) counts.push_back(threads);
+    counts.push_back(maxThreads);
+
+    return counts;
+}
+
+bool MacroBenchmark::run() {
+    measureRoofline();
+
+    for (const std::string& path : corpus) {
+        for (size_t threads : threadCounts(maxThreads)) {
+            MacroRun best{};
+
+            // the fastest repetition is kept, the first one also brings the file in the page cache
+            for (size_t i = 0; i < repetitions; i++) {
+                MacroRun current{};
+                if (!runOnce(path, threads, current)) return false;
+
+                if (i == 0 || current.seconds.total() < best.seconds.total()) best = current;
+            }
+
+            fprintf(stderr, "%s, %zu threads: %.3f s, scan %.3f GB/s\n", path.c_str(), threads, best.seconds.total(),
+                    (double) best.bytes / best.seconds.scan / 1e9);
+            runs.push_back(best);
+        }
+    }
+
+    return true;
+}
+
+bool MacroBenchmark::runOnce(const std::string& path, size_t threads, MacroRun& run) const {
+    auto start = std::chrono::steady_clock::now();
+    StructureParser parser {structurePath};
+    std::shared_ptr<CompiledStructure> structure = parser.compile();
+    run.seconds.parse = secondsSince(start);
+
+    if (structure->isEmpty()) return false;
+
+    // mapping the file and touching each page, so the scan phase only measures the matching
+    start = std::chrono::steady_clock::now();
+    MappedFile target {};
+    if (!target.open(path)) return false;
+
+    uint8_t checksum = 0;
+    for (size_t i = 0; i < target.size(); i += 4096) checksum ^= target.data()[i];
+    doNotOptimize(checksum);
+    run.seconds.load = secondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    ThreadPool pool {threads};
+    Scanner scanner {};
+    scanner.setStructure(structure);
+    scanner.setView(target.data(), target.size());
+    scanner.setThreadPool(&pool);
+
+    ResultSet results = scanner.scan();
+    run.seconds.scan = secondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    scanner.saveResults(results, outputPath);
+    run.seconds.write = secondsSince(start);
+
+    run.corpus = path;
+    run.threads = threads;
+    run.bytes = target.size();
+    run.results = results.size();
+
+    return true;
+}
+
+void MacroBenchmark::measureRoofline() {
+    std::vector<char> source(ROOFLINE_BUFFER_SIZE, 1);
+    std::vector<char> destination(ROOFLINE_BUFFER_SIZE, 0);
+
+    double best = 0;
+
+    for (size_t i = 0; i < 3; i++) {
+        auto start = std::chrono::steady_clock::now();
+        memcpy(destination.data(), source.data(), source.size());
+        doNotOptimize(destination[i]);
+        best = std::max(best, (double) source.size() / secondsSince(start) / 1e9);
+    }
+
+    roofline.memcpyGigabytesPerSecond = best;
+
+    // every thread sums its share of the buffer, as a scan reads every byte once
+    for (size_t threads : threadCounts(maxThreads)) {
+        ThreadPool pool {threads};
+        size_t share = source.size() / threads / 64 * 64;
+        best = 0;
+
+        for (size_t i = 0; i < 3; i++) {
+            std::vector<std::future<void>> tasks;
+            auto start = std::chrono::steady_clock::now();
+
+            for (size_t t = 0; t < threads; t++) {
+                tasks.push_back(pool.submit([&source, share, t] {
+                    auto words = (const uint64_t*) (source.data() + t * share);
+                    uint64_t sum = 0;
+
+                    for (size_t j = 0; j < share / sizeof(uint64_t); j++) sum += words[j];
+                    doNotOptimize(sum);
+                }));
+            }
+
+            for (auto& task : tasks) task.get();
+            best = std::max(best, (double) (share * threads) / secondsSince(start) / 1e9);
+        }
+
+        roofline.readGigabytesPerSecond.emplace_back(threads, best);
+    }
+
+    // read() of the first corpus file, which is in the page cache after the first pass
+    if (!corpus.empty()) {
+        int fd = open(corpus[0].c_str(), O_RDONLY);
+        best = 0;
+
+        for (size_t i = 0; fd >= 0 && i < 3; i++) {
+            uint64_t total = 0;
+            ssize_t bytesRead;
+            auto start = std::chrono::steady_clock::now();
+
+            while ((bytesRead = pread(fd, destination.data(), 4 * 1024 * 1024, (off_t) total)) > 0) total += (uint64_t) bytesRead;
+
+            if (total > 0) best = std::max(best, (double) total / secondsSince(start) / 1e9);
+        }
+
+        if (fd >= 0) close(fd);
+        roofline.fileReadGigabytesPerSecond = best;
+    }
+}
+
+json MacroBenchmark::toJson() const {
+    json bandwidth = json::array();
+    json entries = json::array();
+
+    for (const auto& [threads, gigabytesPerSecond] : roofline.readGigabytesPerSecond) {
+        bandwidth.push_back({ { "threads", threads }, { "gb_per_second", gigabytesPerSecond } });
+    }
+
+    for (const MacroRun& run : runs) {
+        double scanRate = (double) run.bytes / run.seconds.scan / 1e9;
+
+        entries.push_back({
+            { "corpus", run.corpus },
+            { "threads", run.threads },
+            { "bytes", run.bytes },
+            { "results", run.results },
+            { "seconds", {
+                { "parse", run.seconds.parse },
+                { "load", run.seconds.load },
+                { "scan", run.seconds.scan },
+                { "write", run.seconds.write },
+                { "total", run.seconds.total() }
+            } },
+            { "scan_gb_per_second", scanRate },
+            { "total_gb_per_second", (double) run.bytes / run.seconds.total() / 1e9 },
+            { "results_per_second", (double) run.results / run.seconds.total() },
+            { "roofline_fraction", scanRate / roofline.readBandwidth(run.threads) }
+        });
+    }
+
+    return {
+        { "machine", BenchmarkRunner::machineInfo() },
+        { "roofline", {
+            { "memcpy_gb_per_second", roofline.memcpyGigabytesPerSecond },
+            { "file_read_gb_per_second", roofline.fileReadGigabytesPerSecond },
+            { "memory_read", bandwidth }
+        } },
+        { "runs", entries }
+    };
+}
+
+void MacroBenchmark::printTable(std::ostream& out) const {
+    char line[256];
+
+    snprintf(line, sizeof(line), "* memcpy %.2f GB/s, read() from the page cache %.2f GB/s\n",
+             roofline.memcpyGigabytesPerSecond, roofline.fileReadGigabytesPerSecond);
+    out << line;
+
+    snprintf(line, sizeof(line), "%-32s %7s %9s %9s %9s %9s %10s %12s %9s\n",
+             "corpus", "threads", "parse ms", "load ms", "scan ms", "write ms", "scan GB/s", "results/s", "roofline");
+    out << line;
+
+    for (const MacroRun& run : runs) {
+        double scanRate = (double) run.bytes / run.seconds.scan / 1e9;
+        std::string name = run.corpus.size() > 32 ? "..." + run.corpus.substr(run.corpus.size() - 29) : run.corpus;
+
+        snprintf(line, sizeof(line), "%-32s %7zu %9.2f %9.2f %9.2f %9.2f %10.3f %12.0f %8.1f%%\n",
+                 name.c_str(), run.threads, run.seconds.parse * 1e3, run.seconds.load * 1e3, run.seconds.scan * 1e3, run.seconds.write * 1e3,
+                 scanRate, (double) run.results / run.seconds.total(), 100 * scanRate / roofline.readBandwidth(run.threads));
+        out << line;
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "../lib/json.h"
+
+using json = nlohmann::json;
+
+// Wall time of each phase of a scan, in seconds
+struct PhaseTimes {
+    double parse = 0;
+    double load = 0;
+    double scan = 0;
+    double write = 0;
+
+    double total() const { return parse + load + scan + write; }
+};
+
+struct MacroRun {
+    std::string corpus;
+    size_t threads;
+    uint64_t bytes;
+    uint64_t results;
+    PhaseTimes seconds;
+};
+
+// Bandwidth of the machine, the ceiling a scan reading every byte once can reach
+struct Roofline {
+    double memcpyGigabytesPerSecond = 0;
+    double fileReadGigabytesPerSecond = 0;
+    // memory read bandwidth for each measured thread count
+    std::vector<std::pair<size_t, double>> readGigabytesPerSecond;
+
+    double readBandwidth(size_t threads) const;
+};
+
+// Runs complete scans (structure parse, file load, scan, result write) of every file of a corpus at
+// increasing thread counts, and compares the scan throughput with the memory bandwidth measured on
+// the same machine.
+class MacroBenchmark {
+public:
+    static constexpr size_t ROOFLINE_BUFFER_SIZE = 256 * 1024 * 1024;
+
+    MacroBenchmark(std::vector<std::string> corpus, std::string structurePath, size_t maxThreads, size_t repetitions, std::string outputPath);
+
+    bool run();
+
+    json toJson() const;
+    void printTable(std::ostream& out) const;
+
+    // 1, 2, 4 ... up to maxThreads, which is always included
+    static std::vector<size_t> threadCounts(size_t maxThreads);
+
+private:
+    void measureRoofline();
+    bool runOnce(const std::string& path, size_t threads, MacroRun& run) const;
+
+    std::vector<std::string> corpus;
+    std::string structurePath;
+    size_t maxThreads;
+    size_t repetitions;
+    std::string outputPath;
+
+    Roofline roofline;
+    std::vector<MacroRun> runs;
+};
@@ -0,0 +1,390 @@
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+#include "../lib/argparse.h"
+
+#include "../scanner/Scanner.h"
+#include "../scanner/StructureParser.h"
+#include "../scanner/ThreadPool.h"
+
+#include "Benchmark.h"
+#include "MacroBenchmark.h"
+#include "DumpGenerator.h"
+#include "DifferentialTester.h"
+
+static constexpr size_t KERNEL_BUFFER_SIZE = 64 * 1024;
+static constexpr size_t PATTERN_BUFFER_SIZE = 16 * 1024;
+static constexpr uint64_t SEED = 0x5EED;
+
+static std::vector<char> randomBuffer(size_t size, uint64_t seed) {
+    std::mt19937_64 random {seed};
+    std::vector<char> buffer(size);
+
+    for (size_t i = 0; i + 8 <= size; i += 8) {
+        uint64_t value = random();
+        memcpy(buffer.data() + i, &value, 8);
+    }
+
+    return buffer;
+}
+
+// criteria value used for each primitive, picked so numeric comparisons do not all go one way
+static json criteriaValue(ScannerPrimitive primitive) {
+    switch (primitive) {
+        case SCANNER_PRIMITIVE_FLOAT:
+        case SCANNER_PRIMITIVE_DOUBLE:
+            return 42.5;
+        case SCANNER_PRIMITIVE_POINTER:
+            return 0x7F0000001000;
+        case SCANNER_PRIMITIVE_BYTES:
+            return "DE AD ?? EF";
+        case SCANNER_PRIMITIVE_STRING:
+            return "walker";
+        case SCANNER_PRIMITIVE_INT8:
+        case SCANNER_PRIMITIVE_INT16:
+        case SCANNER_PRIMITIVE_INT32:
+        case SCANNER_PRIMITIVE_INT64:
+            return -42;
+        default:
+            return 42;
+    }
+}
+
+static size_t dynamicSize(ScannerPrimitive primitive) {
+    if (primitive == SCANNER_PRIMITIVE_BYTES) return 4;
+    if (primitive == SCANNER_PRIMITIVE_STRING) return 6;
+    return 0;
+}
+
+// every primitive against every criteria it supports, one field tested at every offset
+static void benchKernels(BenchmarkRunner& runner) {
+    std::vector<char> buffer = randomBuffer(KERNEL_BUFFER_SIZE, SEED);
+
+    for (const auto& primitiveDetails : PRIM_DETAILS) {
+        auto primitive = std::get<ScannerPrimitive>(primitiveDetails);
+        if (primitive == SCANNER_PRIMITIVE_NONE) continue;
+
+        for (const auto& criteriaDetails : CRIT_DETAILS) {
+            auto criteria = std::get<ScannerCriteriaType>(criteriaDetails);
+            const auto& supported = std::get<std::vector<ScannerPrimitive>>(criteriaDetails);
+
+            if (!supported.empty() && std::find(supported.begin(), supported.end(), primitive) == supported.end()) continue;
+
+            void* value = std::get<bool>(criteriaDetails) ? ScanUtils::castAsPrimitiveType(criteriaValue(primitive), primitive) : nullptr;
+            CompiledStructure structure {{ ScannerField{ primitive, { ScannerCriteria{ criteria, value } }, dynamicSize(primitive) } }};
+
+            const ScannerField& field = structure.getFields()[0];
+            size_t offsets = buffer.size() - structure.getSize() + 1;
+            std::string name = std::get<std::string>(primitiveDetails) + "/" + std::get<std::vector<std::string>>(criteriaDetails)[0];
+
+            runner.run("kernel", name, offsets, offsets, [&] {
+                size_t matches = 0;
+
+                for (size_t i = 0; i < offsets; i++) {
+                    matches += ScanUtils::matchesField(buffer.data() + i, field);
+                }
+
+                doNotOptimize(matches);
+            });
+        }
+    }
+}
+
+// comparePattern at several lengths and wildcard densities, with the pattern planted every 1 KiB
+static void benchPatterns(BenchmarkRunner& runner) {
+    std::mt19937_64 random {SEED};
+
+    for (size_t length : { 4, 8, 16, 32, 64 }) {
+        for (int wildcardPercent : { 0, 25, 50 }) {
+            std::vector<char> buffer = randomBuffer(PATTERN_BUFFER_SIZE, SEED + length);
+            std::string pattern;
+            char hex[4];
+
+            for (size_t i = 0; i < length; i++) {
+                if (i > 0) pattern += ' ';
+
+                // the first byte is never a wildcard, as in real signatures
+                if (i > 0 && (int) (random() % 100) < wildcardPercent) {
+                    pattern += "??";
+                } else {
+                    snprintf(hex, sizeof(hex), "%02X", (uint8_t) buffer[i]);
+                    pattern += hex;
+                }
+            }
+
+            for (size_t i = 1024; i + length <= buffer.size(); i += 1024) memcpy(buffer.data() + i, buffer.data(), length);
+
+            size_t offsets = buffer.size() - length + 1;
+            std::string name = "length" + std::to_string(length) + "/wildcards" + std::to_string(wildcardPercent);
+
+            runner.run("pattern", name, offsets, offsets, [&] {
+                size_t matches = 0;
+
+                for (size_t i = 0; i < offsets; i++) {
+                    matches += ScanUtils::comparePattern(buffer.data() + i, pattern, length);
+                }
+
+                doNotOptimize(matches);
+            });
+        }
+    }
+}
+
+// whole scans of a generated dump where a share of the offsets hold a planted match
+static void benchScans(BenchmarkRunner& runner, size_t scanSize) {
+    static const std::vector<std::tuple<std::string, json, std::string>> STRUCTURES = {
+        { "eq-anchored", json::parse(R"([{"type":"uint32","criterias":[{"type":"eq","value":1592614637}]},{"type":"uint32","criterias":[{"type":"any"}]}])"), std::string("\xED\x5E\xED\x5E\x01\x00\x00\x00", 8) },
+        { "range-only", json::parse(R"([{"type":"uint64","criterias":[{"type":"gt","value":4096},{"type":"lt","value":8192}]}])"), std::string("\x00\x18\x00\x00\x00\x00\x00\x00", 8) },
+        { "string-eq", json::parse(R"([{"type":"string","size":6,"criterias":[{"type":"eq","value":"walker"}]}])"), std::string("walker") }
+    };
+
+    std::vector<char> corpus(scanSize);
+    DumpGenerator generator {SEED, ContentMix{}};
+    generator.fill(corpus.data(), corpus.size());
+
+    ThreadPool pool {};
+
+    for (const auto& [structureName, description, planted] : STRUCTURES) {
+        auto structure = std::make_shared<CompiledStructure>(StructureParser::parseJson(description));
+
+        for (double selectivity : { 0.0, 1e-6, 1e-4, 1e-2 }) {
+            std::vector<char> buffer = corpus;
+            size_t plantCount = (size_t) ((double) scanSize * selectivity);
+
+            for (size_t i = 0; i < plantCount; i++) {
+                size_t offset = (size_t) ((double) i / selectivity) + 1;
+                if (offset + planted.size() <= buffer.size()) memcpy(buffer.data() + offset, planted.data(), planted.size());
+            }
+
+            for (bool parallel : { false, true }) {
+                if (parallel && pool.getThreadCount() < 2) continue;
+
+                Scanner scanner {};
+                scanner.setStructure(structure);
+                scanner.setView((const uint8_t*) buffer.data(), buffer.size());
+                if (parallel) scanner.setThreadPool(&pool);
+
+                char selectivityName[32];
+                snprintf(selectivityName, sizeof(selectivityName), "%g", selectivity);
+
+                std::string name = structureName + "/" + selectivityName + (parallel ? "/threads" + std::to_string(pool.getThreadCount()) : "/threads1");
+
+                runner.run("scan", name, buffer.size(), buffer.size(), [&] {
+                    CountingSink sink{};
+                    scanner.scan(sink);
+                    doNotOptimize(sink.getCount());
+                });
+            }
+        }
+    }
+}
+
+int macro_command(int argc, char** argv) {
+    argparse::Parser parser;
+
+    auto files = parser.AddArg<std::string>("files", 'f', "Comma separated list of the dumps to scan.");
+    auto structure = parser.AddArg<std::string>("structure", 's', "The structure JSON file to search.");
+    auto threads = parser.AddArg<size_t>("threads", 't', "Highest thread count, 0 for one per core.").Default(0);
+    auto repeat = parser.AddArg<size_t>("repeat", "Runs of each case, the fastest is kept.").Default(3);
+    auto output = parser.AddArg<std::string>("output", 'o', "Where the results of each scan are written.").Default("/tmp/walker_macro_results.txt");
+    auto json = parser.AddArg<std::string>("json", "Write the measures to a JSON file.");
+
+    parser.ParseArgs(argc, argv);
+
+    if (!files || !structure) {
+        std::cout << "Usage: " << argv[0] << " -f <dump>[,<dump>...] -s <structure> [-t threads] [--repeat N] [-o results] [--json file]" << std::endl;
+        return 1;
+    }
+
+    std::vector<std::string> corpus;
+    std::stringstream list {*files};
+    std::string path;
+
+    while (std::getline(list, path, ',')) {
+        if (!path.empty()) corpus.push_back(path);
+    }
+
+    MacroBenchmark benchmark {corpus, *structure, *threads > 0 ? *threads : ThreadPool::defaultThreadCount(), *repeat, *output};
+
+    if (!benchmark.run()) {
+        std::cout << "[-] Failed to scan the corpus." << std::endl;
+        return 1;
+    }
+
+    benchmark.printTable(std::cout);
+
+    if (json) {
+        std::ofstream file {*json};
+        file << benchmark.toJson().dump(2) << std::endl;
+
+        if (!file) {
+            std::cerr << "[-] Failed to write " << *json << "." << std::endl;
+            return 1;
+        }
+
+        std::cout << "* Results saved in " << *json << "." << std::endl;
+    }
+
+    return 0;
+}
+
+// cases checked by the performance guard, one or two per kind of kernel
+static const char* GUARD_CASES = "kernel/uint32/equals,kernel/int64/greater_than,kernel/double/less_than_or_equal,"
+                                 "kernel/pointer/ptr_not_null,kernel/string/equals,kernel/bytes/match,"
+                                 "pattern/length16/wildcards25,scan/eq-anchored/0.0001/,scan/range-only/0.0001/";
+
+int guard_command(int argc, char** argv) {
+    argparse::Parser parser;
+
+    auto baselinePath = parser.AddArg<std::string>("baseline", "The baseline of this machine, written on the first run.");
+    auto tolerance = parser.AddArg<double>("tolerance", "Allowed slowdown before failing, 0.15 for 15 %.").Default(0.15);
+    auto update = parser.AddFlag("update", "Replace the baseline with this run.");
+    auto minTime = parser.AddArg<double>("min-time", "Minimum seconds spent on each case.").Default(0.3);
+
+    parser.ParseArgs(argc, argv);
+
+    if (!baselinePath) {
+        std::cout << "Usage: " << argv[0] << " --baseline <file> [--tolerance 0.15] [--update] [--min-time seconds]" << std::endl;
+        return 1;
+    }
+
+    std::ifstream baselineFile {*baselinePath};
+    bool record = !baselineFile.is_open() || *update > 0;
+    json baseline;
+
+    if (!record) {
+        baseline = json::parse(baselineFile, nullptr, false);
+
+        if (baseline.is_discarded()) {
+            std::cout << "[-] Failed to parse " << *baselinePath << "." << std::endl;
+            return 1;
+        }
+
+        // timings of another machine, compiler or build type say nothing about a regression
+        json machine = BenchmarkRunner::machineInfo();
+        json recorded = baseline.value("machine", json::object());
+
+        for (const char* key : { "host", "cores", "compiler", "build" }) {
+            if (recorded.value(key, json()) == machine[key]) continue;
+
+            std::cout << "[-] The baseline was recorded with " << key << " " << recorded.value(key, json()).dump() << ", this run has "
+                      << machine[key].dump() << ". Record a baseline for this machine and build with --update." << std::endl;
+            return 1;
+        }
+    }
+
+    BenchmarkRunner runner {*minTime, GUARD_CASES};
+
+    benchKernels(runner);
+    benchPatterns(runner);
+    benchScans(runner, 16 * 1024 * 1024);
+
+    if (record) {
+        std::ofstream file {*baselinePath};
+        file << runner.toJson().dump(2) << std::endl;
+
+        if (!file) {
+            std::cout << "[-] Failed to write " << *baselinePath << "." << std::endl;
+            return 1;
+        }
+
+        std::cout << "* Baseline saved in " << *baselinePath << ", later runs are compared with it." << std::endl;
+        return 0;
+    }
+
+    size_t compared = 0;
+    std::vector<BenchmarkRegression> regressions = runner.findRegressions(baseline, *tolerance, compared);
+
+    for (const BenchmarkRegression& regression : regressions) {
+        printf("[-] %s: %.3f ns/offset, baseline %.3f ns/offset (+%.1f %%)\n", regression.name.c_str(), regression.currentNsPerItem,
+               regression.baselineNsPerItem, 100 * (regression.currentNsPerItem / regression.baselineNsPerItem - 1));
+    }
+
+    if (!regressions.empty()) return 1;
+
+    if (compared == 0) {
+        std::cout << "[-] None of the cases run are in the baseline, record a new one with --update." << std::endl;
+        return 1;
+    }
+
+    std::cout << "* " << compared << " cases within " << *tolerance * 100 << " % of the baseline";
+    if (compared < runner.getResults().size()) std::cout << ", " << runner.getResults().size() - compared << " cases not in the baseline were not compared";
+    std::cout << "." << std::endl;
+    return 0;
+}
+
+int diff_command(int argc, char** argv) {
+    argparse::Parser parser;
+
+    auto cases = parser.AddArg<size_t>("cases", 'n', "Random cases to run.").Default(1000);
+    auto seed = parser.AddArg<uint64_t>("seed", "Seed of the cases, 0 for a random one.").Default(0);
+    auto maxSize = parser.AddArg<size_t>("max-size", "Largest buffer of a case, in bytes.").Default(4096);
+    auto workDirectory = parser.AddArg<std::string>("work-dir", "Where the dumps and indexes of the cases are written.").Default("/tmp");
+    auto output = parser.AddArg<std::string>("output", 'o', "Prefix of the reproducer written when an engine disagrees.").Default("/tmp/walker_diff_failure");
+
+    parser.ParseArgs(argc, argv);
+
+    uint64_t caseSeed = *seed != 0 ? *seed : std::random_device{}();
+    std::cout << "* Running " << *cases << " cases with --seed " << caseSeed << "." << std::endl;
+
+    DifferentialTester tester {caseSeed, *maxSize, *workDirectory};
+    DiffFailure failure;
+
+    if (tester.run(*cases, failure)) {
+        std::cout << "* Every engine agrees with the reference scan, " << tester.getComparisons() << " comparisons." << std::endl;
+        return 0;
+    }
+
+    if (failure.engine.empty()) {
+        std::cout << "[-] " << failure.reason << "." << std::endl;
+        return 1;
+    }
+
+    std::cout << "[-] " << failure.engine << ": " << failure.reason << "." << std::endl;
+    std::cout << "Shrunk case, " << failure.testCase.data.size() << " bytes:" << std::endl << failure.testCase.structure.dump() << std::endl;
+
+    if (DifferentialTester::save(failure.testCase, *output)) {
+        std::cout << "* Reproduce with: walker -f " << *output << ".bin -s " << *output << ".json" << std::endl;
+    }
+
+    return 1;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::string(argv[1]) == "macro") return macro_command(argc - 1, argv + 1);
+    if (argc > 1 && std::string(argv[1]) == "guard") return guard_command(argc - 1, argv + 1);
+    if (argc > 1 && std::string(argv[1]) == "diff") return diff_command(argc - 1, argv + 1);
+
+    argparse::Parser parser;
+
+    auto output = parser.AddArg<std::string>("json", "Write the results to a JSON file.");
+    auto filter = parser.AddArg<std::string>("filter", "Only run the cases whose group/name contains one of these comma separated strings.").Default("");
+    auto minTime = parser.AddArg<double>("min-time", "Minimum seconds spent on each case.").Default(0.3);
+    auto scanSize = parser.AddArg<size_t>("scan-size", "MiB of buffer for the whole scan cases.").Default(64);
+
+    parser.ParseArgs(argc, argv);
+
+    BenchmarkRunner runner {*minTime, *filter};
+
+    benchKernels(runner);
+    benchPatterns(runner);
+    benchScans(runner, *scanSize * 1024 * 1024);
+
+    runner.printTable(std::cout);
+
+    if (output) {
+        std::ofstream file {*output};
+        file << runner.toJson().dump(2) << std::endl;
+
+        if (!file) {
+            std::cerr << "[-] Failed to write " << *output << "." << std::endl;
+            return 1;
+        }
+
+        std::cout << "* Results saved in " << *output << "." << std::endl;
+    }
+
+    return 0;
+}
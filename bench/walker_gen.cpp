@@ -0,0 +1,93 @@
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#include "../lib/argparse.h"
+
+#include "../scanner/StructureParser.h"
+
+#include "DumpGenerator.h"
+
+// same layout as the text output of walker, so both can be compared with diff
+static bool writeOffsets(const std::string& path, const std::vector<uint64_t>& offsets) {
+    std::ofstream file {path};
+    char line[24];
+
+    for (uint64_t offset : offsets) {
+        int length = snprintf(line, sizeof(line), "0x%llx\n", (unsigned long long) offset);
+        file.write(line, length);
+    }
+
+    return (bool) file;
+}
+
+int main(int argc, char** argv) {
+    argparse::Parser parser;
+
+    auto output = parser.AddArg<std::string>("output", 'o', "The dump file to write.");
+    auto structure = parser.AddArg<std::string>("structure", 's', "The structure JSON file to plant.");
+    auto truth = parser.AddArg<std::string>("truth", "The file listing the planted offsets, <output>.truth by default.");
+    auto size = parser.AddArg<size_t>("size", "Size of the dump in MiB.").Default(64);
+    auto seed = parser.AddArg<uint64_t>("seed", "Seed of the generator, the same seed gives the same dump.").Default(1);
+    auto count = parser.AddArg<size_t>("count", "Number of planted instances.").Default(1000);
+    auto alignment = parser.AddArg<size_t>("align", "Planted instances start at multiples of this.").Default(8);
+    auto mixDescription = parser.AddArg<std::string>("mix", "Share of each content: zero, heap, strings, random.").Default("zero=20,heap=40,strings=20,random=20");
+
+    parser.ParseArgs(argc, argv);
+
+    ContentMix mix{};
+
+    if (!output || !ContentMix::parse(*mixDescription, mix)) {
+        std::cout << "Usage: " << argv[0] << " -o <output> [-s structure] [--size MiB] [--seed N] [--count N] [--align N] [--mix zero=20,heap=40,strings=20,random=20] [--truth file]" << std::endl;
+        return 1;
+    }
+
+    size_t dumpSize = *size * 1024 * 1024;
+    std::vector<char> dump(dumpSize);
+    DumpGenerator generator {*seed, mix};
+
+    generator.fill(dump.data(), dump.size());
+
+    if (structure) {
+        StructureParser structureParser {*structure};
+        std::shared_ptr<CompiledStructure> compiled = structureParser.compile();
+        std::vector<uint64_t> planted, accidental;
+
+        if (!generator.plant(*compiled, dump.data(), dump.size(), *count, *alignment, planted)) {
+            std::cout << "[-] Failed to plant the structure, its criteria cannot be met or the dump is too small." << std::endl;
+            return 1;
+        }
+
+        generator.breakAccidentalMatches(*compiled, dump.data(), dump.size(), planted, accidental);
+
+        // the truth is what was planted, the matches left by accident are listed aside
+        std::string truthPath = truth ? *truth : *output + ".truth";
+        std::string accidentalPath = truthPath + ".accidental";
+
+        if (!writeOffsets(truthPath, planted)) {
+            std::cout << "[-] Failed to write " << truthPath << "." << std::endl;
+            return 1;
+        }
+
+        std::remove(accidentalPath.c_str());
+
+        if (!accidental.empty() && !writeOffsets(accidentalPath, accidental)) {
+            std::cout << "[-] Failed to write " << accidentalPath << "." << std::endl;
+            return 1;
+        }
+
+        std::cout << "* Planted " << planted.size() << " instances, offsets saved in " << truthPath << "." << std::endl;
+        if (!accidental.empty()) std::cout << "* The structure also matches at " << accidental.size() << " offsets that could not be changed, listed in " << accidentalPath << "." << std::endl;
+    }
+
+    std::ofstream dumpFile {*output, std::ios::binary};
+    dumpFile.write(dump.data(), (std::streamsize) dump.size());
+
+    if (!dumpFile) {
+        std::cout << "[-] Failed to write " << *output << "." << std::endl;
+        return 1;
+    }
+
+    std::cout << "* Dump of " << dump.size() << " bytes saved in " << *output << "." << std::endl;
+    return 0;
+}
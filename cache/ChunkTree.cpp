@@ -0,0 +1,102 @@
+#include "ChunkTree.h"
+
+#include "ContentHash.h"
+
+ChunkTree ChunkTree::build(const uint8_t* data, size_t size, ThreadPool* pool, size_t chunkSize) {
+    ChunkTree tree;
+    tree.chunkSize = chunkSize;
+    tree.dataSize = size;
+    tree.buildLevels(ContentHash::hashChunks(data, size, chunkSize, pool));
+
+    return tree;
+}
+
+void ChunkTree::buildLevels(std::vector<uint64_t> leaves) {
+    levels.clear();
+    levels.push_back(std::move(leaves));
+
+    while (levels.back().size() > 1) {
+        const std::vector<uint64_t>& children = levels.back();
+        std::vector<uint64_t> parents((children.size() + 1) / 2);
+
+        for (size_t i = 0; i < parents.size(); i++) {
+            // an odd node out is carried up unchanged
+            if (2 * i + 1 == children.size()) {
+                parents[i] = children[2 * i];
+                continue;
+            }
+
+            parents[i] = ContentHash::hash(&children[2 * i], 2 * sizeof(uint64_t));
+        }
+
+        levels.push_back(std::move(parents));
+    }
+}
+
+uint64_t ChunkTree::getRoot() const {
+    uint64_t top = empty() || levels.back().empty() ? 0 : levels.back()[0];
+    uint64_t parameters[] = { top, dataSize, chunkSize };
+
+    // the size is part of the root, a file that only grew by zeros still gets a new fingerprint
+    return ContentHash::hash(parameters, sizeof(parameters));
+}
+
+std::vector<size_t> ChunkTree::changedChunks(const ChunkTree& previous) const {
+    std::vector<size_t> changes;
+    size_t count = getChunkCount();
+
+    if (previous.chunkSize != chunkSize || previous.empty()) {
+        for (size_t i = 0; i < count; i++) changes.push_back(i);
+        return changes;
+    }
+
+    // trees of the same shape are compared from the root, unchanged subtrees are skipped
+    if (previous.getChunkCount() == count) {
+        if (count > 0) collectChanges(previous, levels.size() - 1, 0, changes);
+        return changes;
+    }
+
+    const std::vector<uint64_t>& leaves = levels[0];
+    const std::vector<uint64_t>& previousLeaves = previous.levels[0];
+
+    for (size_t i = 0; i < count; i++) {
+        if (i >= previousLeaves.size() || leaves[i] != previousLeaves[i]) changes.push_back(i);
+    }
+
+    return changes;
+}
+
+void ChunkTree::collectChanges(const ChunkTree& previous, size_t level, size_t index, std::vector<size_t>& changes) const {
+    if (levels[level][index] == previous.levels[level][index]) return;
+
+    if (level == 0) {
+        changes.push_back(index);
+        return;
+    }
+
+    collectChanges(previous, level - 1, 2 * index, changes);
+    if (2 * index + 1 < levels[level - 1].size()) collectChanges(previous, level - 1, 2 * index + 1, changes);
+}
+
+bool ChunkTree::read(FILE* file) {
+    uint64_t header[3];
+    if (fread(header, sizeof(header), 1, file) != 1) return false;
+
+    chunkSize = header[0];
+    dataSize = header[1];
+
+    if (chunkSize == 0 || header[2] != (dataSize + chunkSize - 1) / chunkSize) return false;
+
+    std::vector<uint64_t> leaves(header[2]);
+    if (!leaves.empty() && fread(leaves.data(), sizeof(uint64_t), leaves.size(), file) != leaves.size()) return false;
+
+    buildLevels(std::move(leaves));
+    return true;
+}
+
+bool ChunkTree::write(FILE* file) const {
+    uint64_t header[3] = { chunkSize, dataSize, getChunkCount() };
+    if (fwrite(header, sizeof(header), 1, file) != 1) return false;
+
+    return empty() || levels[0].empty() || fwrite(levels[0].data(), sizeof(uint64_t), levels[0].size(), file) == levels[0].size();
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "../scanner/ThreadPool.h"
+
+// Merkle tree over the fixed-size chunks of a buffer. Leaves are the chunk hashes, every parent
+// hashes its two children, so two versions of a file are compared from the root down and only
+// the subtrees that differ are visited.
+class ChunkTree {
+public:
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 1024 * 1024;
+
+    static ChunkTree build(const uint8_t* data, size_t size, ThreadPool* pool, size_t chunkSize = DEFAULT_CHUNK_SIZE);
+
+    bool empty() const { return levels.empty(); }
+    uint64_t getRoot() const;
+    size_t getChunkSize() const { return chunkSize; }
+    uint64_t getDataSize() const { return dataSize; }
+    size_t getChunkCount() const { return empty() ? 0 : levels[0].size(); }
+
+    // indexes of the chunks of this tree whose content differs from the previous tree
+    std::vector<size_t> changedChunks(const ChunkTree& previous) const;
+
+    bool read(FILE* file);
+    bool write(FILE* file) const;
+
+private:
+    void buildLevels(std::vector<uint64_t> leaves);
+    void collectChanges(const ChunkTree& previous, size_t level, size_t index, std::vector<size_t>& changes) const;
+
+    size_t chunkSize = DEFAULT_CHUNK_SIZE;
+    uint64_t dataSize = 0;
+
+    // levels[0] holds the leaves, the last level the root
+    std::vector<std::vector<uint64_t>> levels;
+};
@@ -0,0 +1,132 @@
+#include "ContentHash.h"
+
+#include <algorithm>
+#include <cstring>
+#include <future>
+
+static constexpr uint64_t PRIME1 = 11400714785074694791ULL;
+static constexpr uint64_t PRIME2 = 14029467366897019727ULL;
+static constexpr uint64_t PRIME3 = 1609587929392839161ULL;
+static constexpr uint64_t PRIME4 = 9650029242287828579ULL;
+static constexpr uint64_t PRIME5 = 2870177450012600261ULL;
+
+static inline uint64_t rotateLeft(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static inline uint64_t read64(const uint8_t* data) {
+    uint64_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static inline uint32_t read32(const uint8_t* data) {
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static inline uint64_t mixRound(uint64_t accumulator, uint64_t input) {
+    accumulator += input * PRIME2;
+    accumulator = rotateLeft(accumulator, 31);
+    return accumulator * PRIME1;
+}
+
+static inline uint64_t mergeRound(uint64_t accumulator, uint64_t value) {
+    accumulator ^= mixRound(0, value);
+    return accumulator * PRIME1 + PRIME4;
+}
+
+uint64_t ContentHash::hash(const void* data, size_t size, uint64_t seed) {
+    auto input = (const uint8_t*) data;
+    const uint8_t* end = input + size;
+    uint64_t result;
+
+    if (size >= 32) {
+        // four independent lanes keep the multipliers busy
+        uint64_t v1 = seed + PRIME1 + PRIME2;
+        uint64_t v2 = seed + PRIME2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - PRIME1;
+        const uint8_t* limit = end - 32;
+
+        do {
+            v1 = mixRound(v1, read64(input));
+            v2 = mixRound(v2, read64(input + 8));
+            v3 = mixRound(v3, read64(input + 16));
+            v4 = mixRound(v4, read64(input + 24));
+            input += 32;
+        } while (input <= limit);
+
+        result = rotateLeft(v1, 1) + rotateLeft(v2, 7) + rotateLeft(v3, 12) + rotateLeft(v4, 18);
+        result = mergeRound(result, v1);
+        result = mergeRound(result, v2);
+        result = mergeRound(result, v3);
+        result = mergeRound(result, v4);
+    } else {
+        result = seed + PRIME5;
+    }
+
+    result += (uint64_t) size;
+
+    while (input + 8 <= end) {
+        result ^= mixRound(0, read64(input));
+        result = rotateLeft(result, 27) * PRIME1 + PRIME4;
+        input += 8;
+    }
+
+    if (input + 4 <= end) {
+        result ^= (uint64_t) read32(input) * PRIME1;
+        result = rotateLeft(result, 23) * PRIME2 + PRIME3;
+        input += 4;
+    }
+
+    while (input < end) {
+        result ^= (*input) * PRIME5;
+        result = rotateLeft(result, 11) * PRIME1;
+        input++;
+    }
+
+    result ^= result >> 33;
+    result *= PRIME2;
+    result ^= result >> 29;
+    result *= PRIME3;
+    result ^= result >> 32;
+
+    return result;
+}
+
+std::vector<uint64_t> ContentHash::hashChunks(const uint8_t* data, size_t size, size_t chunkSize, ThreadPool* pool) {
+    size_t chunkCount = (size + chunkSize - 1) / chunkSize;
+    std::vector<uint64_t> hashes(chunkCount);
+
+    auto hashChunk = [&](size_t i) {
+        size_t start = i * chunkSize;
+        hashes[i] = hash(data + start, std::min(chunkSize, size - start), i);
+    };
+
+    if (pool == nullptr || pool->getThreadCount() <= 1 || chunkCount <= 1) {
+        for (size_t i = 0; i < chunkCount; i++) hashChunk(i);
+        return hashes;
+    }
+
+    std::vector<std::future<void>> tasks;
+    tasks.reserve(chunkCount);
+
+    for (size_t i = 0; i < chunkCount; i++) {
+        tasks.push_back(pool->submit([&hashChunk, i] { hashChunk(i); }));
+    }
+
+    for (auto& task : tasks) task.get();
+
+    return hashes;
+}
+
+HashBuilder& HashBuilder::addBytes(const void* data, size_t size) {
+    bytes.insert(bytes.end(), (const uint8_t*) data, (const uint8_t*) data + size);
+    return *this;
+}
+
+uint64_t HashBuilder::get() const {
+    return ContentHash::hash(bytes.data(), bytes.size());
+}
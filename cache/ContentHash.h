@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "../scanner/ThreadPool.h"
+
+// 64-bit non-cryptographic hash (the XXH64 algorithm), used to fingerprint dumps and structures.
+// Large buffers are cut in fixed-size chunks hashed in parallel.
+class ContentHash {
+public:
+    static uint64_t hash(const void* data, size_t size, uint64_t seed = 0);
+
+    // hash of every chunkSize bytes of the buffer, the last chunk may be shorter
+    static std::vector<uint64_t> hashChunks(const uint8_t* data, size_t size, size_t chunkSize, ThreadPool* pool);
+};
+
+// Incremental hashing of small values, for hashing structured data
+class HashBuilder {
+public:
+    template<typename T>
+    HashBuilder& add(const T& value) {
+        return addBytes(&value, sizeof(value));
+    }
+
+    HashBuilder& addBytes(const void* data, size_t size);
+
+    uint64_t get() const;
+
+private:
+    std::vector<uint8_t> bytes;
+};
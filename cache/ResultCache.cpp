@@ -0,0 +1,298 @@
+#include "ResultCache.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ContentHash.h"
+#include "../scanner/ResultReader.h"
+
+// bumped whenever the way structures are hashed changes, so old entries are never reused
+static constexpr uint32_t STRUCTURE_HASH_VERSION = 1;
+
+static bool makeDirectories(const std::string& path) {
+    for (size_t position = 1; position <= path.size(); position++) {
+        if (position != path.size() && path[position] != '/') continue;
+
+        std::string parent = path.substr(0, position);
+        if (mkdir(parent.c_str(), 0755) != 0 && errno != EEXIST) return false;
+    }
+
+    struct stat info{};
+    return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+static std::string toHex(uint64_t value) {
+    char digits[17];
+    snprintf(digits, sizeof(digits), "%016llx", (unsigned long long) value);
+    return digits;
+}
+
+ResultCache::ResultCache(std::string directory, uint64_t maxSize) : directory(std::move(directory)), maxSize(maxSize) {
+    opened = makeDirectories(this->directory) && makeDirectories(this->directory + "/fingerprints");
+}
+
+std::string ResultCache::defaultDirectory() {
+    const char* configured = getenv("WALKER_CACHE_DIR");
+    if (configured != nullptr && *configured != '\0') return configured;
+
+    const char* xdgCache = getenv("XDG_CACHE_HOME");
+    if (xdgCache != nullptr && *xdgCache != '\0') return std::string(xdgCache) + "/walker";
+
+    const char* home = getenv("HOME");
+    if (home != nullptr && *home != '\0') return std::string(home) + "/.cache/walker";
+
+    return "/tmp/walker-cache";
+}
+
+std::string ResultCache::recordPath(const MappedFile& dump) const {
+    char resolved[PATH_MAX];
+    std::string path = realpath(dump.getPath().c_str(), resolved) != nullptr ? std::string(resolved) : dump.getPath();
+
+    return directory + "/fingerprints/" + toHex(ContentHash::hash(path.data(), path.size()));
+}
+
+uint64_t ResultCache::fingerprint(const MappedFile& dump, ThreadPool* pool, ChunkTree* current, ChunkTree* previous) {
+    std::string path = recordPath(dump);
+    FingerprintRecord record{};
+    ChunkTree recordedTree;
+
+    FILE* file = fopen(path.c_str(), "rb");
+
+    if (file != nullptr) {
+        bool read = fread(&record, sizeof(record), 1, file) == 1 && recordedTree.read(file);
+        fclose(file);
+
+        // an unchanged file keeps the fingerprint computed last time
+        if (read && record.inode == dump.getInode() && record.size == dump.size() && record.modificationTime == dump.getModificationTime()) {
+            if (current != nullptr) *current = std::move(recordedTree);
+            return record.fingerprint;
+        }
+
+        if (read && previous != nullptr) *previous = std::move(recordedTree);
+    }
+
+    ChunkTree tree = ChunkTree::build(dump.data(), dump.size(), pool);
+    record = FingerprintRecord{ dump.getInode(), dump.size(), dump.getModificationTime(), tree.getRoot() };
+
+    std::string temporary = path + ".tmp." + std::to_string(getpid());
+    file = fopen(temporary.c_str(), "wb");
+
+    if (file != nullptr) {
+        bool written = fwrite(&record, sizeof(record), 1, file) == 1 && tree.write(file);
+        written &= fclose(file) == 0;
+
+        if (!written || std::rename(temporary.c_str(), path.c_str()) != 0) std::remove(temporary.c_str());
+    }
+
+    if (current != nullptr) *current = std::move(tree);
+    return record.fingerprint;
+}
+
+uint64_t ResultCache::hashStructure(const CompiledStructure& structure) {
+    HashBuilder builder;
+    const std::vector<ScannerField>& fields = structure.getFields();
+
+    builder.add(STRUCTURE_HASH_VERSION).add((uint64_t) fields.size());
+
+    for (size_t i = 0; i < fields.size(); i++) {
+        const ScannerField& field = fields[i];
+        std::vector<uint64_t> criterias;
+
+        for (const ScannerCriteria& criteria : field.criterias) {
+            HashBuilder criteriaBuilder;
+            criteriaBuilder.add((uint32_t) criteria.type);
+
+            if (criteria.value == nullptr) {
+                // nullptr, notnullptr and any criteria have no value
+            } else if (field.primitive == SCANNER_PRIMITIVE_BYTES) {
+                std::vector<int> pattern = ScanUtils::parsePattern(*(const std::string*) criteria.value);
+                criteriaBuilder.addBytes(pattern.data(), pattern.size() * sizeof(int));
+            } else if (field.primitive == SCANNER_PRIMITIVE_STRING) {
+                auto value = (const char*) criteria.value;
+                criteriaBuilder.addBytes(value, strlen(value));
+            } else {
+                criteriaBuilder.addBytes(criteria.value, ScanUtils::getPrimitiveSize(field.primitive));
+            }
+
+            criterias.push_back(criteriaBuilder.get());
+        }
+
+        // every criteria of a field has to match, their order does not matter
+        std::sort(criterias.begin(), criterias.end());
+
+        builder.add((uint32_t) field.primitive).add((uint64_t) structure.getLayout().getFieldSize(i)).add((uint64_t) criterias.size());
+        builder.addBytes(criterias.data(), criterias.size() * sizeof(uint64_t));
+    }
+
+    return builder.get();
+}
+
+std::string ResultCache::entryPath(uint64_t fingerprint, uint64_t structureHash) const {
+    return directory + "/" + toHex(fingerprint) + "-" + toHex(structureHash) + RESULT_CACHE_EXTENSION;
+}
+
+std::string ResultCache::temporaryPath(uint64_t fingerprint, uint64_t structureHash) const {
+    return entryPath(fingerprint, structureHash) + ".tmp." + std::to_string(getpid());
+}
+
+bool ResultCache::contains(uint64_t fingerprint, uint64_t structureHash) const {
+    return opened && access(entryPath(fingerprint, structureHash).c_str(), R_OK) == 0;
+}
+
+bool ResultCache::load(uint64_t fingerprint, uint64_t structureHash, const MappedFile& dump, size_t valueSize, ResultSink& sink) {
+    if (!opened) return false;
+
+    std::string path = entryPath(fingerprint, structureHash);
+    ResultReader reader;
+
+    if (!reader.open(path) || reader.getFormat() != RESULT_FORMAT_BINARY || reader.getValueSize() != valueSize) return false;
+
+    // reading an entry makes it the most recently used one
+    utimensat(AT_FDCWD, path.c_str(), nullptr, 0);
+
+    auto data = (const char*) dump.data();
+    uint64_t offset;
+
+    while (reader.next(offset)) {
+        if (offset + valueSize > dump.size()) break;
+        if (!sink.push(ScannerResult{ valueSize, offset, (void*) (data + offset) })) break;
+    }
+
+    return true;
+}
+
+bool ResultCache::loadIncremental(uint64_t structureHash, const ChunkTree& previous, const ChunkTree& current, const CompiledStructure& structure,
+                                  const MappedFile& dump, ResultSink& sink, size_t& rescannedBytes) {
+    size_t valueSize = structure.getSize();
+    rescannedBytes = 0;
+
+    if (!opened || previous.empty() || current.empty() || valueSize == 0) return false;
+
+    std::string path = entryPath(previous.getRoot(), structureHash);
+    ResultReader reader;
+
+    if (!reader.open(path) || reader.getFormat() != RESULT_FORMAT_BINARY || reader.getValueSize() != valueSize) return false;
+
+    utimensat(AT_FDCWD, path.c_str(), nullptr, 0);
+
+    auto data = (const char*) dump.data();
+    size_t size = dump.size();
+    size_t chunkSize = current.getChunkSize();
+
+    // start offsets to evaluate again: every structure overlapping a changed chunk, merged in increasing order
+    std::vector<std::pair<size_t, size_t>> ranges;
+
+    for (size_t chunk : current.changedChunks(previous)) {
+        size_t start = chunk * chunkSize;
+        size_t end = std::min(start + chunkSize, size);
+        start = start >= valueSize - 1 ? start - (valueSize - 1) : 0;
+
+        if (!ranges.empty() && start <= ranges.back().second) {
+            ranges.back().second = std::max(ranges.back().second, end);
+        } else {
+            ranges.emplace_back(start, end);
+        }
+    }
+
+    bool stopped = false;
+    uint64_t offset;
+    bool hasPrevious = reader.next(offset);
+
+    // results of the previous version are still valid when all their bytes are in unchanged chunks
+    auto reuseUntil = [&](size_t limit) {
+        while (hasPrevious && offset < limit && !stopped) {
+            if (offset + valueSize <= size) stopped = !sink.push(ScannerResult{ valueSize, offset, (void*) (data + offset) });
+            hasPrevious = reader.next(offset);
+        }
+    };
+
+    for (const auto& range : ranges) {
+        reuseUntil(range.first);
+        if (stopped) break;
+
+        while (hasPrevious && offset < range.second) hasPrevious = reader.next(offset);
+
+        size_t base = range.first;
+        size_t end = std::min(range.second + valueSize - 1, size);
+
+        CallbackSink shifted([&](const ScannerResult& result) {
+            stopped = !sink.push(ScannerResult{ result.valueSize, result.offset + base, result.value });
+            return !stopped;
+        });
+
+        structure.scan(data + base, end - base, shifted);
+        rescannedBytes += end - base;
+
+        if (stopped) break;
+    }
+
+    reuseUntil(SIZE_MAX);
+
+    return true;
+}
+
+bool ResultCache::commit(uint64_t fingerprint, uint64_t structureHash) {
+    std::string temporary = temporaryPath(fingerprint, structureHash);
+
+    if (std::rename(temporary.c_str(), entryPath(fingerprint, structureHash).c_str()) != 0) {
+        std::remove(temporary.c_str());
+        return false;
+    }
+
+    evict();
+    return true;
+}
+
+void ResultCache::discard(uint64_t fingerprint, uint64_t structureHash) {
+    std::remove(temporaryPath(fingerprint, structureHash).c_str());
+}
+
+void ResultCache::evict() {
+    struct Entry {
+        std::string path;
+        uint64_t size;
+        int64_t accessTime;
+    };
+
+    std::vector<Entry> entries;
+    uint64_t totalSize = 0;
+
+    DIR* handle = opendir(directory.c_str());
+    if (handle == nullptr) return;
+
+    while (struct dirent* item = readdir(handle)) {
+        std::string name = item->d_name;
+
+        if (name.size() <= RESULT_CACHE_EXTENSION.size()) continue;
+        if (name.compare(name.size() - RESULT_CACHE_EXTENSION.size(), RESULT_CACHE_EXTENSION.size(), RESULT_CACHE_EXTENSION) != 0) continue;
+
+        std::string path = directory + "/" + name;
+        struct stat info{};
+
+        if (stat(path.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) continue;
+
+        entries.push_back(Entry{ path, (uint64_t) info.st_size, (int64_t) info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec });
+        totalSize += (uint64_t) info.st_size;
+    }
+
+    closedir(handle);
+
+    if (totalSize <= maxSize) return;
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.accessTime < b.accessTime; });
+
+    for (const Entry& entry : entries) {
+        if (totalSize <= maxSize) break;
+        if (std::remove(entry.path.c_str()) == 0) totalSize -= entry.size;
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "../scanner/CompiledStructure.h"
+#include "../scanner/MappedFile.h"
+#include "../scanner/ResultSink.h"
+#include "../scanner/ThreadPool.h"
+
+#include "ChunkTree.h"
+
+// On-disk cache of complete scan results, addressed by the content of the dump and by the
+// normalised structure, so the same query on the same bytes is answered without scanning.
+//
+// Entries are binary result files named <fingerprint>-<structure hash>.wlkr. The fingerprint of a
+// dump is the root of its chunk tree, remembered along with its inode, size and modification time
+// so files that did not change since are not hashed again. When a file did change, the tree of its
+// previous version tells which chunks have to be scanned again, the results of the other chunks
+// are reused. Reading an entry refreshes its modification time, the least recently used entries
+// are removed once the cache grows over its size limit.
+
+const std::string RESULT_CACHE_EXTENSION = ".wlkr";
+
+class ResultCache {
+public:
+    static constexpr uint64_t DEFAULT_MAX_SIZE = 1024ULL * 1024 * 1024;
+
+    explicit ResultCache(std::string directory, uint64_t maxSize = DEFAULT_MAX_SIZE);
+
+    // $WALKER_CACHE_DIR, or walker/ in the user cache directory
+    static std::string defaultDirectory();
+
+    bool isOpen() const { return opened; }
+    const std::string& getDirectory() const { return directory; }
+
+    // current receives the chunk tree of the dump, previous the one recorded for an earlier
+    // version of the same path when the file changed since
+    uint64_t fingerprint(const MappedFile& dump, ThreadPool* pool, ChunkTree* current = nullptr, ChunkTree* previous = nullptr);
+
+    // hash of what the structure matches: criteria order and pattern spelling do not change it
+    static uint64_t hashStructure(const CompiledStructure& structure);
+
+    bool contains(uint64_t fingerprint, uint64_t structureHash) const;
+
+    // replays a cached entry into the sink, returns false when the entry is missing or invalid
+    bool load(uint64_t fingerprint, uint64_t structureHash, const MappedFile& dump, size_t valueSize, ResultSink& sink);
+
+    // rebuilds the results of a changed dump from the entry of its previous version, scanning again
+    // only the structures that overlap a changed chunk; returns false when there is no such entry
+    bool loadIncremental(uint64_t structureHash, const ChunkTree& previous, const ChunkTree& current, const CompiledStructure& structure,
+                         const MappedFile& dump, ResultSink& sink, size_t& rescannedBytes);
+
+    // new entries are written to a temporary file, then committed once the scan is complete
+    std::string temporaryPath(uint64_t fingerprint, uint64_t structureHash) const;
+    bool commit(uint64_t fingerprint, uint64_t structureHash);
+    void discard(uint64_t fingerprint, uint64_t structureHash);
+
+private:
+    struct FingerprintRecord {
+        uint64_t inode;
+        uint64_t size;
+        int64_t modificationTime;
+        uint64_t fingerprint;
+    };
+
+    std::string entryPath(uint64_t fingerprint, uint64_t structureHash) const;
+    std::string recordPath(const MappedFile& dump) const;
+
+    void evict();
+
+    std::string directory;
+    uint64_t maxSize;
+    bool opened = false;
+};
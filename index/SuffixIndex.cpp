@@ -0,0 +1,314 @@
+#include "SuffixIndex.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+// SA-IS suffix array construction (Nong, Zhang & Chan), linear in the size of the text.
+// The top level reads the bytes of the file directly, recursion levels work on reduced texts.
+template<typename Index, typename Char>
+static std::vector<Index> suffixArray(const Char* text, Index n, Index upper) {
+    if (n == 0) return {};
+    if (n == 1) return { 0 };
+    if (n == 2) return text[0] < text[1] ? std::vector<Index>{ 0, 1 } : std::vector<Index>{ 1, 0 };
+
+    std::vector<Index> sa(n);
+    std::vector<bool> isS(n);
+
+    for (Index i = n - 2; i >= 0; i--) {
+        isS[i] = text[i] == text[i + 1] ? isS[i + 1] : text[i] < text[i + 1];
+    }
+
+    // start of the L and S parts of every bucket
+    std::vector<Index> sumL(upper + 1), sumS(upper + 1);
+
+    for (Index i = 0; i < n; i++) {
+        if (!isS[i]) {
+            sumS[text[i]]++;
+        } else {
+            sumL[text[i] + 1]++;
+        }
+    }
+
+    for (Index i = 0; i <= upper; i++) {
+        sumS[i] += sumL[i];
+        if (i < upper) sumL[i + 1] += sumS[i];
+    }
+
+    auto induce = [&](const std::vector<Index>& lms) {
+        std::fill(sa.begin(), sa.end(), -1);
+        std::vector<Index> buckets(upper + 1);
+
+        std::copy(sumS.begin(), sumS.end(), buckets.begin());
+        for (Index d : lms) {
+            if (d == n) continue;
+            sa[buckets[text[d]]++] = d;
+        }
+
+        std::copy(sumL.begin(), sumL.end(), buckets.begin());
+        sa[buckets[text[n - 1]]++] = n - 1;
+        for (Index i = 0; i < n; i++) {
+            Index v = sa[i];
+            if (v >= 1 && !isS[v - 1]) sa[buckets[text[v - 1]]++] = v - 1;
+        }
+
+        std::copy(sumL.begin(), sumL.end(), buckets.begin());
+        for (Index i = n - 1; i >= 0; i--) {
+            Index v = sa[i];
+            if (v >= 1 && isS[v - 1]) sa[--buckets[text[v - 1] + 1]] = v - 1;
+        }
+    };
+
+    std::vector<Index> lmsMap(n + 1, -1);
+    std::vector<Index> lms;
+    Index m = 0;
+
+    for (Index i = 1; i < n; i++) {
+        if (!isS[i - 1] && isS[i]) lmsMap[i] = m++;
+    }
+
+    lms.reserve(m);
+    for (Index i = 1; i < n; i++) {
+        if (!isS[i - 1] && isS[i]) lms.push_back(i);
+    }
+
+    induce(lms);
+
+    if (m > 0) {
+        std::vector<Index> sortedLms;
+        sortedLms.reserve(m);
+
+        for (Index v : sa) {
+            if (lmsMap[v] != -1) sortedLms.push_back(v);
+        }
+
+        // name the LMS substrings, equal substrings share a name
+        std::vector<Index> reduced(m);
+        Index reducedUpper = 0;
+        reduced[lmsMap[sortedLms[0]]] = 0;
+
+        for (Index i = 1; i < m; i++) {
+            Index left = sortedLms[i - 1], right = sortedLms[i];
+            Index leftEnd = lmsMap[left] + 1 < m ? lms[lmsMap[left] + 1] : n;
+            Index rightEnd = lmsMap[right] + 1 < m ? lms[lmsMap[right] + 1] : n;
+            bool same = true;
+
+            if (leftEnd - left != rightEnd - right) {
+                same = false;
+            } else {
+                while (left < leftEnd && text[left] == text[right]) {
+                    left++;
+                    right++;
+                }
+
+                if (left == n || text[left] != text[right]) same = false;
+            }
+
+            if (!same) reducedUpper++;
+            reduced[lmsMap[sortedLms[i]]] = reducedUpper;
+        }
+
+        std::vector<Index> reducedSa = suffixArray<Index, Index>(reduced.data(), m, reducedUpper);
+
+        for (Index i = 0; i < m; i++) sortedLms[i] = lms[reducedSa[i]];
+        induce(sortedLms);
+    }
+
+    return sa;
+}
+
+template<typename Index>
+static bool writeSuffixArray(int fd, const uint8_t* data, size_t size) {
+    std::vector<Index> sa = suffixArray<Index, uint8_t>(data, (Index) size, 255);
+
+    auto bytes = (const char*) sa.data();
+    size_t remaining = sa.size() * sizeof(Index);
+
+    while (remaining > 0) {
+        ssize_t written = write(fd, bytes, remaining);
+        if (written <= 0) return false;
+
+        bytes += written;
+        remaining -= written;
+    }
+
+    return true;
+}
+
+bool SuffixIndex::build(const MappedFile& dump, const std::string& indexPath) {
+    SuffixIndexHeader header{};
+    memcpy(header.magic, SUFFIX_INDEX_MAGIC, sizeof(SUFFIX_INDEX_MAGIC));
+    header.version = SUFFIX_INDEX_VERSION;
+    header.dumpSize = dump.size();
+    header.dumpModificationTime = dump.getModificationTime();
+    header.dumpInode = dump.getInode();
+
+    // 32-bit entries halve the index size whenever the offsets fit
+    bool small = dump.size() < (size_t) std::numeric_limits<int32_t>::max();
+    header.entryWidth = small ? 4 : 8;
+
+    std::string temporaryPath = indexPath + ".tmp";
+    int fd = ::open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+
+    bool success = write(fd, &header, sizeof(header)) == (ssize_t) sizeof(header);
+
+    if (success && small) {
+        success = writeSuffixArray<int32_t>(fd, dump.data(), dump.size());
+    } else if (success) {
+        success = writeSuffixArray<int64_t>(fd, dump.data(), dump.size());
+    }
+
+    ::close(fd);
+
+    if (success) success = std::rename(temporaryPath.c_str(), indexPath.c_str()) == 0;
+    if (!success) std::remove(temporaryPath.c_str());
+
+    return success;
+}
+
+bool SuffixIndex::open(const std::string& indexPath, const MappedFile& dump) {
+    header = nullptr;
+
+    if (!file.open(indexPath) || file.size() < sizeof(SuffixIndexHeader)) return false;
+
+    auto candidate = (const SuffixIndexHeader*) file.data();
+
+    if (memcmp(candidate->magic, SUFFIX_INDEX_MAGIC, sizeof(SUFFIX_INDEX_MAGIC)) != 0) return false;
+    if (candidate->version != SUFFIX_INDEX_VERSION) return false;
+    if (candidate->entryWidth != 4 && candidate->entryWidth != 8) return false;
+
+    // an index built for another version of the file would return wrong candidates
+    if (candidate->dumpSize != dump.size()) return false;
+    if (candidate->dumpModificationTime != dump.getModificationTime() || candidate->dumpInode != dump.getInode()) return false;
+    if (sizeof(SuffixIndexHeader) + candidate->dumpSize * candidate->entryWidth > file.size()) return false;
+
+    header = candidate;
+    entries = file.data() + sizeof(SuffixIndexHeader);
+
+    return true;
+}
+
+size_t SuffixIndex::entryAt(size_t position) const {
+    if (header->entryWidth == 4) return (size_t) ((const int32_t*) entries)[position];
+    return (size_t) ((const int64_t*) entries)[position];
+}
+
+std::pair<size_t, size_t> SuffixIndex::findRange(const std::string& literal, const char* data, size_t size) const {
+    // compares the suffix at a position with the literal, suffixes shorter than it sort first
+    auto compare = [&](size_t position) {
+        size_t suffix = entryAt(position);
+        size_t length = std::min(literal.size(), size - suffix);
+        int result = memcmp(data + suffix, literal.data(), length);
+
+        if (result != 0) return result;
+        return length < literal.size() ? -1 : 0;
+    };
+
+    size_t low = 0, high = header->dumpSize;
+
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (compare(middle) < 0) low = middle + 1; else high = middle;
+    }
+
+    size_t first = low;
+    high = header->dumpSize;
+
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (compare(middle) <= 0) low = middle + 1; else high = middle;
+    }
+
+    return { first, low };
+}
+
+// Literal segments of a field that every match must contain, with their offset in the field
+static std::vector<std::pair<size_t, std::string>> literalSegments(const ScannerField& field) {
+    std::vector<std::pair<size_t, std::string>> segments;
+
+    for (const ScannerCriteria& criteria : field.criterias) {
+        if (field.primitive == SCANNER_PRIMITIVE_BYTES && criteria.type == SCANNER_CRITERIA_BYTES_MATCH) {
+            std::vector<int> pattern = ScanUtils::parsePattern(*(std::string*) criteria.value);
+            if (pattern.size() != field.size) continue;
+
+            std::string current;
+
+            for (size_t i = 0; i <= pattern.size(); i++) {
+                if (i < pattern.size() && pattern[i] >= 0) {
+                    current += (char) pattern[i];
+                    continue;
+                }
+
+                if (!current.empty()) segments.emplace_back(i - current.size(), current);
+                current.clear();
+            }
+        } else if (field.primitive == SCANNER_PRIMITIVE_STRING && criteria.type == SCANNER_CRITERIA_EQUAL) {
+            auto value = (const char*) criteria.value;
+            segments.emplace_back(0, std::string(value, std::min(field.size, strlen(value))));
+        }
+    }
+
+    return segments;
+}
+
+bool SuffixIndex::findSegment(const CompiledStructure& structure, const char* data, size_t size, Segment& segment, size_t& count) const {
+    const std::vector<ScannerField>& fields = structure.getFields();
+    bool found = false;
+
+    for (size_t i = 0; i < fields.size(); i++) {
+        for (auto& literal : literalSegments(fields[i])) {
+            if (literal.second.size() < MIN_SEGMENT_SIZE) continue;
+
+            std::pair<size_t, size_t> range = findRange(literal.second, data, size);
+            size_t occurrences = range.second - range.first;
+
+            if (!found || occurrences < count) {
+                segment = Segment{ i, literal.first, literal.second };
+                count = occurrences;
+                found = true;
+            }
+        }
+    }
+
+    return found;
+}
+
+bool SuffixIndex::scan(const CompiledStructure& structure, const char* data, size_t size, ResultSink& sink, size_t& candidates) const {
+    Segment segment{};
+    size_t count = 0;
+
+    if (header == nullptr || structure.isEmpty() || size != header->dumpSize) return false;
+    if (!findSegment(structure, data, size, segment, count)) return false;
+
+    // past this point a sequential pass is cheaper than random accesses into the file
+    if (count > size / 16) return false;
+
+    size_t segmentOffset = structure.getLayout().getFieldOffset(segment.field) + segment.offset;
+    size_t structureSize = structure.getSize();
+
+    std::pair<size_t, size_t> range = findRange(segment.bytes, data, size);
+    std::vector<uint64_t> starts;
+    starts.reserve(count);
+
+    for (size_t i = range.first; i < range.second; i++) {
+        size_t position = entryAt(i);
+        if (position >= segmentOffset) starts.push_back(position - segmentOffset);
+    }
+
+    std::sort(starts.begin(), starts.end());
+    candidates = starts.size();
+
+    for (uint64_t start : starts) {
+        if (start + structureSize > size) break;
+        if (!structure.matches(data + start)) continue;
+
+        if (!sink.push(ScannerResult{ structureSize, start, (void*) (data + start) })) break;
+    }
+
+    return true;
+}
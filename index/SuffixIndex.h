@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../scanner/CompiledStructure.h"
+#include "../scanner/MappedFile.h"
+#include "../scanner/ResultSink.h"
+
+// Side-car suffix array of a file, for repeated byte signature searches on the same image.
+// `bytes` fields with `match` criteria and `string` fields with `eq` criteria are split into
+// literal segments by their wildcards. Every segment is counted with a binary search, the one with
+// the fewest occurrences gives the candidates, which are then verified against the file.
+//
+// File layout: SuffixIndexHeader followed by the suffix array, stored on 4 or 8 bytes per entry.
+
+const char SUFFIX_INDEX_MAGIC[4] = { 'W', 'S', 'A', 'X' };
+const uint32_t SUFFIX_INDEX_VERSION = 1;
+const std::string SUFFIX_INDEX_EXTENSION = ".wsa";
+
+struct SuffixIndexHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t dumpSize;
+    int64_t dumpModificationTime;
+    uint64_t dumpInode;
+    uint64_t entryWidth;
+};
+
+class SuffixIndex {
+public:
+    // literal segments shorter than this match too many places to be worth looking up
+    static constexpr size_t MIN_SEGMENT_SIZE = 2;
+
+    static bool build(const MappedFile& dump, const std::string& indexPath);
+
+    bool open(const std::string& indexPath, const MappedFile& dump);
+
+    // scans through the index, returns false when the structure has no literal long enough
+    // or when the index would not narrow the scan down enough
+    bool scan(const CompiledStructure& structure, const char* data, size_t size, ResultSink& sink, size_t& candidates) const;
+
+private:
+    struct Segment {
+        size_t field;
+        size_t offset;
+        std::string bytes;
+    };
+
+    bool findSegment(const CompiledStructure& structure, const char* data, size_t size, Segment& segment, size_t& count) const;
+    std::pair<size_t, size_t> findRange(const std::string& literal, const char* data, size_t size) const;
+
+    size_t entryAt(size_t position) const;
+
+    MappedFile file;
+    const SuffixIndexHeader* header = nullptr;
+    const void* entries = nullptr;
+};
@@ -0,0 +1,444 @@
+#include "ValueIndex.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <limits>
+#include <queue>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../scanner/ThreadPool.h"
+
+template<typename T>
+struct IndexEntry {
+    T value;
+    uint64_t offset;
+
+    bool operator<(const IndexEntry& other) const {
+        return value < other.value || (value == other.value && offset < other.offset);
+    }
+};
+
+static uint64_t alignUp(uint64_t value) {
+    return (value + 7) & ~(uint64_t) 7;
+}
+
+static bool writeAt(int fd, const void* data, size_t size, uint64_t position) {
+    auto bytes = (const char*) data;
+
+    while (size > 0) {
+        ssize_t written = pwrite(fd, bytes, size, (off_t) position);
+        if (written <= 0) return false;
+
+        bytes += written;
+        size -= written;
+        position += written;
+    }
+
+    return true;
+}
+
+// Sorts the non-zero aligned values of one chunk of the dump and writes them as a run file
+template<typename T>
+static size_t writeRun(const uint8_t* data, size_t start, size_t end, size_t dumpSize, const std::string& runPath) {
+    std::vector<IndexEntry<T>> entries;
+    entries.reserve((end - start) / sizeof(T));
+
+    for (size_t offset = start; offset < end && offset + sizeof(T) <= dumpSize; offset += sizeof(T)) {
+        T value;
+        memcpy(&value, data + offset, sizeof(T));
+
+        if (value != 0) entries.push_back(IndexEntry<T>{ value, offset });
+    }
+
+    std::sort(entries.begin(), entries.end());
+
+    std::ofstream run(runPath, std::ios::binary);
+    run.write((const char*) entries.data(), (std::streamsize) (entries.size() * sizeof(IndexEntry<T>)));
+
+    return run.good() ? entries.size() : SIZE_MAX;
+}
+
+// K-way merge of the sorted runs into the values and offsets arrays of a section
+template<typename T>
+static bool mergeRuns(const std::vector<std::string>& runPaths, int fd, const IndexSection& section) {
+    static constexpr size_t OUTPUT_ENTRIES = 64 * 1024;
+    static constexpr size_t RUN_BUFFER_BYTES = 256 * 1024 * 1024;
+
+    struct Run {
+        std::ifstream file;
+        std::vector<IndexEntry<T>> buffer;
+        size_t position = 0;
+
+        bool refill() {
+            buffer.resize(buffer.capacity());
+            file.read((char*) buffer.data(), (std::streamsize) (buffer.size() * sizeof(IndexEntry<T>)));
+            buffer.resize((size_t) file.gcount() / sizeof(IndexEntry<T>));
+            position = 0;
+            return !buffer.empty();
+        }
+    };
+
+    size_t runEntries = std::max<size_t>(1024, RUN_BUFFER_BYTES / sizeof(IndexEntry<T>) / std::max<size_t>(runPaths.size(), 1));
+    std::vector<Run> runs(runPaths.size());
+
+    typedef std::pair<IndexEntry<T>, size_t> HeapItem;
+    auto greater = [](const HeapItem& a, const HeapItem& b) { return b.first < a.first; };
+    std::priority_queue<HeapItem, std::vector<HeapItem>, decltype(greater)> heap(greater);
+
+    for (size_t i = 0; i < runs.size(); i++) {
+        runs[i].file.open(runPaths[i], std::ios::binary | std::ios::ate);
+
+        // small runs only get the memory they fill
+        auto runSize = (size_t) std::max<std::streamoff>(runs[i].file.tellg(), 0);
+        runs[i].file.seekg(0);
+        runs[i].buffer.reserve(std::max<size_t>(std::min(runEntries, runSize / sizeof(IndexEntry<T>)), 1));
+
+        if (runs[i].refill()) heap.push(HeapItem{ runs[i].buffer[0], i });
+    }
+
+    std::vector<T> values;
+    std::vector<uint64_t> offsets;
+    values.reserve(OUTPUT_ENTRIES);
+    offsets.reserve(OUTPUT_ENTRIES);
+
+    uint64_t valuesPosition = section.valuesOffset;
+    uint64_t offsetsPosition = section.offsetsOffset;
+
+    auto flush = [&]() {
+        bool written = writeAt(fd, values.data(), values.size() * sizeof(T), valuesPosition)
+                && writeAt(fd, offsets.data(), offsets.size() * sizeof(uint64_t), offsetsPosition);
+
+        valuesPosition += values.size() * sizeof(T);
+        offsetsPosition += offsets.size() * sizeof(uint64_t);
+        values.clear();
+        offsets.clear();
+
+        return written;
+    };
+
+    while (!heap.empty()) {
+        HeapItem item = heap.top();
+        heap.pop();
+
+        values.push_back(item.first.value);
+        offsets.push_back(item.first.offset);
+        if (values.size() == OUTPUT_ENTRIES && !flush()) return false;
+
+        Run& run = runs[item.second];
+        if (++run.position < run.buffer.size() || run.refill()) {
+            heap.push(HeapItem{ run.buffer[run.position], item.second });
+        }
+    }
+
+    return flush();
+}
+
+bool ValueIndex::build(const MappedFile& dump, const std::string& indexPath, size_t threadCount, size_t chunkSize) {
+    const uint8_t* data = dump.data();
+    size_t dumpSize = dump.size();
+
+    // chunks must keep the 8 byte alignment of the values
+    chunkSize = std::max<size_t>(alignUp(chunkSize), 8);
+    size_t chunkCount = (dumpSize + chunkSize - 1) / chunkSize;
+
+    std::vector<std::string> runs4, runs8;
+    std::vector<size_t> counts4(chunkCount), counts8(chunkCount);
+    std::vector<std::future<void>> tasks;
+
+    for (size_t i = 0; i < chunkCount; i++) {
+        runs4.push_back(indexPath + ".run4." + std::to_string(i));
+        runs8.push_back(indexPath + ".run8." + std::to_string(i));
+    }
+
+    {
+        ThreadPool pool{threadCount};
+
+        for (size_t i = 0; i < chunkCount; i++) {
+            size_t start = i * chunkSize;
+            size_t end = std::min(start + chunkSize, dumpSize);
+
+            tasks.push_back(pool.submit([&, i, start, end] {
+                counts4[i] = writeRun<uint32_t>(data, start, end, dumpSize, runs4[i]);
+                counts8[i] = writeRun<uint64_t>(data, start, end, dumpSize, runs8[i]);
+            }));
+        }
+
+        for (std::future<void>& task : tasks) task.get();
+    }
+
+    bool success = true;
+    uint64_t count4 = 0, count8 = 0;
+
+    for (size_t i = 0; i < chunkCount; i++) {
+        if (counts4[i] == SIZE_MAX || counts8[i] == SIZE_MAX) success = false;
+
+        count4 += counts4[i];
+        count8 += counts8[i];
+    }
+
+    IndexHeader header{};
+    memcpy(header.magic, VALUE_INDEX_MAGIC, sizeof(VALUE_INDEX_MAGIC));
+    header.version = VALUE_INDEX_VERSION;
+    header.dumpSize = dumpSize;
+    header.dumpModificationTime = dump.getModificationTime();
+    header.dumpInode = dump.getInode();
+
+    header.sections[0] = { 4, count4, alignUp(sizeof(IndexHeader)), 0 };
+    header.sections[0].offsetsOffset = alignUp(header.sections[0].valuesOffset + count4 * 4);
+    header.sections[1] = { 8, count8, header.sections[0].offsetsOffset + count4 * 8, 0 };
+    header.sections[1].offsetsOffset = header.sections[1].valuesOffset + count8 * 8;
+
+    // the index is written next to its final path and only renamed once complete
+    std::string temporaryPath = indexPath + ".tmp";
+    int fd = ::open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    if (fd < 0) success = false;
+
+    success = success && mergeRuns<uint32_t>(runs4, fd, header.sections[0]);
+    success = success && mergeRuns<uint64_t>(runs8, fd, header.sections[1]);
+    success = success && writeAt(fd, &header, sizeof(header), 0);
+
+    if (fd >= 0) ::close(fd);
+
+    for (size_t i = 0; i < chunkCount; i++) {
+        std::remove(runs4[i].c_str());
+        std::remove(runs8[i].c_str());
+    }
+
+    if (success) success = std::rename(temporaryPath.c_str(), indexPath.c_str()) == 0;
+    if (!success) std::remove(temporaryPath.c_str());
+
+    return success;
+}
+
+bool ValueIndex::open(const std::string& indexPath, const MappedFile& dump) {
+    header = nullptr;
+
+    if (!file.open(indexPath) || file.size() < sizeof(IndexHeader)) return false;
+
+    auto candidate = (const IndexHeader*) file.data();
+
+    if (memcmp(candidate->magic, VALUE_INDEX_MAGIC, sizeof(VALUE_INDEX_MAGIC)) != 0) return false;
+    if (candidate->version != VALUE_INDEX_VERSION) return false;
+
+    // an index built for another version of the dump would return wrong candidates
+    if (candidate->dumpSize != dump.size()) return false;
+    if (candidate->dumpModificationTime != dump.getModificationTime() || candidate->dumpInode != dump.getInode()) return false;
+
+    for (const IndexSection& section : candidate->sections) {
+        if (section.offsetsOffset + section.count * sizeof(uint64_t) > file.size()) return false;
+    }
+
+    header = candidate;
+    return true;
+}
+
+// Narrows the values a field can take given its criteria, returns false when no criteria narrows it
+template<typename T>
+static bool narrowField(const ScannerField& field, T& low, T& high) {
+    bool narrowed = false;
+
+    low = std::numeric_limits<T>::min();
+    high = std::numeric_limits<T>::max();
+
+    for (const ScannerCriteria& criteria : field.criterias) {
+        T value = criteria.value != nullptr ? *(T*) criteria.value : 0;
+
+        switch (criteria.type) {
+            case SCANNER_CRITERIA_EQUAL:
+                low = std::max(low, value);
+                high = std::min(high, value);
+                break;
+            case SCANNER_CRITERIA_GREATER_THAN:
+                if (value == std::numeric_limits<T>::max()) {
+                    low = 1;
+                    high = 0;
+                    return true;
+                }
+                low = std::max<T>(low, value + 1);
+                break;
+            case SCANNER_CRITERIA_GREATER_THAN_OR_EQUAL:
+                low = std::max(low, value);
+                break;
+            case SCANNER_CRITERIA_LESS_THAN:
+                if (value == std::numeric_limits<T>::min()) {
+                    low = 1;
+                    high = 0;
+                    return true;
+                }
+                high = std::min<T>(high, value - 1);
+                break;
+            case SCANNER_CRITERIA_LESS_THAN_OR_EQUAL:
+                high = std::min(high, value);
+                break;
+            case SCANNER_CRITERIA_PTR_NULL:
+                low = std::max<T>(low, 0);
+                high = std::min<T>(high, 0);
+                break;
+            case SCANNER_CRITERIA_PTR_NOTNULL:
+                low = std::max<T>(low, 1);
+                break;
+            default:
+                continue;
+        }
+
+        narrowed = true;
+    }
+
+    return narrowed;
+}
+
+// Converts a typed interval to intervals over the raw bits stored in the index
+template<typename T>
+static bool fieldRanges(const ScannerField& field, std::vector<std::pair<uint64_t, uint64_t>>& ranges) {
+    typedef typename std::make_unsigned<T>::type U;
+    T low, high;
+
+    if (!narrowField<T>(field, low, high)) return false;
+    if (low > high) return true;
+
+    if (std::is_unsigned<T>::value || low >= 0 || high < 0) {
+        ranges.emplace_back((U) low, (U) high);
+    } else {
+        // negative values are stored above the positive ones
+        ranges.emplace_back(0, (U) high);
+        ranges.emplace_back((U) low, std::numeric_limits<U>::max());
+    }
+
+    return true;
+}
+
+bool ValueIndex::findAnchor(const CompiledStructure& structure, Anchor& anchor) const {
+    const std::vector<ScannerField>& fields = structure.getFields();
+    bool found = false;
+
+    for (size_t i = 0; i < fields.size(); i++) {
+        std::vector<std::pair<uint64_t, uint64_t>> bounds;
+        bool indexable;
+        size_t width;
+
+        switch (fields[i].primitive) {
+            case SCANNER_PRIMITIVE_UINT32:
+                indexable = fieldRanges<uint32_t>(fields[i], bounds);
+                width = 4;
+                break;
+            case SCANNER_PRIMITIVE_INT32:
+                indexable = fieldRanges<int32_t>(fields[i], bounds);
+                width = 4;
+                break;
+            case SCANNER_PRIMITIVE_UINT64:
+                indexable = fieldRanges<uint64_t>(fields[i], bounds);
+                width = 8;
+                break;
+            case SCANNER_PRIMITIVE_INT64:
+                indexable = fieldRanges<int64_t>(fields[i], bounds);
+                width = 8;
+                break;
+            case SCANNER_PRIMITIVE_POINTER:
+                indexable = fieldRanges<uintptr_t>(fields[i], bounds);
+                width = sizeof(uintptr_t);
+                break;
+            default:
+                continue;
+        }
+
+        if (!indexable || (width != 4 && width != 8)) continue;
+
+        // zero values are not in the index
+        bool coversZero = std::any_of(bounds.begin(), bounds.end(), [](const std::pair<uint64_t, uint64_t>& range) {
+            return range.first == 0;
+        });
+        if (coversZero) continue;
+
+        const IndexSection* section = &header->sections[width == 4 ? 0 : 1];
+        std::vector<Range> ranges;
+        size_t candidates = 0;
+
+        for (const auto& bound : bounds) {
+            ranges.push_back(Range{ bound.first, bound.second });
+            candidates += countRange(*section, ranges.back());
+        }
+
+        if (!found || candidates < anchor.candidates) {
+            anchor = Anchor{ i, section, ranges, candidates };
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+template<typename T>
+static std::pair<const T*, const T*> equalRange(const T* values, uint64_t count, uint64_t low, uint64_t high) {
+    const T* first = std::lower_bound(values, values + count, (T) low);
+    const T* last = std::upper_bound(first, values + count, (T) high);
+    return { first, last };
+}
+
+size_t ValueIndex::countRange(const IndexSection& section, const Range& range) const {
+    auto base = (const char*) header;
+
+    if (section.width == 4) {
+        auto bounds = equalRange((const uint32_t*) (base + section.valuesOffset), section.count, range.low, range.high);
+        return bounds.second - bounds.first;
+    }
+
+    auto bounds = equalRange((const uint64_t*) (base + section.valuesOffset), section.count, range.low, range.high);
+    return bounds.second - bounds.first;
+}
+
+template<typename T>
+void ValueIndex::collect(const IndexSection& section, const Range& range, size_t fieldOffset, std::vector<uint64_t>& starts) const {
+    auto base = (const char*) header;
+    auto values = (const T*) (base + section.valuesOffset);
+    auto offsets = (const uint64_t*) (base + section.offsetsOffset);
+
+    auto bounds = equalRange(values, section.count, range.low, range.high);
+
+    for (const T* value = bounds.first; value != bounds.second; value++) {
+        uint64_t offset = offsets[value - values];
+        if (offset >= fieldOffset) starts.push_back(offset - fieldOffset);
+    }
+}
+
+bool ValueIndex::scan(const CompiledStructure& structure, const char* data, size_t size, ResultSink& sink, size_t& candidates) const {
+    Anchor anchor{};
+
+    if (header == nullptr || structure.isEmpty()) return false;
+    if (!findAnchor(structure, anchor)) return false;
+
+    // past this point a sequential pass is cheaper than random accesses into the dump
+    if (anchor.candidates > size / 16) return false;
+
+    size_t fieldOffset = structure.getLayout().getFieldOffset(anchor.field);
+    size_t structureSize = structure.getSize();
+
+    std::vector<uint64_t> starts;
+    starts.reserve(anchor.candidates);
+
+    for (const Range& range : anchor.ranges) {
+        if (anchor.section->width == 4) {
+            collect<uint32_t>(*anchor.section, range, fieldOffset, starts);
+        } else {
+            collect<uint64_t>(*anchor.section, range, fieldOffset, starts);
+        }
+    }
+
+    std::sort(starts.begin(), starts.end());
+    candidates = starts.size();
+
+    for (uint64_t start : starts) {
+        if (start + structureSize > size) break;
+        if (!structure.matches(data + start)) continue;
+
+        if (!sink.push(ScannerResult{ structureSize, start, (void*) (data + start) })) break;
+    }
+
+    return true;
+}
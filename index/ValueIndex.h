@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../scanner/CompiledStructure.h"
+#include "../scanner/MappedFile.h"
+#include "../scanner/ResultSink.h"
+
+// Side-car index of every naturally aligned 4 and 8 byte value of a dump, sorted by value.
+// Equality and range criteria on 32/64-bit integer and pointer fields become a binary search,
+// the remaining fields are then verified against the dump. Only structures whose anchor field is
+// aligned to its own size can be found this way.
+//
+// File layout: IndexHeader, then for each width the sorted values followed by their offsets.
+// Zero values are not indexed, they are too frequent in memory dumps to be useful.
+
+const char VALUE_INDEX_MAGIC[4] = { 'W', 'I', 'D', 'X' };
+const uint32_t VALUE_INDEX_VERSION = 1;
+const std::string VALUE_INDEX_EXTENSION = ".widx";
+
+struct IndexSection {
+    uint64_t width;
+    uint64_t count;
+    uint64_t valuesOffset;
+    uint64_t offsetsOffset;
+};
+
+struct IndexHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t dumpSize;
+    int64_t dumpModificationTime;
+    uint64_t dumpInode;
+    IndexSection sections[2];
+};
+
+class ValueIndex {
+public:
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 64 * 1024 * 1024;
+
+    // sorts the values of each chunk in parallel into temporary runs, then merges them
+    static bool build(const MappedFile& dump, const std::string& indexPath, size_t threadCount, size_t chunkSize = DEFAULT_CHUNK_SIZE);
+
+    bool open(const std::string& indexPath, const MappedFile& dump);
+
+    // scans through the index, returns false when the structure has no indexable field
+    // or when the index would not narrow the scan down enough
+    bool scan(const CompiledStructure& structure, const char* data, size_t size, ResultSink& sink, size_t& candidates) const;
+
+private:
+    struct Range {
+        uint64_t low;
+        uint64_t high;
+    };
+
+    struct Anchor {
+        size_t field;
+        const IndexSection* section;
+        std::vector<Range> ranges;
+        size_t candidates;
+    };
+
+    bool findAnchor(const CompiledStructure& structure, Anchor& anchor) const;
+    size_t countRange(const IndexSection& section, const Range& range) const;
+
+    template<typename T>
+    void collect(const IndexSection& section, const Range& range, size_t fieldOffset, std::vector<uint64_t>& starts) const;
+
+    MappedFile file;
+    const IndexHeader* header = nullptr;
+};
@@ -1,63 +1,1063 @@
 #include <iostream>
 #include <utility>
+#include <memory>
+#include <climits>
+#include <cstdlib>
+#include <csignal>
+#include <ctime>
 
 #include "lib/argparse.h"
 
 #include "scanner/Scanner.h"
 #include "scanner/StructureParser.h"
+#include "scanner/ByteExporter.h"
+#include "scanner/MappedFile.h"
+#include "scanner/ThreadPool.h"
+#include "scanner/StreamScanner.h"
+#include "scanner/FileFollower.h"
+#include "scanner/ResultReader.h"
+#include "scanner/CompressedInput.h"
+#include "scanner/ScanStatistics.h"
+#include "scanner/PerfCounters.h"
+#include "scanner/ScanTrace.h"
+#include "scanner/ScanProgress.h"
 
-std::pair<long, char*> file_read(const std::string& filename) {
-    std::ifstream file(filename, std::ios::binary | std::ios::ate);
-    std::streamsize size = file.tellg();
-    file.seekg(0, std::ios::beg);
+#include "index/ValueIndex.h"
+#include "index/SuffixIndex.h"
 
-    char* buffer = new char[size];
+#include "cache/ResultCache.h"
 
-    if (file.read(buffer, size)) return std::pair<long, char*>{size, buffer};
-    return std::pair<long, char*>{-1, nullptr};
+#include "tune/TuneConfig.h"
+#include "tune/Tuner.h"
+
+#include "process/ProcessWatcher.h"
+#include "process/Sampler.h"
+#include "process/Snapshot.h"
+
+#include "server/Server.h"
+#include "server/Client.h"
+
+struct ScanOptions {
+    std::string outputFilePath = "output.txt";
+    ResultFormat format = RESULT_FORMAT_TEXT;
+    bool asyncWrite = false;
+    size_t maxResults = 0;
+    bool countOnly = false;
+    std::string exportBytesPath;
+    size_t threads = 0;
+    // 0 for the tuned or the default chunk size
+    size_t chunkSize = 0;
+    bool useTune = true;
+    bool useIndex = false;
+    bool useCache = false;
+    bool incremental = false;
+    std::string cacheDirectory;
+    uint64_t cacheMaxSize = ResultCache::DEFAULT_MAX_SIZE;
+    // empty, text or json
+    std::string stats;
+    bool perfCounters = false;
+    // empty, text or json
+    std::string progress;
+    size_t progressInterval = 1000;
+};
+
+std::unique_ptr<ProgressReporter> start_progress(const ScanProgress& progress, const ScanOptions& options) {
+    ProgressFormat format = options.progress == "json" ? PROGRESS_FORMAT_JSON : PROGRESS_FORMAT_TEXT;
+    return std::make_unique<ProgressReporter>(progress, format, std::chrono::milliseconds(options.progressInterval));
+}
+
+void print_statistics(const ScanStatistics& statistics, const PerfCounters* perfCounters, const ScanOptions& options) {
+    if (options.stats == "json") {
+        json report = statistics.toJson();
+        if (perfCounters != nullptr) report["perf_counters"] = perfCounters->toJson(statistics.getBytesScanned());
+        std::cout << report.dump() << std::endl;
+        return;
+    }
+
+    if (!options.stats.empty()) statistics.print(std::cout);
+    if (perfCounters != nullptr) perfCounters->print(std::cout, statistics.getBytesScanned());
+}
+
+bool scan_compressed(const MappedFile& target, const std::shared_ptr<CompiledStructure>& structure, const ScanOptions& options, ScanStatistics& statistics,
+                     const PerfCounters* perfCounters) {
+    ThreadPool pool {options.threads};
+    CompressedInput input {target.data(), target.size(), &pool};
+
+    if (!CompressedInput::isSupported(input.getFormat())) {
+        std::cout << "[-] This build cannot decompress " << CompressedInput::getFormatName(input.getFormat()) << " files." << std::endl;
+        return false;
+    }
+
+    CountingSink counter{};
+    std::vector<ResultSink*> sinks{&counter};
+
+    std::unique_ptr<ResultWriter> writer;
+    std::unique_ptr<WriterSink> writerSink;
+
+    if (!options.countOnly) {
+        writer = std::make_unique<ResultWriter>(options.outputFilePath, options.format, structure->getFields(), options.asyncWrite);
+
+        if (!writer->isOpen()) {
+            std::cout << "[-] Failed to open output file " << options.outputFilePath << "." << std::endl;
+            return false;
+        }
+
+        writerSink = std::make_unique<WriterSink>(*writer);
+        sinks.push_back(writerSink.get());
+    }
+
+    std::unique_ptr<ByteExporter> exporter;
+
+    if (!options.exportBytesPath.empty()) {
+        // offsets are in the decompressed bytes, which only exist in memory
+        exporter = std::make_unique<ByteExporter>(options.exportBytesPath);
+
+        if (!exporter->isOpen()) {
+            std::cout << "[-] Failed to open export file " << options.exportBytesPath << "." << std::endl;
+            return false;
+        }
+
+        sinks.push_back(exporter.get());
+    }
+
+    TeeSink outputs{sinks};
+    LimitSink limiter{outputs, options.maxResults > 0 ? options.maxResults : SIZE_MAX};
+    StreamScanner stream {structure, limiter};
+    if (!options.stats.empty()) stream.setCounters(&statistics.getCounters());
+
+    // the decompressed size is unknown, there is no ETA
+    ScanProgress progress {};
+    std::unique_ptr<ProgressReporter> reporter;
+    if (!options.progress.empty()) stream.setProgress(&progress);
+
+    if (options.useCache || options.useIndex) {
+        std::cout << "* The cache and the indexes are not used for compressed files." << std::endl;
+    }
+
+    // the decompression is part of the scan phase
+    statistics.begin(SCAN_PHASE_SCAN);
+    if (!options.progress.empty()) reporter = start_progress(progress, options);
+
+    bool success = input.read([&](const char* data, size_t size) {
+        return stream.feed(data, size);
+    });
+
+    if (reporter) reporter->stop();
+    statistics.end(SCAN_PHASE_SCAN);
+
+    // the write phase is the output done during the scan, then closing with the last flush
+    std::chrono::nanoseconds scanOutputTime = writer ? writer->getOutputTime() : std::chrono::nanoseconds(0);
+
+    statistics.begin(SCAN_PHASE_WRITE);
+    bool written = !writer || writer->close();
+    bool exported = !exporter || exporter->close();
+    statistics.end(SCAN_PHASE_WRITE);
+    statistics.addTime(SCAN_PHASE_WRITE, scanOutputTime);
+
+    if (!success) std::cout << "[-] The " << CompressedInput::getFormatName(input.getFormat()) << " data is corrupt or truncated, results stop at offset " << input.getPosition() << "." << std::endl;
+
+    std::cout << "* Found " << counter.getCount() << " results in " << input.getPosition() << " decompressed bytes"
+              << (input.isParallel() ? ", decompressed in parallel." : ".") << std::endl;
+    if (!written) std::cout << "[-] Failed to write the results to " << options.outputFilePath << ", the file is incomplete." << std::endl;
+    else if (writer) std::cout << "* Results saved in " << options.outputFilePath << "." << std::endl;
+    if (!exported) std::cout << "[-] Failed to write the matched bytes to " << options.exportBytesPath << ", the file is incomplete." << std::endl;
+    else if (exporter) std::cout << "* Matched bytes exported to " << options.exportBytesPath << "." << std::endl;
+
+    statistics.setEngine(CompressedInput::getFormatName(input.getFormat()) + " stream");
+    statistics.setBytesScanned(input.getPosition());
+    statistics.setResults(counter.getCount());
+    if (writer) statistics.setResultMemory(writer->getMemoryUsage());
+    print_statistics(statistics, perfCounters, options);
+
+    return written && exported;
 }
 
-void scan_file(const std::string& targetFilePath, std::string structureFilePath, const std::string& outputFilePath) {
+bool scan_file(const std::string& targetFilePath, std::string structureFilePath, const ScanOptions& options) {
     Scanner scanner {};
     StructureParser structureParser {std::move(structureFilePath)};
-    std::pair<long, char*> targetBuffer = file_read(targetFilePath);
+    MappedFile target {};
+    ScanStatistics statistics {};
 
-    if (targetBuffer.first == -1) {
+    std::unique_ptr<PerfCounters> perfCounters;
+
+    if (options.perfCounters) {
+        perfCounters = std::make_unique<PerfCounters>();
+        statistics.setPerfCounters(perfCounters.get());
+    }
+
+    statistics.begin(SCAN_PHASE_LOAD);
+
+    if (!target.open(targetFilePath)) {
         std::cout << "[-] Failed to read file." << std::endl;
-        return;
+        return false;
+    }
+
+    statistics.end(SCAN_PHASE_LOAD);
+    statistics.begin(SCAN_PHASE_PARSE);
+
+    std::shared_ptr<CompiledStructure> structure = structureParser.compile();
+
+    statistics.end(SCAN_PHASE_PARSE);
+    statistics.setStructure(structure);
+
+    // compressed dumps are decompressed in memory and scanned as a stream
+    if (CompressedInput::detect(target.data(), target.size()) != COMPRESSED_FORMAT_NONE) {
+        return scan_compressed(target, structure, options, statistics, perfCounters.get());
+    }
+    const std::vector<ScannerField>& fields = structure->getFields();
+
+    // what -t and --chunk-size leave unset comes from walker tune, for this kind of structure
+    size_t threads = options.threads;
+    size_t chunkSize = options.chunkSize;
+    TuneConfig tuneConfig {};
+    TuneSettings tuned {};
+    StructureClass structureClass = TuneConfig::classify(*structure);
+
+    if (options.useTune && (threads == 0 || chunkSize == 0) && tuneConfig.load(TuneConfig::defaultPath()) && tuneConfig.get(structureClass, tuned)) {
+        if (threads == 0) threads = tuned.threads;
+        if (chunkSize == 0) chunkSize = tuned.chunkSize;
+
+        std::cout << "* Using the tuned settings of " << TuneConfig::getClassName(structureClass) << " structures: " << threads << " threads, chunks of "
+                  << chunkSize / (1024 * 1024) << " MiB." << std::endl;
+    }
+
+    ThreadPool pool {threads};
+
+    // a process snapshot is scanned as its regions put back to back, results are reported at their addresses
+    std::unique_ptr<Snapshot> snapshot;
+
+    if (Snapshot::isSnapshot(target.data(), target.size())) {
+        snapshot = std::make_unique<Snapshot>();
+        statistics.begin(SCAN_PHASE_LOAD);
+
+        if (!snapshot->open(targetFilePath, &pool)) {
+            std::cout << "[-] Failed to load snapshot." << std::endl;
+            return false;
+        }
+
+        statistics.end(SCAN_PHASE_LOAD);
+
+        std::cout << "* Scanning the snapshot of process " << snapshot->getHeader().pid << ", "
+                  << snapshot->getRegions().size() << " regions." << std::endl;
+
+        if (options.useCache || options.useIndex) {
+            std::cout << "* The cache and the indexes are not used for snapshots." << std::endl;
+        }
+    }
+
+    scanner.setStructure(structure);
+    scanner.setThreadPool(&pool, chunkSize);
+    if (!options.stats.empty()) scanner.setCounters(&statistics.getCounters());
+
+    if (snapshot) {
+        scanner.setView(snapshot->data(), snapshot->size());
+    } else {
+        scanner.setView(target.data(), target.size());
+    }
+
+    ScanProgress progress {};
+    std::unique_ptr<ProgressReporter> reporter;
+
+    if (!options.progress.empty()) {
+        progress.setTotal(snapshot ? snapshot->size() : target.size());
+        scanner.setProgress(&progress);
+    }
+
+    CountingSink counter{};
+    std::vector<ResultSink*> sinks{&counter};
+
+    // the same structure on the same bytes is answered from the cache, other scans are stored in it
+    std::unique_ptr<ResultCache> cache;
+    uint64_t fingerprint = 0, structureHash = 0;
+    ChunkTree chunkTree, previousChunkTree;
+    bool cacheHit = false;
+
+    std::unique_ptr<ResultWriter> cacheWriter;
+    std::unique_ptr<CallbackSink> cacheSink;
+    // only the exact scans are stored, the indexes only find aligned matches
+    bool cacheable = true;
+
+    if (options.useCache && !snapshot) {
+        cache = std::make_unique<ResultCache>(options.cacheDirectory, options.cacheMaxSize);
+
+        if (!cache->isOpen()) {
+            std::cout << "[-] Failed to open the cache directory " << options.cacheDirectory << ", not using the cache." << std::endl;
+            cache.reset();
+        } else {
+            // hashing the file is part of loading it
+            statistics.begin(SCAN_PHASE_LOAD);
+            fingerprint = cache->fingerprint(target, &pool, &chunkTree, options.incremental ? &previousChunkTree : nullptr);
+            statistics.end(SCAN_PHASE_LOAD);
+            structureHash = ResultCache::hashStructure(*structure);
+            cacheHit = cache->contains(fingerprint, structureHash);
+        }
+    }
+
+    if (cache && !cacheHit) {
+        cacheWriter = std::make_unique<ResultWriter>(cache->temporaryPath(fingerprint, structureHash), RESULT_FORMAT_BINARY, fields);
+
+        if (cacheWriter->isOpen()) {
+            cacheSink = std::make_unique<CallbackSink>([&cacheWriter, &cacheable](const ScannerResult& result) {
+                if (cacheable) cacheWriter->write(result);
+                return true;
+            });
+            sinks.push_back(cacheSink.get());
+        } else {
+            cacheWriter.reset();
+        }
+    }
+
+    // results are streamed to the outputs as they are found
+    std::unique_ptr<ResultWriter> writer;
+    std::unique_ptr<WriterSink> writerSink;
+
+    if (!options.countOnly) {
+        writer = std::make_unique<ResultWriter>(options.outputFilePath, options.format, fields, options.asyncWrite);
+
+        if (!writer->isOpen()) {
+            std::cout << "[-] Failed to open output file " << options.outputFilePath << "." << std::endl;
+            return false;
+        }
+
+        writerSink = std::make_unique<WriterSink>(*writer);
+        sinks.push_back(writerSink.get());
+    }
+
+    std::unique_ptr<ByteExporter> exporter;
+
+    if (!options.exportBytesPath.empty()) {
+        // result offsets are addresses in a snapshot, the bytes are taken from the results instead
+        exporter = std::make_unique<ByteExporter>(options.exportBytesPath, snapshot ? "" : targetFilePath);
+
+        if (!exporter->isOpen()) {
+            std::cout << "[-] Failed to open export file " << options.exportBytesPath << "." << std::endl;
+            return false;
+        }
+
+        sinks.push_back(exporter.get());
+    }
+
+    TeeSink outputs{sinks};
+    LimitSink limiter{outputs, options.maxResults > 0 ? options.maxResults : SIZE_MAX};
+
+    std::unique_ptr<SnapshotAddressSink> addresses;
+    if (snapshot) addresses = std::make_unique<SnapshotAddressSink>(*snapshot, limiter);
+
+    ValueIndex index {};
+    SuffixIndex suffixIndex {};
+    size_t candidates = 0, rescannedBytes = 0;
+    bool indexed = false;
+
+    statistics.begin(SCAN_PHASE_SCAN);
+    if (!options.progress.empty()) reporter = start_progress(progress, options);
+
+    if (cacheHit && cache->load(fingerprint, structureHash, target, structure->getSize(), limiter)) {
+        std::cout << "* Results loaded from the cache." << std::endl;
+        statistics.setEngine("cache");
+        indexed = true;
+    } else if (cache && options.incremental && cache->loadIncremental(structureHash, previousChunkTree, chunkTree, *structure, target, limiter, rescannedBytes)) {
+        std::cout << "* Reused the results of the previous version of the file, scanned " << rescannedBytes << " of " << target.size() << " bytes again." << std::endl;
+        statistics.setEngine("incremental cache");
+        statistics.setBytesScanned(rescannedBytes);
+        indexed = true;
+    } else if (options.useIndex && !snapshot) {
+        cacheable = false;
+
+        // numeric fields go through the value index, byte signatures through the suffix array
+        bool hasValueIndex = index.open(targetFilePath + VALUE_INDEX_EXTENSION, target);
+        bool hasSuffixIndex = suffixIndex.open(targetFilePath + SUFFIX_INDEX_EXTENSION, target);
+
+        if (hasValueIndex && index.scan(*structure, (const char*) target.data(), target.size(), limiter, candidates)) {
+            std::cout << "* Verified " << candidates << " candidates from the value index." << std::endl;
+            statistics.setEngine("value index");
+            indexed = true;
+        } else if (hasSuffixIndex && suffixIndex.scan(*structure, (const char*) target.data(), target.size(), limiter, candidates)) {
+            std::cout << "* Verified " << candidates << " candidates from the suffix index." << std::endl;
+            statistics.setEngine("suffix index");
+            indexed = true;
+        } else if (!hasValueIndex && !hasSuffixIndex) {
+            std::cout << "* No up to date index found, scanning the whole file." << std::endl;
+        } else {
+            std::cout << "* The structure cannot be narrowed down with the index, scanning the whole file." << std::endl;
+        }
+
+        cacheable = !indexed;
+    }
+
+    if (snapshot) {
+        scanner.scan(*addresses);
+        statistics.setBytesScanned(snapshot->size());
+    } else if (!indexed) {
+        scanner.scan(limiter);
+        statistics.setBytesScanned(target.size());
+    }
+
+    if (reporter) {
+        // the cache and the indexes answer at once, without going through the chunks
+        if (indexed) progress.add(target.size(), counter.getCount());
+        reporter->stop();
+    }
+
+    statistics.end(SCAN_PHASE_SCAN);
+
+    // the write phase is the output done during the scan, then closing with the last flushes
+    std::chrono::nanoseconds scanOutputTime{0};
+    for (ResultWriter* output : { writer.get(), cacheWriter.get() }) {
+        if (output != nullptr) scanOutputTime += output->getOutputTime();
+    }
+
+    statistics.begin(SCAN_PHASE_WRITE);
+    bool written = !writer || writer->close();
+    bool cached = !cacheWriter || cacheWriter->close();
+    bool exported = !exporter || exporter->close();
+    statistics.end(SCAN_PHASE_WRITE);
+    statistics.addTime(SCAN_PHASE_WRITE, scanOutputTime);
+
+    if (cacheWriter) {
+        // a scan cut short by --max-results is not a complete answer, nor an entry the disk could not hold
+        if (cached && cacheable && (limiter.getCount() < options.maxResults || options.maxResults == 0)) {
+            cache->commit(fingerprint, structureHash);
+        } else {
+            cache->discard(fingerprint, structureHash);
+        }
+    }
+
+    std::cout << "* Found " << counter.getCount() << " results." << std::endl;
+    if (!written) std::cout << "[-] Failed to write the results to " << options.outputFilePath << ", the file is incomplete." << std::endl;
+    else if (writer) std::cout << "* Results saved in " << options.outputFilePath << "." << std::endl;
+    if (!exported) std::cout << "[-] Failed to write the matched bytes to " << options.exportBytesPath << ", the file is incomplete." << std::endl;
+    else if (exporter) std::cout << "* Matched bytes exported to " << options.exportBytesPath << "." << std::endl;
+
+    statistics.setResults(counter.getCount());
+
+    uint64_t resultMemory = 0;
+    for (ResultWriter* output : { writer.get(), cacheWriter.get() }) {
+        if (output != nullptr) resultMemory += output->getMemoryUsage();
+    }
+    statistics.setResultMemory(resultMemory);
+
+    print_statistics(statistics, perfCounters.get(), options);
+
+    return written && exported;
+}
+
+static FileFollower* activeFollower = nullptr;
+
+bool follow_file(const std::string& targetFilePath, std::string structureFilePath, const ScanOptions& options) {
+    StructureParser structureParser {std::move(structureFilePath)};
+    FileFollower follower {targetFilePath};
+
+    if (!follower.open()) {
+        std::cout << "[-] Failed to follow file." << std::endl;
+        return false;
+    }
+
+    std::shared_ptr<CompiledStructure> structure = structureParser.compile();
+
+    CountingSink counter{};
+    std::vector<ResultSink*> sinks{&counter};
+
+    std::unique_ptr<ResultWriter> writer;
+    std::unique_ptr<WriterSink> writerSink;
+
+    if (!options.countOnly) {
+        writer = std::make_unique<ResultWriter>(options.outputFilePath, options.format, structure->getFields(), options.asyncWrite);
+
+        if (!writer->isOpen()) {
+            std::cout << "[-] Failed to open output file " << options.outputFilePath << "." << std::endl;
+            return false;
+        }
+
+        writerSink = std::make_unique<WriterSink>(*writer);
+        sinks.push_back(writerSink.get());
+    }
+
+    std::unique_ptr<ByteExporter> exporter;
+
+    if (!options.exportBytesPath.empty()) {
+        // the file may be truncated before a range is copied, the bytes are taken as they are scanned
+        exporter = std::make_unique<ByteExporter>(options.exportBytesPath);
+
+        if (!exporter->isOpen()) {
+            std::cout << "[-] Failed to open export file " << options.exportBytesPath << "." << std::endl;
+            return false;
+        }
+
+        sinks.push_back(exporter.get());
+    }
+
+    TeeSink outputs{sinks};
+    LimitSink limiter{outputs, options.maxResults > 0 ? options.maxResults : SIZE_MAX};
+    StreamScanner stream {structure, limiter};
+
+    // Ctrl+C stops following, the results found so far are kept
+    activeFollower = &follower;
+    signal(SIGINT, [](int) { if (activeFollower != nullptr) activeFollower->stop(); });
+    signal(SIGTERM, [](int) { if (activeFollower != nullptr) activeFollower->stop(); });
+
+    std::cout << "* Following " << targetFilePath << ", press Ctrl+C to stop." << std::endl;
+
+    follower.run([&](const char* data, size_t size) {
+        bool keepGoing = stream.feed(data, size);
+
+        // appended results are visible as soon as the bytes holding them are scanned
+        if (writer) writer->flush();
+        return keepGoing;
+    }, [&] {
+        std::cout << "* The file was truncated, scanning it again from the start." << std::endl;
+        stream.reset();
+    });
+
+    activeFollower = nullptr;
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+
+    bool written = !writer || writer->close();
+    bool exported = !exporter || exporter->close();
+
+    std::cout << "* Found " << counter.getCount() << " results in " << stream.getPosition() << " bytes." << std::endl;
+    if (!written) std::cout << "[-] Failed to write the results to " << options.outputFilePath << ", the file is incomplete." << std::endl;
+    else if (writer) std::cout << "* Results saved in " << options.outputFilePath << "." << std::endl;
+    if (!exported) std::cout << "[-] Failed to write the matched bytes to " << options.exportBytesPath << ", the file is incomplete." << std::endl;
+    else if (exporter) std::cout << "* Matched bytes exported to " << options.exportBytesPath << "." << std::endl;
+
+    return written && exported;
+}
+
+static volatile sig_atomic_t stopRequested = 0;
+
+int watch_command(int argc, char** argv) {
+    argparse::Parser parser;
+
+    auto pid = parser.AddArg<int>("pid", 'p', "The process to watch.");
+    auto structure = parser.AddArg<std::string>("structure", 's', "The structure JSON file to search.");
+    auto output = parser.AddArg<std::string>("output", 'o', "The file to write +address / -address events to, stdout by default.");
+    auto interval = parser.AddArg<size_t>("interval", "Milliseconds between two passes.").Default(1000);
+    auto passes = parser.AddArg<size_t>("passes", "Stop after N passes, 0 to watch until interrupted.").Default(0);
+
+    parser.ParseArgs(argc, argv);
+
+    if (!pid || !structure) {
+        std::cout << "Usage: " << argv[0] << " -p <pid> -s <structure> [-o output] [--interval ms] [--passes N]" << std::endl;
+        return 1;
+    }
+
+    StructureParser structureParser {*structure};
+    ProcessWatcher watcher {(pid_t) *pid, structureParser.compile()};
+
+    std::ofstream outputFile;
+    if (output) outputFile.open(*output);
+    std::ostream& out = output ? (std::ostream&) outputFile : std::cout;
+
+    signal(SIGINT, [](int) { stopRequested = 1; });
+    signal(SIGTERM, [](int) { stopRequested = 1; });
+
+    std::vector<WatchEvent> events;
+
+    if (!watcher.start(events)) {
+        std::cerr << "[-] Failed to read the memory of process " << *pid << "." << std::endl;
+        return 1;
+    }
+
+    if (!watcher.usesSoftDirty()) {
+        std::cerr << "* Soft-dirty tracking is not available, changed pages are found by hashing the memory." << std::endl;
+    }
+
+    for (size_t pass = 1; !stopRequested; pass++) {
+        char line[24];
+
+        for (const WatchEvent& event : events) {
+            int length = snprintf(line, sizeof(line), "%c0x%llx\n", event.added ? '+' : '-', (unsigned long long) event.address);
+            out.write(line, length);
+        }
+
+        out.flush();
+
+        std::cerr << "* Pass " << pass << ": " << events.size() << " changes, " << watcher.getResultCount() << " results, "
+                  << watcher.getDirtyPageCount() << " pages evaluated." << std::endl;
+
+        if (*passes > 0 && pass >= *passes) break;
+
+        struct timespec delay = { (time_t) (*interval / 1000), (long) (*interval % 1000) * 1000000 };
+        if (nanosleep(&delay, nullptr) != 0 && stopRequested) break;
+
+        events.clear();
+
+        if (!watcher.update(events)) {
+            std::cerr << "* Process " << *pid << " exited." << std::endl;
+            break;
+        }
+    }
+
+    return 0;
+}
+
+int sample_command(int argc, char** argv) {
+    argparse::Parser parser;
+
+    auto pid = parser.AddArg<int>("pid", 'p', "The process to sample.");
+    auto results = parser.AddArg<std::string>("results", 'r', "The result file holding the addresses to sample, text or binary.");
+    auto structure = parser.AddArg<std::string>("structure", 's', "The structure JSON file describing the sampled values.");
+    auto output = parser.AddArg<std::string>("output", 'o', "The sample file to write, or the csv file with --decode.");
+    auto base = parser.AddArg<std::string>("base", "Address added to every result offset, for results found in a dump.").Default("0");
+    auto rate = parser.AddArg<double>("rate", "Samples per second.").Default(100);
+    auto count = parser.AddArg<uint64_t>("count", "Stop after N samples, 0 to sample until interrupted.").Default(0);
+    auto decode = parser.AddArg<std::string>("decode", "Print a sample file as csv.");
+
+    parser.ParseArgs(argc, argv);
+
+    if (decode) {
+        std::ofstream outputFile;
+        if (output) outputFile.open(*output);
+        std::ostream& out = output ? (std::ostream&) outputFile : std::cout;
+
+        if (!Sampler::decode(*decode, out)) {
+            std::cerr << "[-] Failed to read sample file " << *decode << "." << std::endl;
+            return 1;
+        }
+
+        return 0;
     }
 
-    scanner.setFields(structureParser.parse());
-    scanner.setBuffer(targetBuffer.second, targetBuffer.first);
+    if (!pid || !results || !structure || !output || *rate <= 0) {
+        std::cout << "Usage: " << argv[0] << " -p <pid> -r <results> -s <structure> -o <output> [--base address] [--rate hz] [--count N]" << std::endl;
+        std::cout << "       " << argv[0] << " --decode <samples> [-o output.csv]" << std::endl;
+        return 1;
+    }
+
+    ResultReader reader;
+
+    if (!reader.open(*results)) {
+        std::cout << "[-] Failed to open file: " << *results << std::endl;
+        return 1;
+    }
+
+    uint64_t baseAddress = strtoull(base->c_str(), nullptr, 0);
+    std::vector<uint64_t> addresses;
+    uint64_t offset;
+
+    while (reader.next(offset)) addresses.push_back(baseAddress + offset);
+
+    StructureParser structureParser {*structure};
+    std::shared_ptr<CompiledStructure> compiled = structureParser.compile();
+    Sampler sampler {(pid_t) *pid, compiled->getFields(), addresses};
+
+    if (!sampler.open(*output)) {
+        std::cout << "[-] Failed to open output file " << *output << "." << std::endl;
+        return 1;
+    }
+
+    std::cout << "* Sampling " << addresses.size() << " addresses in " << sampler.getRangeCount() << " ranges, "
+              << sampler.getCallsPerTick() << " read(s) per sample." << std::endl;
+
+    signal(SIGINT, [](int) { stopRequested = 1; });
+    signal(SIGTERM, [](int) { stopRequested = 1; });
 
-    std::vector<ScannerResult> results = scanner.scan();
-    std::cout << "* Found " << results.size() << " results." << std::endl;
+    if (!sampler.run((uint64_t) (1e9 / *rate), *count, stopRequested)) {
+        std::cout << "[-] Failed to sample the process." << std::endl;
+        return 1;
+    }
+
+    std::cout << "* Took " << sampler.getTickCount() << " samples, " << sampler.getOverrunCount() << " skipped." << std::endl;
+    std::cout << "* Samples saved in " << *output << "." << std::endl;
 
-    Scanner::saveResults(results, outputFilePath);
-    std::cout << "* Results saved in " << outputFilePath << "." << std::endl;
+    return 0;
+}
+
+int snapshot_command(int argc, char** argv) {
+    argparse::Parser parser;
+
+    auto pid = parser.AddArg<int>("pid", 'p', "The process to snapshot.");
+    auto output = parser.AddArg<std::string>("output", 'o', "The snapshot file to write.");
+    auto compression = parser.AddArg<std::string>("compression", "Compression of the pages: none, zlib, lz4 or zstd.").Default("none");
+    auto writable = parser.AddFlag("writable", "Only keep the writable regions.");
+    auto stop = parser.AddFlag("stop", "Stop the process while its memory is read, for a consistent snapshot.");
+    auto threads = parser.AddArg<size_t>("threads", 't', "Number of threads, 0 for one per core.").Default(0);
+
+    parser.ParseArgs(argc, argv);
+
+    if (!pid || !output) {
+        std::cout << "Usage: " << argv[0] << " -p <pid> -o <output> [--compression none|zlib|lz4|zstd] [--writable] [--stop] [-t threads]" << std::endl;
+        return 1;
+    }
+
+    SnapshotOptions options{};
+    options.compression = Snapshot::getCompressionByName(*compression);
+    options.writableOnly = *writable > 0;
+    options.stop = *stop > 0;
+    options.threads = *threads;
+
+    if (options.compression == SNAPSHOT_COMPRESSION_NONE && *compression != "none") {
+        std::cout << "[-] Unknown compression: " << *compression << std::endl;
+        return 1;
+    }
+
+    if (!Snapshot::isCompressionSupported(options.compression)) {
+        std::cout << "[-] This build does not support " << *compression << " compression." << std::endl;
+        return 1;
+    }
+
+    SnapshotStats stats{};
+
+    if (!SnapshotWriter::capture((pid_t) *pid, *output, options, stats)) {
+        std::cout << "[-] Failed to snapshot process " << *pid << "." << std::endl;
+        return 1;
+    }
+
+    std::cout << "* Read " << stats.bytesRead << " bytes in " << stats.regionCount << " regions in " << stats.elapsedNs / 1000000 << " ms, stored "
+              << stats.bytesStored << " bytes (" << stats.zeroPages << " zero pages, " << stats.unreadablePages << " unreadable)." << std::endl;
+    if (options.stop) std::cout << "* The process was stopped for " << stats.stopTimeNs / 1000 << " us." << std::endl;
+    std::cout << "* Snapshot saved in " << *output << "." << std::endl;
+
+    return 0;
+}
+
+int serve_command(int argc, char** argv) {
+    argparse::Parser parser;
+
+    auto socket = parser.AddArg<std::string>("socket", "The Unix socket to listen on.").Default("/tmp/walker.sock");
+    auto threads = parser.AddArg<size_t>("threads", 't', "Number of scan threads, 0 for one per core.").Default(0);
+
+    parser.ParseArgs(argc, argv);
+
+    Server server {*socket, *threads};
+
+    if (!server.start()) {
+        std::cout << "[-] Failed to listen on " << *socket << "." << std::endl;
+        return 1;
+    }
+
+    std::cout << "* Listening on " << *socket << "." << std::endl;
+    server.run();
+    std::cout << "* Server stopped." << std::endl;
+
+    return 0;
+}
+
+int tune_command(int argc, char** argv) {
+    argparse::Parser parser;
+
+    auto output = parser.AddArg<std::string>("output", 'o', "The settings file, $WALKER_TUNE_FILE or ~/.config/walker/tune.json by default.");
+    auto size = parser.AddArg<size_t>("size", "MiB of synthetic dump, at most this much is scanned by each measure.").Default(Tuner::DEFAULT_BUFFER_SIZE / (1024 * 1024));
+    auto repeat = parser.AddArg<size_t>("repeat", "Scans per measure, the fastest is kept.").Default(Tuner::DEFAULT_REPEAT);
+    auto only = parser.AddArg<std::string>("class", "Only tune one class of structures: anchored, range or pattern.");
+
+    parser.ParseArgs(argc, argv);
+
+    std::string configPath = output ? *output : TuneConfig::defaultPath();
+    std::vector<StructureClass> classes;
+
+    for (const auto& details : STRUCTURE_CLASS_DETAILS) {
+        if (!only || *only == std::get<std::string>(details)) classes.push_back(std::get<StructureClass>(details));
+    }
+
+    if (classes.empty()) {
+        std::cout << "[-] Unknown structure class: " << *only << std::endl;
+        std::cout << "Usage: " << argv[0] << " [-o output] [--size MiB] [--repeat N] [--class anchored|range|pattern]" << std::endl;
+        return 1;
+    }
+
+    // the classes not tuned this time keep their settings
+    TuneConfig config {};
+    config.load(configPath);
+
+    if (config.getCoreCount() != ThreadPool::defaultThreadCount()) config = TuneConfig{};
+    config.setCoreCount(ThreadPool::defaultThreadCount());
+
+    Tuner tuner {*size * 1024 * 1024, *repeat};
+
+    std::cout << "* Tuning on " << *size << " MiB with up to " << ThreadPool::defaultThreadCount() << " threads." << std::endl;
+
+    for (StructureClass structureClass : classes) {
+        std::string name = TuneConfig::getClassName(structureClass);
+
+        TuneSettings settings = tuner.tune(structureClass, [&](const TuneMeasure& measure) {
+            printf("  %-8s %3lu threads, chunks of %4lu MiB: %.3f GB/s\n", name.c_str(), (unsigned long) measure.threads,
+                   (unsigned long) (measure.chunkSize / (1024 * 1024)), measure.bytesPerSecond / 1e9);
+            fflush(stdout);
+        });
+
+        config.set(structureClass, settings);
+
+        std::cout << "* " << name << " structures: " << settings.threads << " threads, chunks of " << settings.chunkSize / (1024 * 1024)
+                  << " MiB, " << settings.bytesPerSecond / 1e9 << " GB/s." << std::endl;
+    }
+
+    if (!config.save(configPath)) {
+        std::cout << "[-] Failed to save the settings to " << configPath << "." << std::endl;
+        return 1;
+    }
+
+    std::cout << "* Settings saved in " << configPath << ", scans use them unless -t or --chunk-size are given." << std::endl;
+    return 0;
+}
+
+int index_command(int argc, char** argv) {
+    argparse::Parser parser;
+
+    auto filename = parser.AddArg<std::string>("filename", 'f', "The file to index.");
+    auto output = parser.AddArg<std::string>("output", 'o', "The index file, <filename>" + VALUE_INDEX_EXTENSION + " by default.");
+    auto threads = parser.AddArg<size_t>("threads", 't', "Number of threads, 0 for one per core.").Default(0);
+    auto chunkSize = parser.AddArg<size_t>("chunk-size", "Bytes of the file sorted at once by each thread.").Default(ValueIndex::DEFAULT_CHUNK_SIZE);
+
+    parser.ParseArgs(argc, argv);
+
+    if (!filename) {
+        std::cout << "Usage: " << argv[0] << " -f <filename> [-o output] [-t threads] [--chunk-size bytes]" << std::endl;
+        return 1;
+    }
+
+    MappedFile target {};
+
+    if (!target.open(*filename)) {
+        std::cout << "[-] Failed to read file." << std::endl;
+        return 1;
+    }
+
+    std::string indexPath = output ? *output : *filename + VALUE_INDEX_EXTENSION;
+
+    if (!ValueIndex::build(target, indexPath, *threads, *chunkSize)) {
+        std::cout << "[-] Failed to build the value index." << std::endl;
+        return 1;
+    }
+
+    std::cout << "* Value index saved in " << indexPath << "." << std::endl;
+    return 0;
+}
+
+int suffix_index_command(int argc, char** argv) {
+    argparse::Parser parser;
+
+    auto filename = parser.AddArg<std::string>("filename", 'f', "The file to index.");
+    auto output = parser.AddArg<std::string>("output", 'o', "The index file, <filename>" + SUFFIX_INDEX_EXTENSION + " by default.");
+
+    parser.ParseArgs(argc, argv);
+
+    if (!filename) {
+        std::cout << "Usage: " << argv[0] << " -f <filename> [-o output]" << std::endl;
+        return 1;
+    }
+
+    MappedFile target {};
+
+    if (!target.open(*filename)) {
+        std::cout << "[-] Failed to read file." << std::endl;
+        return 1;
+    }
+
+    std::string indexPath = output ? *output : *filename + SUFFIX_INDEX_EXTENSION;
+
+    if (!SuffixIndex::build(target, indexPath)) {
+        std::cout << "[-] Failed to build the suffix index." << std::endl;
+        return 1;
+    }
+
+    std::cout << "* Suffix index saved in " << indexPath << "." << std::endl;
+    return 0;
+}
+
+int query_command(int argc, char** argv) {
+    argparse::Parser parser;
+
+    auto socket = parser.AddArg<std::string>("socket", "The Unix socket of the server.").Default("/tmp/walker.sock");
+    auto filename = parser.AddArg<std::string>("filename", 'f', "The file to scan.");
+    auto structure = parser.AddArg<std::string>("structure", 's', "The structure JSON file to search.");
+    auto output = parser.AddArg<std::string>("output", 'o', "The output file to write results to, stdout by default.");
+    auto format = parser.AddArg<std::string>("format", "The output format: text, csv, jsonl or binary.").Default("text");
+    auto maxResults = parser.AddArg<size_t>("max-results", "Stop the scan after N results.").Default(0);
+    auto countOnly = parser.AddFlag("count", "Only count the results.");
+    auto status = parser.AddFlag("status", "Print the server status.");
+    auto shutdown = parser.AddFlag("shutdown", "Stop the server.");
+
+    parser.ParseArgs(argc, argv);
+
+    Client client {*socket};
+    nlohmann::json request;
+
+    if (*status > 0) {
+        request = {{"command", "status"}};
+    } else if (*shutdown > 0) {
+        request = {{"command", "shutdown"}};
+    } else if (filename && structure) {
+        std::ifstream structureFile(*structure);
+
+        if (!structureFile.is_open()) {
+            std::cout << "[-] Failed to open file: " << *structure << std::endl;
+            return 1;
+        }
+
+        // the server resolves paths from its own working directory
+        char resolved[PATH_MAX];
+        std::string path = realpath(filename->c_str(), resolved) != nullptr ? std::string(resolved) : *filename;
+
+        request = {
+            {"command", "scan"},
+            {"file", path},
+            {"structure", nlohmann::json::parse(structureFile)},
+            {"format", *format},
+            {"max_results", *maxResults},
+            {"count", *countOnly > 0}
+        };
+    } else {
+        std::cout << "Usage: " << argv[0] << " [--socket path] -f <filename> -s <structure> [-o output] [--format text|csv|jsonl|binary] [--max-results N] [--count] | --status | --shutdown" << std::endl;
+        return 1;
+    }
+
+    std::ofstream outputFile;
+    if (output) outputFile.open(*output, std::ios::binary);
+    std::ostream& out = output ? (std::ostream&) outputFile : std::cout;
+
+    nlohmann::json response = client.request(request, [&out](const char* data, size_t size) {
+        out.write(data, (std::streamsize) size);
+    });
+    out.flush();
+
+    if (response.contains("error")) {
+        std::cerr << "[-] " << response["error"].get<std::string>() << std::endl;
+        return 1;
+    }
+
+    std::cerr << "* " << response.dump() << std::endl;
+    return 0;
 }
 
 int main(int argc, char** argv) {
+    if (argc > 1 && std::string(argv[1]) == "serve") return serve_command(argc - 1, argv + 1);
+    if (argc > 1 && std::string(argv[1]) == "query") return query_command(argc - 1, argv + 1);
+    if (argc > 1 && std::string(argv[1]) == "index") return index_command(argc - 1, argv + 1);
+    if (argc > 1 && std::string(argv[1]) == "sample") return sample_command(argc - 1, argv + 1);
+    if (argc > 1 && std::string(argv[1]) == "snapshot") return snapshot_command(argc - 1, argv + 1);
+    if (argc > 1 && std::string(argv[1]) == "watch") return watch_command(argc - 1, argv + 1);
+    if (argc > 1 && std::string(argv[1]) == "suffix-index") return suffix_index_command(argc - 1, argv + 1);
+    if (argc > 1 && std::string(argv[1]) == "tune") return tune_command(argc - 1, argv + 1);
+
     argparse::Parser parser;
 
     auto filename = parser.AddArg<std::string>("filename", 'f', "The file to scan.");
     auto structure = parser.AddArg<std::string>("structure", 's', "The structure JSON file to search.");
     auto output = parser.AddArg<std::string>("output", 'o', "The output file to write results to.");
+    auto format = parser.AddArg<std::string>("format", "The output format: text, csv, jsonl or binary.").Default("text");
+    auto asyncWrite = parser.AddFlag("async-write", "Write results from a background thread.");
+    auto maxResults = parser.AddArg<size_t>("max-results", "Stop the scan after N results.");
+    auto first = parser.AddFlag("first", "Stop the scan at the first result.");
+    auto countOnly = parser.AddFlag("count", "Only count the results, nothing is written.");
+    auto exportBytes = parser.AddArg<std::string>("export-bytes", "Export the raw bytes of every result to a binary file.");
+    auto threads = parser.AddArg<size_t>("threads", 't', "Number of scan threads, 0 for the tuned count or one per core.").Default(0);
+    auto chunkSize = parser.AddArg<size_t>("chunk-size", "Bytes scanned at once by each thread, 0 for the tuned or the default size.").Default(0);
+    auto noTune = parser.AddFlag("no-tune", "Ignore the settings measured by walker tune.");
+    auto useIndex = parser.AddFlag("use-index", "Use the value or suffix index of the file when the structure allows it.");
+    auto useCache = parser.AddFlag("cache", "Reuse the results of a previous identical scan, and cache the results of this one.");
+    auto cacheDirectory = parser.AddArg<std::string>("cache-dir", "The cache directory, $WALKER_CACHE_DIR or ~/.cache/walker by default.");
+    auto follow = parser.AddFlag("follow", "Keep scanning the bytes appended to the file until interrupted.");
+    auto incremental = parser.AddFlag("incremental", "With --cache, only scan again the parts of the file that changed since the previous scan of the same path.");
+    auto cacheMaxSize = parser.AddArg<uint64_t>("cache-max-size", "Size limit of the cache in MiB, least recently used results are removed first.").Default(ResultCache::DEFAULT_MAX_SIZE / (1024 * 1024));
+    auto stats = parser.AddArg<std::string>("stats", "Report phase timings, throughput, criteria rejections and memory, as text or json.");
+    auto perfCounters = parser.AddFlag("perf-counters", "Report the hardware counters of the load, scan and write phases of every thread.");
+    auto trace = parser.AddArg<std::string>("trace", "Record what every thread did to a Chrome trace file, for Perfetto.");
+    auto progress = parser.AddArg<std::string>("progress", "Print the bytes scanned, throughput, ETA and results found to stderr while scanning, as text or json lines.");
+    auto progressInterval = parser.AddArg<size_t>("progress-interval", "Milliseconds between two progress reports.").Default(1000);
 
-    parser.ParseArgs(argc, argv);
+    // --stats and --progress alone stand for their text format
+    std::vector<std::string> args(argv, argv + argc);
+    for (size_t i = 1; i < args.size(); i++) {
+        bool hasValue = i + 1 < args.size() && (args[i + 1] == "text" || args[i + 1] == "json");
+        if ((args[i] == "--stats" || args[i] == "--progress") && !hasValue) args[i] += "=text";
+    }
+
+    parser.ParseArgs(args);
 
     if (filename && structure) {
-        std::string outputFilePath = "output.txt";
+        ScanOptions options{};
 
-        if (!output) {
+        if (*countOnly > 0) {
+            options.countOnly = true;
+        } else if (!output) {
             std::cout << "* No output file specified, using default output.txt" << std::endl;
         } else {
-            outputFilePath = *output;
+            options.outputFilePath = *output;
+        }
+
+        options.format = ResultWriter::getFormatByName(*format);
+
+        if (options.format == RESULT_FORMAT_NONE) {
+            std::cout << "[-] Unknown output format: " << *format << std::endl;
+            return 1;
+        }
+
+        options.asyncWrite = *asyncWrite > 0;
+        if (maxResults) options.maxResults = *maxResults;
+        if (*first > 0) options.maxResults = 1;
+        if (exportBytes) options.exportBytesPath = *exportBytes;
+        options.threads = *threads;
+        options.chunkSize = *chunkSize;
+        options.useTune = *noTune == 0;
+        options.useIndex = *useIndex > 0;
+        options.incremental = *incremental > 0;
+        options.useCache = *useCache > 0 || cacheDirectory || options.incremental;
+        options.cacheDirectory = cacheDirectory ? *cacheDirectory : ResultCache::defaultDirectory();
+        options.cacheMaxSize = *cacheMaxSize * 1024 * 1024;
+
+        if (stats) {
+            if (*stats != "text" && *stats != "json") {
+                std::cout << "[-] Unknown statistics format: " << *stats << std::endl;
+                return 1;
+            }
+
+            options.stats = *stats;
+        }
+
+        options.perfCounters = *perfCounters > 0;
+
+        if (progress) {
+            if (*progress != "text" && *progress != "json") {
+                std::cout << "[-] Unknown progress format: " << *progress << std::endl;
+                return 1;
+            }
+
+            options.progress = *progress;
+            options.progressInterval = *progressInterval;
+        }
+
+        // every thread records its spans until the scan is done
+        std::unique_ptr<ScanTrace> scanTrace;
+
+        if (trace) {
+            scanTrace = std::make_unique<ScanTrace>();
+            scanTrace->start();
+        }
+
+        bool success;
+
+        if (*follow > 0) {
+            success = follow_file(*filename, *structure, options);
+        } else {
+            success = scan_file(*filename, *structure, options);
+        }
+
+        if (scanTrace) {
+            scanTrace->stop();
+
+            if (!scanTrace->save(*trace)) {
+                std::cout << "[-] Failed to write the trace to " << *trace << "." << std::endl;
+                return 1;
+            }
+
+            std::cout << "* Trace of " << scanTrace->getEventCount() << " spans saved in " << *trace;
+            if (scanTrace->getDroppedCount() > 0) std::cout << ", the " << scanTrace->getDroppedCount() << " oldest were overwritten";
+            std::cout << "." << std::endl;
         }
 
-        scan_file(*filename, *structure, outputFilePath);
+        if (!success) return 1;
     } else {
-        std::cout << "Usage: " << argv[0] << " -f <filename> -s <structure> -o [output]" << std::endl;
+        std::cout << "Usage: " << argv[0] << " -f <filename> -s <structure> -o [output] [--format text|csv|jsonl|binary] [--async-write] [--max-results N] [--first] [--count] [--export-bytes file] [-t threads] [--chunk-size bytes] [--no-tune] [--use-index] [--follow] [--cache] [--incremental] [--cache-dir dir] [--cache-max-size MiB] [--stats[=json]] [--perf-counters] [--trace file] [--progress[=json]] [--progress-interval ms]" << std::endl;
+        std::cout << "       " << argv[0] << " index -f <filename> [-o output]" << std::endl;
+        std::cout << "       " << argv[0] << " suffix-index -f <filename> [-o output]" << std::endl;
+        std::cout << "       " << argv[0] << " watch -p <pid> -s <structure> [-o output] [--interval ms]" << std::endl;
+        std::cout << "       " << argv[0] << " sample -p <pid> -r <results> -s <structure> -o <output> [--rate hz]" << std::endl;
+        std::cout << "       " << argv[0] << " snapshot -p <pid> -o <output> [--compression none|zlib|lz4|zstd] [--stop]" << std::endl;
+        std::cout << "       " << argv[0] << " tune [-o output] [--size MiB] [--class anchored|range|pattern]" << std::endl;
+        std::cout << "       " << argv[0] << " serve [--socket path] [-t threads]" << std::endl;
+        std::cout << "       " << argv[0] << " query [--socket path] -f <filename> -s <structure> [-o output]" << std::endl;
     }
 
     return 0;
@@ -0,0 +1,115 @@
+#include "ProcessMemory.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+bool MemoryRegion::isSpecial() const {
+    return path == "[vvar]" || path == "[vvar_vclock]" || path == "[vsyscall]" || path == "[vdso]";
+}
+
+ProcessMemory::ProcessMemory(pid_t pid) : pid(pid) {}
+
+bool ProcessMemory::exists() const {
+    return kill(pid, 0) == 0 || errno == EPERM;
+}
+
+size_t ProcessMemory::pageSize() {
+    static const size_t size = (size_t) sysconf(_SC_PAGESIZE);
+    return size;
+}
+
+std::vector<MemoryRegion> ProcessMemory::readRegions() const {
+    std::vector<MemoryRegion> regions;
+    std::ifstream maps("/proc/" + std::to_string(pid) + "/maps");
+    std::string line;
+
+    // start-end perms offset dev inode [path]
+    while (std::getline(maps, line)) {
+        MemoryRegion region{};
+        char permissions[5] = {};
+        unsigned long long start, end, offset;
+        int pathStart = 0;
+
+        if (sscanf(line.c_str(), "%llx-%llx %4s %llx %*s %*s %n", &start, &end, permissions, &offset, &pathStart) < 4) continue;
+
+        region.start = start;
+        region.end = end;
+        region.offset = offset;
+        region.readable = permissions[0] == 'r';
+        region.writable = permissions[1] == 'w';
+        region.executable = permissions[2] == 'x';
+        region.shared = permissions[3] == 's';
+        if (pathStart > 0 && (size_t) pathStart < line.size()) region.path = line.substr(pathStart);
+
+        regions.push_back(region);
+    }
+
+    return regions;
+}
+
+ssize_t ProcessMemory::readv(const struct iovec* local, size_t localCount, const struct iovec* remote, size_t remoteCount) const {
+    ssize_t bytesRead;
+
+    do {
+        bytesRead = process_vm_readv(pid, local, localCount, remote, remoteCount, 0);
+    } while (bytesRead < 0 && errno == EINTR);
+
+    return bytesRead;
+}
+
+size_t ProcessMemory::read(uint64_t address, void* buffer, size_t size) const {
+    size_t total = 0;
+
+    // process_vm_readv stops at the first unreadable page, partial reads are retried from there
+    while (total < size) {
+        struct iovec local = { (char*) buffer + total, size - total };
+        struct iovec remote = { (void*) (uintptr_t) (address + total), size - total };
+
+        ssize_t bytesRead = readv(&local, 1, &remote, 1);
+        if (bytesRead <= 0) break;
+
+        total += (size_t) bytesRead;
+    }
+
+    return total;
+}
+
+bool ProcessMemory::clearSoftDirty() const {
+    int fd = open(("/proc/" + std::to_string(pid) + "/clear_refs").c_str(), O_WRONLY);
+    if (fd < 0) return false;
+
+    bool cleared = write(fd, "4", 1) == 1;
+    close(fd);
+
+    return cleared;
+}
+
+bool ProcessMemory::readPagemap(uint64_t start, uint64_t end, std::vector<uint64_t>& entries) const {
+    int fd = open(("/proc/" + std::to_string(pid) + "/pagemap").c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    size_t count = (end - start) / pageSize();
+    entries.resize(count);
+
+    size_t total = 0;
+    off_t position = (off_t) (start / pageSize() * sizeof(uint64_t));
+
+    while (total < count * sizeof(uint64_t)) {
+        ssize_t bytesRead = pread(fd, (char*) entries.data() + total, count * sizeof(uint64_t) - total, position + (off_t) total);
+
+        if (bytesRead < 0 && errno == EINTR) continue;
+        if (bytesRead <= 0) break;
+
+        total += (size_t) bytesRead;
+    }
+
+    close(fd);
+    return total == count * sizeof(uint64_t);
+}
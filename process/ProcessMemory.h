@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+// One mapping of /proc/<pid>/maps
+struct MemoryRegion {
+    uint64_t start;
+    uint64_t end;
+    bool readable;
+    bool writable;
+    bool executable;
+    bool shared;
+    uint64_t offset;
+    std::string path;
+
+    uint64_t size() const { return end - start; }
+    // kernel pseudo mappings such as [vvar] cannot be read through process_vm_readv
+    bool isSpecial() const;
+};
+
+// Access to the memory of another process through process_vm_readv and the /proc interfaces.
+// Reading needs the same permissions as ptrace: the same user and a permissive ptrace_scope, or
+// CAP_SYS_PTRACE.
+class ProcessMemory {
+public:
+    // pagemap entry bits, see Documentation/admin-guide/mm/pagemap.rst
+    static constexpr uint64_t PAGEMAP_PRESENT = 1ULL << 63;
+    static constexpr uint64_t PAGEMAP_SWAPPED = 1ULL << 62;
+    static constexpr uint64_t PAGEMAP_SOFT_DIRTY = 1ULL << 55;
+
+    explicit ProcessMemory(pid_t pid);
+
+    pid_t getPid() const { return pid; }
+    bool exists() const;
+
+    static size_t pageSize();
+
+    std::vector<MemoryRegion> readRegions() const;
+
+    // reads size bytes at address, returns the number of bytes read before the first unreadable page
+    size_t read(uint64_t address, void* buffer, size_t size) const;
+
+    // single process_vm_readv call, the iovec counts must not exceed IOV_MAX
+    ssize_t readv(const struct iovec* local, size_t localCount, const struct iovec* remote, size_t remoteCount) const;
+
+    // resets the soft-dirty bit of every page of the process
+    bool clearSoftDirty() const;
+
+    // one pagemap entry per page of [start, end), both page aligned
+    bool readPagemap(uint64_t start, uint64_t end, std::vector<uint64_t>& entries) const;
+
+private:
+    pid_t pid;
+};
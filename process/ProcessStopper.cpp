@@ -0,0 +1,46 @@
+#include "ProcessStopper.h"
+
+#include <cstdlib>
+#include <dirent.h>
+#include <string>
+
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+
+ProcessStopper::~ProcessStopper() {
+    resume();
+}
+
+bool ProcessStopper::stop() {
+    bool foundNew = true;
+
+    while (foundNew) {
+        foundNew = false;
+
+        DIR* tasks = opendir(("/proc/" + std::to_string(pid) + "/task").c_str());
+        if (tasks == nullptr) return false;
+
+        while (struct dirent* entry = readdir(tasks)) {
+            pid_t tid = (pid_t) atoi(entry->d_name);
+            if (tid <= 0 || stopped.count(tid) > 0) continue;
+
+            if (ptrace(PTRACE_SEIZE, tid, nullptr, nullptr) != 0) continue;
+
+            int status;
+            ptrace(PTRACE_INTERRUPT, tid, nullptr, nullptr);
+            waitpid(tid, &status, __WALL);
+
+            stopped.insert(tid);
+            foundNew = true;
+        }
+
+        closedir(tasks);
+    }
+
+    return !stopped.empty();
+}
+
+void ProcessStopper::resume() {
+    for (pid_t tid : stopped) ptrace(PTRACE_DETACH, tid, nullptr, nullptr);
+    stopped.clear();
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <set>
+
+#include <sys/types.h>
+
+// Stops every thread of a process with PTRACE_SEIZE + PTRACE_INTERRUPT, threads created while
+// stopping are caught by listing the tasks again until no new one shows up
+class ProcessStopper {
+public:
+    explicit ProcessStopper(pid_t pid) : pid(pid) {}
+    ~ProcessStopper();
+
+    // false when no thread could be stopped, such as when another tracer is attached
+    bool stop();
+    void resume();
+
+private:
+    pid_t pid;
+    std::set<pid_t> stopped;
+};
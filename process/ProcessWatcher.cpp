@@ -0,0 +1,272 @@
+#include "ProcessWatcher.h"
+
+#include <algorithm>
+
+#include "ProcessStopper.h"
+#include "../cache/ContentHash.h"
+
+ProcessWatcher::ProcessWatcher(pid_t pid, std::shared_ptr<const CompiledStructure> structure)
+    : memory(pid), structure(std::move(structure)) {}
+
+std::vector<MemoryRegion> ProcessWatcher::watchableRegions() const {
+    std::vector<MemoryRegion> watchable;
+
+    // read-only mappings cannot change, they are not watched
+    for (const MemoryRegion& region : memory.readRegions()) {
+        if (region.readable && region.writable && !region.isSpecial()) watchable.push_back(region);
+    }
+
+    return watchable;
+}
+
+bool ProcessWatcher::detectSoftDirty(const std::vector<MemoryRegion>& candidates) const {
+    std::vector<uint64_t> entries;
+
+    // every page is soft-dirty until the first reset, a kernel without the feature never sets the bit
+    for (const MemoryRegion& region : candidates) {
+        if (!memory.readPagemap(region.start, region.end, entries)) return false;
+
+        for (uint64_t entry : entries) {
+            if ((entry & ProcessMemory::PAGEMAP_PRESENT) && (entry & ProcessMemory::PAGEMAP_SOFT_DIRTY)) return true;
+        }
+    }
+
+    return false;
+}
+
+std::vector<uint64_t> ProcessWatcher::hashPages(uint64_t start, uint64_t end) const {
+    size_t pageSize = ProcessMemory::pageSize();
+    std::vector<uint64_t> hashes;
+    std::vector<char> block(std::min<uint64_t>(READ_SIZE, end - start));
+
+    hashes.reserve((end - start) / pageSize);
+
+    for (uint64_t address = start; address < end; address += block.size()) {
+        size_t size = std::min<uint64_t>(block.size(), end - address);
+        size_t bytesRead = memory.read(address, block.data(), size);
+
+        for (size_t offset = 0; offset < size; offset += pageSize) {
+            // unreadable pages hash to 0, they change once they become readable
+            hashes.push_back(offset < bytesRead ? ContentHash::hash(block.data() + offset, pageSize) | 1 : 0);
+        }
+    }
+
+    return hashes;
+}
+
+std::vector<std::pair<uint64_t, uint64_t>> ProcessWatcher::findDirtyRanges(WatchedRegion& region) {
+    size_t pageSize = ProcessMemory::pageSize();
+    std::vector<std::pair<uint64_t, uint64_t>> ranges;
+    std::vector<uint64_t> entries;
+    std::vector<bool> dirty;
+
+    if (!region.scanned) {
+        if (!softDirty) region.pageHashes = hashPages(region.start, region.end);
+
+        ranges.emplace_back(region.start, region.end);
+        dirtyPages += (region.end - region.start) / pageSize;
+        return ranges;
+    }
+
+    if (softDirty) {
+        if (!memory.readPagemap(region.start, region.end, entries)) {
+            region.grown.clear();
+            ranges.emplace_back(region.start, region.end);
+            dirtyPages += (region.end - region.start) / pageSize;
+            return ranges;
+        }
+
+        dirty.resize(entries.size());
+        for (size_t i = 0; i < entries.size(); i++) dirty[i] = (entries[i] & ProcessMemory::PAGEMAP_SOFT_DIRTY) != 0;
+    } else {
+        std::vector<uint64_t> hashes = hashPages(region.start, region.end);
+
+        dirty.resize(hashes.size());
+        for (size_t i = 0; i < hashes.size(); i++) dirty[i] = i >= region.pageHashes.size() || hashes[i] != region.pageHashes[i];
+
+        region.pageHashes = std::move(hashes);
+    }
+
+    for (const auto& range : region.grown) {
+        for (uint64_t address = range.first; address < range.second; address += pageSize) dirty[(address - region.start) / pageSize] = true;
+    }
+
+    region.grown.clear();
+
+    for (size_t i = 0; i < dirty.size(); i++) {
+        if (!dirty[i]) continue;
+
+        uint64_t start = region.start + i * pageSize;
+        dirtyPages++;
+
+        if (!ranges.empty() && ranges.back().second == start) {
+            ranges.back().second = start + pageSize;
+        } else {
+            ranges.emplace_back(start, start + pageSize);
+        }
+    }
+
+    return ranges;
+}
+
+void ProcessWatcher::removeResults(uint64_t start, uint64_t end, std::vector<WatchEvent>& events) {
+    auto first = results.lower_bound(start);
+    auto last = results.lower_bound(end);
+
+    for (auto it = first; it != last; ++it) events.push_back(WatchEvent{ false, *it });
+    results.erase(first, last);
+}
+
+void ProcessWatcher::evaluate(const WatchedRegion& region, uint64_t start, uint64_t end, std::vector<WatchEvent>& events) {
+    size_t structureSize = structure->getSize();
+    if (structureSize == 0 || region.end - region.start < structureSize) return;
+
+    // a structure has to fit in its region
+    end = std::min(end, region.end - structureSize + 1);
+    if (start >= end) return;
+
+    for (uint64_t blockStart = start; blockStart < end; blockStart += READ_SIZE) {
+        uint64_t blockEnd = std::min<uint64_t>(blockStart + READ_SIZE, end);
+        size_t size = blockEnd - blockStart + structureSize - 1;
+
+        buffer.resize(size);
+        size_t bytesRead = memory.read(blockStart, buffer.data(), size);
+
+        // results are diffed against the previous ones of the same range
+        auto previous = results.lower_bound(blockStart);
+        auto previousEnd = results.lower_bound(blockEnd);
+        std::vector<uint64_t> found;
+
+        CallbackSink collector([&](const ScannerResult& result) {
+            found.push_back(blockStart + result.offset);
+            return true;
+        });
+
+        structure->scan(buffer.data(), bytesRead, collector);
+
+        std::vector<uint64_t> removed;
+        auto current = found.begin();
+
+        while (previous != previousEnd || current != found.end()) {
+            if (current == found.end() || (previous != previousEnd && *previous < *current)) {
+                removed.push_back(*previous++);
+            } else if (previous == previousEnd || *current < *previous) {
+                events.push_back(WatchEvent{ true, *current });
+                results.insert(previousEnd, *current++);
+            } else {
+                ++previous;
+                ++current;
+            }
+        }
+
+        for (uint64_t address : removed) {
+            events.push_back(WatchEvent{ false, address });
+            results.erase(address);
+        }
+    }
+}
+
+bool ProcessWatcher::start(std::vector<WatchEvent>& events) {
+    if (!memory.exists()) return false;
+
+    std::vector<MemoryRegion> current = watchableRegions();
+    softDirty = detectSoftDirty(current) && memory.clearSoftDirty();
+
+    regions.clear();
+    results.clear();
+
+    return update(events);
+}
+
+bool ProcessWatcher::update(std::vector<WatchEvent>& events) {
+    if (!memory.exists()) return false;
+
+    size_t structureSize = structure->getSize();
+    std::vector<MemoryRegion> current = watchableRegions();
+    std::map<uint64_t, WatchedRegion> next;
+
+    dirtyPages = 0;
+
+    // a region overlapping one of the previous pass keeps the results of the overlap, other results
+    // are dropped; new regions and the pages a region gained are scanned entirely
+    std::vector<std::pair<uint64_t, uint64_t>> kept;
+    size_t pageSize = ProcessMemory::pageSize();
+
+    for (const MemoryRegion& region : current) {
+        WatchedRegion watched{ region.start, region.end, false, {}, {} };
+
+        auto previous = regions.upper_bound(region.start);
+        if (previous != regions.begin() && std::prev(previous)->second.end > region.start) --previous;
+
+        if (previous != regions.end() && previous->second.start < region.end && previous->second.scanned) {
+            const WatchedRegion& old = previous->second;
+            uint64_t overlapStart = std::max(old.start, region.start);
+            uint64_t overlapEnd = std::min(old.end, region.end);
+
+            watched.scanned = true;
+            if (region.start < overlapStart) watched.grown.emplace_back(region.start, overlapStart);
+            if (overlapEnd < region.end) watched.grown.emplace_back(overlapEnd, region.end);
+
+            if (overlapEnd - overlapStart >= structureSize) kept.emplace_back(overlapStart, overlapEnd - structureSize + 1);
+
+            if (!softDirty) {
+                watched.pageHashes.assign((region.end - region.start) / pageSize, 0);
+
+                for (uint64_t address = overlapStart; address < overlapEnd; address += pageSize) {
+                    size_t page = (address - old.start) / pageSize;
+                    if (page < old.pageHashes.size()) watched.pageHashes[(address - region.start) / pageSize] = old.pageHashes[page];
+                }
+            }
+        }
+
+        next[region.start] = std::move(watched);
+    }
+
+    uint64_t keptEnd = 0;
+
+    for (const auto& range : kept) {
+        if (range.first > keptEnd) removeResults(keptEnd, range.first, events);
+        keptEnd = range.second;
+    }
+
+    removeResults(keptEnd, UINT64_MAX, events);
+    regions = std::move(next);
+
+    std::vector<std::pair<WatchedRegion*, std::vector<std::pair<uint64_t, uint64_t>>>> work;
+
+    // a page written between its pagemap read and the reset would lose its soft-dirty bit without
+    // being evaluated, the process does not run meanwhile
+    ProcessStopper stopper {memory.getPid()};
+    if (softDirty) stopper.stop();
+
+    for (auto& entry : regions) {
+        std::vector<std::pair<uint64_t, uint64_t>> ranges = findDirtyRanges(entry.second);
+        if (!ranges.empty()) work.emplace_back(&entry.second, std::move(ranges));
+    }
+
+    // reset before reading, so writes made while evaluating show up at the next pass
+    if (softDirty) memory.clearSoftDirty();
+    stopper.resume();
+
+    for (auto& item : work) {
+        WatchedRegion& region = *item.first;
+        std::vector<std::pair<uint64_t, uint64_t>> windows;
+
+        // every structure overlapping a written page starts at most structureSize - 1 bytes before it
+        for (const auto& range : item.second) {
+            uint64_t start = range.first - std::min<uint64_t>(range.first - region.start, structureSize - 1);
+
+            if (!windows.empty() && start <= windows.back().second) {
+                windows.back().second = range.second;
+            } else {
+                windows.emplace_back(start, range.second);
+            }
+        }
+
+        for (const auto& window : windows) evaluate(region, window.first, window.second, events);
+
+        region.scanned = true;
+    }
+
+    return true;
+}
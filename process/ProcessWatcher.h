@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+#include "ProcessMemory.h"
+#include "../scanner/CompiledStructure.h"
+
+struct WatchEvent {
+    bool added;
+    uint64_t address;
+};
+
+// Keeps the results of a structure in the writable memory of a live process up to date.
+// The first pass scans every writable region, later passes only evaluate the structure again
+// where it overlaps a page written since the previous pass, and report the results that appeared
+// or disappeared.
+//
+// Written pages are found with the soft-dirty bits of /proc/<pid>/pagemap, reset through
+// /proc/<pid>/clear_refs at every pass. The process is stopped from the pagemap reads to the reset,
+// so that no write falls in between. Kernels built without soft-dirty tracking fall back to
+// comparing a hash of every page with the previous pass: the whole memory is still read, but the
+// structure is only evaluated on the pages that changed.
+//
+// A region that grew or shrank, like a heap extended by brk or a stack growing down, keeps the
+// results of the part it shares with the previous pass and only the pages it gained are scanned.
+class ProcessWatcher {
+public:
+    // bytes read from the process at once when evaluating a large range
+    static constexpr size_t READ_SIZE = 4 * 1024 * 1024;
+
+    ProcessWatcher(pid_t pid, std::shared_ptr<const CompiledStructure> structure);
+
+    // first pass, every result is reported as added
+    bool start(std::vector<WatchEvent>& events);
+
+    // later passes, returns false once the process is gone
+    bool update(std::vector<WatchEvent>& events);
+
+    bool usesSoftDirty() const { return softDirty; }
+    size_t getResultCount() const { return results.size(); }
+    // pages evaluated again by the last pass
+    size_t getDirtyPageCount() const { return dirtyPages; }
+
+private:
+    struct WatchedRegion {
+        uint64_t start;
+        uint64_t end;
+        bool scanned;
+        // hash of every page, only used without soft-dirty tracking
+        std::vector<uint64_t> pageHashes;
+        // [start, end) ranges gained since the previous pass, evaluated entirely
+        std::vector<std::pair<uint64_t, uint64_t>> grown;
+    };
+
+    std::vector<MemoryRegion> watchableRegions() const;
+    bool detectSoftDirty(const std::vector<MemoryRegion>& regions) const;
+
+    // [start, end) ranges of the region written since the previous pass
+    std::vector<std::pair<uint64_t, uint64_t>> findDirtyRanges(WatchedRegion& region);
+    std::vector<uint64_t> hashPages(uint64_t start, uint64_t end) const;
+
+    // evaluates the structure at every start address of [start, end) within the region
+    void evaluate(const WatchedRegion& region, uint64_t start, uint64_t end, std::vector<WatchEvent>& events);
+    void removeResults(uint64_t start, uint64_t end, std::vector<WatchEvent>& events);
+
+    ProcessMemory memory;
+    std::shared_ptr<const CompiledStructure> structure;
+
+    bool softDirty = false;
+    size_t dirtyPages = 0;
+
+    std::map<uint64_t, WatchedRegion> regions;
+    std::set<uint64_t> results;
+
+    std::vector<char> buffer;
+};
@@ -0,0 +1,272 @@
+#include "Sampler.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <ctime>
+#include <ostream>
+
+#include "../scanner/MappedFile.h"
+#include "../scanner/ResultWriter.h"
+
+static uint64_t monotonicNs() {
+    struct timespec now{};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000 + (uint64_t) now.tv_nsec;
+}
+
+Sampler::Sampler(pid_t pid, const std::vector<ScannerField>& fields, std::vector<uint64_t> addresses)
+    : memory(pid), layout(fields), addresses(std::move(addresses)) {
+    size_t structureSize = layout.getStructureSize();
+
+    std::sort(this->addresses.begin(), this->addresses.end());
+    this->addresses.erase(std::unique(this->addresses.begin(), this->addresses.end()), this->addresses.end());
+
+    size_t total = 0;
+
+    for (uint64_t address : this->addresses) {
+        uint64_t end = address + structureSize;
+
+        if (!remote.empty()) {
+            struct iovec& last = remote.back();
+            uint64_t lastEnd = (uint64_t) (uintptr_t) last.iov_base + last.iov_len;
+
+            if (address <= lastEnd + MAX_GAP) {
+                uint64_t grown = std::max(lastEnd, end) - lastEnd;
+
+                positions.push_back(rangeOffsets.back() + (address - (uint64_t) (uintptr_t) last.iov_base));
+                addressRanges.push_back(remote.size() - 1);
+                last.iov_len += grown;
+                total += grown;
+                continue;
+            }
+        }
+
+        remote.push_back(iovec{ (void*) (uintptr_t) address, structureSize });
+        rangeOffsets.push_back(total);
+        positions.push_back(total);
+        addressRanges.push_back(remote.size() - 1);
+        total += structureSize;
+    }
+
+    gathered.resize(total);
+    readEnds.resize(remote.size());
+    record.resize(sizeof(SampleRecord) + sampleBitmapSize(this->addresses.size()) + this->addresses.size() * structureSize);
+}
+
+size_t Sampler::getCallsPerTick() const {
+    return (remote.size() + IOV_MAX - 1) / IOV_MAX;
+}
+
+bool Sampler::open(const std::string& filename) {
+    file = fopen(filename.c_str(), "wb");
+    if (file == nullptr) return false;
+
+    setvbuf(file, nullptr, _IOFBF, 4 * 1024 * 1024);
+
+    SampleFileHeader header{};
+    memcpy(header.magic, SAMPLE_FILE_MAGIC, sizeof(SAMPLE_FILE_MAGIC));
+    header.version = SAMPLE_FILE_VERSION;
+    header.fieldCount = layout.getFieldCount();
+    header.addressCount = addresses.size();
+    header.structureSize = layout.getStructureSize();
+
+    fwrite(&header, sizeof(header), 1, file);
+
+    for (size_t i = 0; i < layout.getFieldCount(); i++) {
+        uint32_t primitive = layout.getFieldPrimitive(i);
+        uint64_t size = layout.getFieldSize(i);
+
+        fwrite(&primitive, sizeof(primitive), 1, file);
+        fwrite(&size, sizeof(size), 1, file);
+    }
+
+    fwrite(addresses.data(), sizeof(uint64_t), addresses.size(), file);
+
+    return !ferror(file);
+}
+
+void Sampler::sample(uint64_t timestampNs) {
+    size_t structureSize = layout.getStructureSize();
+    uint64_t bytesRead = 0;
+    size_t first = 0;
+
+    // one local buffer, one remote range per coalesced group; a read stops at the first unreadable
+    // range, the ranges after it are read again by the next call
+    while (first < remote.size()) {
+        size_t count = std::min<size_t>(IOV_MAX, remote.size() - first);
+        size_t offset = rangeOffsets[first];
+        size_t length = (first + count < remote.size() ? rangeOffsets[first + count] : gathered.size()) - offset;
+
+        struct iovec local = { gathered.data() + offset, length };
+        ssize_t result = memory.readv(&local, 1, remote.data() + first, count);
+
+        size_t valid = result > 0 ? (size_t) result : 0;
+        bytesRead += valid;
+
+        if (valid == length) {
+            for (size_t i = first; i < first + count; i++) readEnds[i] = rangeOffsets[i] + remote[i].iov_len;
+            first += count;
+            continue;
+        }
+
+        // the range holding the first byte that could not be read
+        size_t failed = std::upper_bound(rangeOffsets.begin() + first, rangeOffsets.begin() + first + count, offset + valid) - rangeOffsets.begin() - 1;
+
+        for (size_t i = first; i < failed; i++) readEnds[i] = rangeOffsets[i] + remote[i].iov_len;
+        readEnds[failed] = offset + valid;
+
+        size_t failedEnd = rangeOffsets[failed] + remote[failed].iov_len;
+        memset(gathered.data() + offset + valid, 0, failedEnd - (offset + valid));
+
+        first = failed + 1;
+
+        // the process is gone, nothing else can be read
+        if (result < 0 && errno != EFAULT) {
+            for (size_t i = first; i < remote.size(); i++) readEnds[i] = rangeOffsets[i];
+            memset(gathered.data() + failedEnd, 0, gathered.size() - failedEnd);
+            break;
+        }
+    }
+
+    auto header = (SampleRecord*) record.data();
+    header->timestampNs = timestampNs;
+    header->bytesRead = bytesRead;
+
+    auto bitmap = (uint8_t*) record.data() + sizeof(SampleRecord);
+    char* values = record.data() + sizeof(SampleRecord) + sampleBitmapSize(addresses.size());
+
+    memset(bitmap, 0, sampleBitmapSize(addresses.size()));
+
+    for (size_t i = 0; i < addresses.size(); i++) {
+        if (positions[i] + structureSize <= readEnds[addressRanges[i]]) {
+            bitmap[i / 8] |= (uint8_t) (1 << (i % 8));
+            memcpy(values + i * structureSize, gathered.data() + positions[i], structureSize);
+        } else {
+            memset(values + i * structureSize, 0, structureSize);
+        }
+    }
+
+    fwrite(record.data(), record.size(), 1, file);
+}
+
+bool Sampler::run(uint64_t periodNs, uint64_t ticks, volatile sig_atomic_t& stop) {
+    if (file == nullptr || addresses.empty() || layout.getStructureSize() == 0 || periodNs == 0) return false;
+
+    // the period is recorded once known
+    fseek(file, offsetof(SampleFileHeader, periodNs), SEEK_SET);
+    fwrite(&periodNs, sizeof(periodNs), 1, file);
+    fseek(file, 0, SEEK_END);
+
+    uint64_t start = monotonicNs();
+    uint64_t next = start;
+
+    while (!stop && (ticks == 0 || tickCount < ticks)) {
+        // absolute deadlines keep the rate exact, sleeping never accumulates drift
+        struct timespec deadline = { (time_t) (next / 1000000000), (long) (next % 1000000000) };
+        int error = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr);
+
+        if (error == EINTR) continue;
+
+        sample(next - start);
+        tickCount++;
+
+        next += periodNs;
+
+        // a late tick does not trigger a burst of catch-up reads
+        uint64_t now = monotonicNs();
+
+        if (now > next) {
+            uint64_t missed = (now - next) / periodNs + 1;
+            overrunCount += missed;
+            next += missed * periodNs;
+        }
+    }
+
+    bool success = !ferror(file);
+    success &= fclose(file) == 0;
+    file = nullptr;
+
+    return success;
+}
+
+bool Sampler::decode(const std::string& filename, std::ostream& out) {
+    MappedFile input;
+    if (!input.open(filename) || input.size() < sizeof(SampleFileHeader)) return false;
+
+    auto data = (const char*) input.data();
+    SampleFileHeader header{};
+    memcpy(&header, data, sizeof(header));
+
+    if (memcmp(header.magic, SAMPLE_FILE_MAGIC, sizeof(SAMPLE_FILE_MAGIC)) != 0 || header.version != SAMPLE_FILE_VERSION) return false;
+
+    size_t position = sizeof(header);
+    std::vector<ScannerField> fields;
+
+    for (uint64_t i = 0; i < header.fieldCount; i++) {
+        uint32_t primitive;
+        uint64_t size;
+
+        if (position + sizeof(primitive) + sizeof(size) > input.size()) return false;
+
+        memcpy(&primitive, data + position, sizeof(primitive));
+        memcpy(&size, data + position + sizeof(primitive), sizeof(size));
+        position += sizeof(primitive) + sizeof(size);
+
+        if (primitive > SCANNER_PRIMITIVE_STRING) return false;
+
+        ScannerField field{};
+        field.primitive = (ScannerPrimitive) primitive;
+        field.size = size;
+        fields.push_back(field);
+    }
+
+    StructureLayout layout {fields};
+    if (layout.getStructureSize() != header.structureSize) return false;
+
+    if (position + header.addressCount * sizeof(uint64_t) > input.size()) return false;
+
+    std::vector<uint64_t> addresses(header.addressCount);
+    memcpy(addresses.data(), data + position, header.addressCount * sizeof(uint64_t));
+    position += header.addressCount * sizeof(uint64_t);
+
+    size_t bitmapSize = sampleBitmapSize(header.addressCount);
+    size_t recordSize = sizeof(SampleRecord) + bitmapSize + header.addressCount * header.structureSize;
+    std::string line = "time_ns,address";
+
+    for (size_t i = 0; i < layout.getFieldCount(); i++) {
+        line += ",field" + std::to_string(i) + "_" + std::get<std::string>(PRIM_DETAILS[layout.getFieldPrimitive(i)]);
+    }
+
+    out << line << '\n';
+
+    for (; position + recordSize <= input.size(); position += recordSize) {
+        SampleRecord record{};
+        memcpy(&record, data + position, sizeof(record));
+
+        auto bitmap = (const uint8_t*) data + position + sizeof(SampleRecord);
+        const char* values = data + position + sizeof(SampleRecord) + bitmapSize;
+
+        for (size_t i = 0; i < addresses.size(); i++) {
+            ScannerResult result{ header.structureSize, addresses[i], (void*) (values + i * header.structureSize) };
+
+            line = std::to_string(record.timestampNs) + ",0x";
+            char digits[17];
+            snprintf(digits, sizeof(digits), "%llx", (unsigned long long) addresses[i]);
+            line += digits;
+
+            // a structure that could not be read has empty cells
+            bool readable = (bitmap[i / 8] >> (i % 8)) & 1;
+
+            for (size_t j = 0; j < layout.getFieldCount(); j++) {
+                line += ',';
+                if (readable) ResultWriter::appendValue(line, layout.field(result, j), false);
+            }
+
+            out << line << '\n';
+        }
+    }
+
+    return true;
+}
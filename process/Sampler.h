@@ -0,0 +1,88 @@
+#pragma once
+
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <sys/uio.h>
+
+#include "ProcessMemory.h"
+#include "../scanner/StructureLayout.h"
+
+// Header of a sample file, followed by the primitive (uint32) and size (uint64) of every field,
+// the sampled addresses (uint64), then one SampleRecord per tick, each followed by its validity
+// bitmap and the bytes of every sampled structure, in address order.
+const char SAMPLE_FILE_MAGIC[4] = { 'W', 'S', 'M', 'P' };
+const uint32_t SAMPLE_FILE_VERSION = 2;
+
+struct SampleFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t fieldCount;
+    uint64_t addressCount;
+    uint64_t structureSize;
+    uint64_t periodNs;
+};
+
+struct SampleRecord {
+    // nanoseconds since the first tick
+    uint64_t timestampNs;
+    // bytes actually read
+    uint64_t bytesRead;
+    // followed by one bit per address, least significant first, set when the structure could be
+    // read; the structures that could not are zeroed
+};
+
+inline size_t sampleBitmapSize(uint64_t addressCount) {
+    return (addressCount + 7) / 8;
+}
+
+// Reads the same structures of a live process at a fixed rate.
+// Neighbouring addresses are coalesced into as few ranges as possible, and every tick reads all
+// of them with one process_vm_readv call per IOV_MAX ranges, so the cost of a tick barely depends
+// on the number of addresses.
+class Sampler {
+public:
+    // two structures closer than this are read with a single range, the bytes between are discarded
+    static constexpr size_t MAX_GAP = 256;
+
+    Sampler(pid_t pid, const std::vector<ScannerField>& fields, std::vector<uint64_t> addresses);
+
+    bool open(const std::string& filename);
+
+    // samples until ticks samples were taken (0 for no limit) or stop becomes non-zero;
+    // ticks that could not start on time are skipped and counted as overruns
+    bool run(uint64_t periodNs, uint64_t ticks, volatile sig_atomic_t& stop);
+
+    size_t getRangeCount() const { return remote.size(); }
+    size_t getCallsPerTick() const;
+    uint64_t getTickCount() const { return tickCount; }
+    uint64_t getOverrunCount() const { return overrunCount; }
+
+    // writes a sample file as csv: time_ns,address,field0,...
+    static bool decode(const std::string& filename, std::ostream& out);
+
+private:
+    void sample(uint64_t timestampNs);
+
+    ProcessMemory memory;
+    StructureLayout layout;
+    std::vector<uint64_t> addresses;
+
+    // coalesced ranges, and where each address lands in the gathered buffer
+    std::vector<struct iovec> remote;
+    std::vector<size_t> rangeOffsets;
+    std::vector<size_t> positions;
+    std::vector<size_t> addressRanges;
+    // end of the bytes read in each range at the last tick, within the gathered buffer
+    std::vector<size_t> readEnds;
+    std::vector<char> gathered;
+    std::vector<char> record;
+
+    FILE* file = nullptr;
+    uint64_t tickCount = 0;
+    uint64_t overrunCount = 0;
+};
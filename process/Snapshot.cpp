@@ -0,0 +1,498 @@
+#include "Snapshot.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <future>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "ProcessStopper.h"
+#include "../scanner/ScanTrace.h"
+
+#ifdef WALKER_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef WALKER_HAVE_LZ4
+#include <lz4.h>
+#endif
+
+#ifdef WALKER_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "ProcessMemory.h"
+
+// mappings created when loading a snapshot, stays well below the default vm.max_map_count
+static constexpr size_t MAX_FILE_MAPPINGS = 32768;
+
+static uint64_t monotonicNs() {
+    return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool writeAll(int fd, const void* data, size_t size, uint64_t offset) {
+    auto bytes = (const char*) data;
+
+    while (size > 0) {
+        ssize_t written = pwrite(fd, bytes, size, (off_t) offset);
+
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return false;
+
+        bytes += written;
+        size -= (size_t) written;
+        offset += (uint64_t) written;
+    }
+
+    return true;
+}
+
+static bool readAll(int fd, void* data, size_t size, uint64_t offset) {
+    auto bytes = (char*) data;
+
+    while (size > 0) {
+        ssize_t bytesRead = pread(fd, bytes, size, (off_t) offset);
+
+        if (bytesRead < 0 && errno == EINTR) continue;
+        if (bytesRead <= 0) return false;
+
+        bytes += bytesRead;
+        size -= (size_t) bytesRead;
+        offset += (uint64_t) bytesRead;
+    }
+
+    return true;
+}
+
+// the cases of both are those of the libraries this build has, possibly none
+static bool compressData(SnapshotCompression compression, [[maybe_unused]] const char* input, [[maybe_unused]] size_t size,
+                         [[maybe_unused]] std::vector<char>& output) {
+    switch (compression) {
+#ifdef WALKER_HAVE_ZLIB
+        case SNAPSHOT_COMPRESSION_ZLIB: {
+            uLongf length = compressBound((uLong) size);
+            output.resize(length);
+
+            // the fastest level, snapshots are bound by the copy, not by the ratio
+            if (compress2((Bytef*) output.data(), &length, (const Bytef*) input, (uLong) size, 1) != Z_OK) return false;
+
+            output.resize(length);
+            return true;
+        }
+#endif
+#ifdef WALKER_HAVE_LZ4
+        case SNAPSHOT_COMPRESSION_LZ4: {
+            output.resize((size_t) LZ4_compressBound((int) size));
+
+            int length = LZ4_compress_default(input, output.data(), (int) size, (int) output.size());
+            if (length <= 0) return false;
+
+            output.resize((size_t) length);
+            return true;
+        }
+#endif
+#ifdef WALKER_HAVE_ZSTD
+        case SNAPSHOT_COMPRESSION_ZSTD: {
+            output.resize(ZSTD_compressBound(size));
+
+            size_t length = ZSTD_compress(output.data(), output.size(), input, size, 1);
+            if (ZSTD_isError(length)) return false;
+
+            output.resize(length);
+            return true;
+        }
+#endif
+        default:
+            return false;
+    }
+}
+
+static bool decompressData(SnapshotCompression compression, [[maybe_unused]] const char* input, [[maybe_unused]] size_t size,
+                           [[maybe_unused]] char* output, [[maybe_unused]] size_t outputSize) {
+    switch (compression) {
+#ifdef WALKER_HAVE_ZLIB
+        case SNAPSHOT_COMPRESSION_ZLIB: {
+            uLongf length = (uLongf) outputSize;
+            return uncompress((Bytef*) output, &length, (const Bytef*) input, (uLong) size) == Z_OK && length == outputSize;
+        }
+#endif
+#ifdef WALKER_HAVE_LZ4
+        case SNAPSHOT_COMPRESSION_LZ4:
+            return LZ4_decompress_safe(input, output, (int) size, (int) outputSize) == (int) outputSize;
+#endif
+#ifdef WALKER_HAVE_ZSTD
+        case SNAPSHOT_COMPRESSION_ZSTD:
+            return ZSTD_decompress(output, outputSize, input, size) == outputSize;
+#endif
+        default:
+            return false;
+    }
+}
+
+static bool isPageStored(const SnapshotChunk& chunk, size_t page) {
+    return (chunk.storedPages[page / 64] >> (page % 64)) & 1;
+}
+
+static bool isZeroPage(const char* page, size_t pageSize) {
+    auto words = (const uint64_t*) page;
+
+    for (size_t i = 0; i < pageSize / sizeof(uint64_t); i++) {
+        if (words[i] != 0) return false;
+    }
+
+    return true;
+}
+
+bool Snapshot::isSnapshot(const uint8_t* data, size_t size) {
+    return size >= sizeof(SnapshotHeader) && memcmp(data, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) == 0;
+}
+
+SnapshotCompression Snapshot::getCompressionByName(const std::string& name) {
+    for (const auto& i : COMPRESSION_DETAILS) {
+        if (std::get<std::string>(i) == name) {
+            return std::get<SnapshotCompression>(i);
+        }
+    }
+
+    return SNAPSHOT_COMPRESSION_NONE;
+}
+
+bool Snapshot::isCompressionSupported(SnapshotCompression compression) {
+    switch (compression) {
+        case SNAPSHOT_COMPRESSION_NONE:
+            return true;
+#ifdef WALKER_HAVE_ZLIB
+        case SNAPSHOT_COMPRESSION_ZLIB:
+            return true;
+#endif
+#ifdef WALKER_HAVE_LZ4
+        case SNAPSHOT_COMPRESSION_LZ4:
+            return true;
+#endif
+#ifdef WALKER_HAVE_ZSTD
+        case SNAPSHOT_COMPRESSION_ZSTD:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+Snapshot::~Snapshot() {
+    if (base != nullptr) munmap(base, reserved);
+}
+
+bool Snapshot::open(const std::string& path, ThreadPool* pool) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    size_t pageSize = ProcessMemory::pageSize();
+    bool valid = readAll(fd, &header, sizeof(header), 0)
+        && memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) == 0
+        && header.version == SNAPSHOT_VERSION
+        && header.pageSize == pageSize
+        && header.chunkSize % pageSize == 0
+        && header.chunkSize / pageSize <= SNAPSHOT_MAX_CHUNK_PAGES;
+
+    if (valid) {
+        regions.resize(header.regionCount);
+        chunks.resize(header.chunkCount);
+        names.resize(header.namesSize);
+
+        valid = readAll(fd, regions.data(), regions.size() * sizeof(SnapshotRegion), header.regionTableOffset)
+            && readAll(fd, chunks.data(), chunks.size() * sizeof(SnapshotChunk), header.chunkTableOffset)
+            && readAll(fd, names.data(), names.size(), header.namesOffset);
+    }
+
+    for (const SnapshotRegion& region : regions) {
+        valid = valid && region.flatOffset + (region.end - region.start) <= header.flatSize && region.firstChunk + region.chunkCount <= chunks.size();
+    }
+
+    for (const SnapshotChunk& chunk : chunks) {
+        valid = valid && chunk.pageCount <= SNAPSHOT_MAX_CHUNK_PAGES;
+    }
+
+    if (!valid) {
+        ::close(fd);
+        return false;
+    }
+
+    // one reservation for the whole snapshot, pages that were zero are left untouched
+    reserved = std::max<size_t>(header.flatSize, pageSize);
+    void* address = mmap(nullptr, reserved, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+    if (address == MAP_FAILED) {
+        ::close(fd);
+        return false;
+    }
+
+    base = (char*) address;
+
+    std::atomic<bool> success{true};
+    std::vector<std::future<void>> tasks;
+
+    for (const SnapshotRegion& region : regions) {
+        for (uint64_t i = region.firstChunk; i < region.firstChunk + region.chunkCount; i++) {
+            auto load = [this, fd, &region, i, &success] {
+                TraceSpan span{"chunk read", "read", i};
+                if (!loadChunk(fd, region, i)) success = false;
+            };
+
+            if (pool != nullptr && pool->getThreadCount() > 1) {
+                tasks.push_back(pool->submit(load));
+            } else {
+                load();
+            }
+        }
+    }
+
+    for (auto& task : tasks) task.get();
+
+    // the file mappings stay valid once the descriptor is closed
+    ::close(fd);
+
+    return success;
+}
+
+bool Snapshot::loadChunk(int fd, const SnapshotRegion& region, size_t chunkIndex) {
+    static std::atomic<size_t> mappings{0};
+
+    const SnapshotChunk& chunk = chunks[chunkIndex];
+    size_t pageSize = header.pageSize;
+    char* destination = base + region.flatOffset + (chunkIndex - region.firstChunk) * header.chunkSize;
+
+    if (chunk.storedSize == 0) return true;
+
+    std::vector<char> pages;
+    const char* stored = nullptr;
+
+    if (chunk.compression != SNAPSHOT_COMPRESSION_NONE) {
+        std::vector<char> compressed(chunk.storedSize);
+        size_t storedCount = 0;
+
+        for (size_t i = 0; i < chunk.pageCount; i++) storedCount += isPageStored(chunk, i);
+
+        pages.resize(storedCount * pageSize);
+
+        if (!readAll(fd, compressed.data(), compressed.size(), chunk.fileOffset)) return false;
+        if (!decompressData((SnapshotCompression) chunk.compression, compressed.data(), compressed.size(), pages.data(), pages.size())) return false;
+
+        stored = pages.data();
+    }
+
+    // runs of consecutive stored pages are mapped from the file or copied into the reservation
+    size_t storedIndex = 0;
+
+    for (size_t page = 0; page < chunk.pageCount; ) {
+        if (!isPageStored(chunk, page)) {
+            page++;
+            continue;
+        }
+
+        size_t runStart = page;
+        while (page < chunk.pageCount && isPageStored(chunk, page)) page++;
+
+        size_t runLength = (page - runStart) * pageSize;
+        char* target = destination + runStart * pageSize;
+
+        if (stored != nullptr) {
+            memcpy(target, stored + storedIndex * pageSize, runLength);
+        } else if (mappings.fetch_add(1) < MAX_FILE_MAPPINGS) {
+            void* mapped = mmap(target, runLength, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, (off_t) (chunk.fileOffset + storedIndex * pageSize));
+            if (mapped == MAP_FAILED) return false;
+        } else if (!readAll(fd, target, runLength, chunk.fileOffset + storedIndex * pageSize)) {
+            return false;
+        }
+
+        storedIndex += page - runStart;
+    }
+
+    return true;
+}
+
+size_t Snapshot::findRegion(uint64_t flatOffset) const {
+    auto it = std::upper_bound(regions.begin(), regions.end(), flatOffset, [](uint64_t offset, const SnapshotRegion& region) {
+        return offset < region.flatOffset;
+    });
+
+    return it == regions.begin() ? 0 : (size_t) (it - regions.begin() - 1);
+}
+
+SnapshotAddressSink::SnapshotAddressSink(const Snapshot& snapshot, ResultSink& next) : SnapshotAddressSink(snapshot.getRegions(), next) {}
+
+SnapshotAddressSink::SnapshotAddressSink(const std::vector<SnapshotRegion>& regions, ResultSink& next) : regions(regions), next(next) {}
+
+bool SnapshotAddressSink::push(const ScannerResult& result) {
+    // results arrive in increasing order, so does the region they fall in
+    while (region + 1 < regions.size() && result.offset >= regions[region + 1].flatOffset) region++;
+
+    const SnapshotRegion& current = regions[region];
+    uint64_t regionEnd = current.flatOffset + (current.end - current.start);
+
+    if (result.offset < current.flatOffset || result.offset + result.valueSize > regionEnd) return true;
+
+    return next.push(ScannerResult{ result.valueSize, current.start + (result.offset - current.flatOffset), result.value });
+}
+
+bool SnapshotWriter::capture(pid_t pid, const std::string& path, const SnapshotOptions& options, SnapshotStats& stats) {
+    ProcessMemory memory {pid};
+    ProcessStopper stopper {pid};
+    size_t pageSize = ProcessMemory::pageSize();
+    uint64_t started = monotonicNs();
+
+    if (options.chunkSize == 0 || options.chunkSize % pageSize != 0 || options.chunkSize / pageSize > SNAPSHOT_MAX_CHUNK_PAGES) return false;
+    if (!Snapshot::isCompressionSupported(options.compression) || !memory.exists()) return false;
+
+    uint64_t stopStarted = 0;
+
+    if (options.stop) {
+        stopStarted = monotonicNs();
+        if (!stopper.stop()) return false;
+    }
+
+    std::vector<SnapshotRegion> regions;
+    std::vector<SnapshotChunk> chunks;
+    std::string names;
+    uint64_t flatSize = 0;
+
+    for (const MemoryRegion& region : memory.readRegions()) {
+        if (!region.readable || region.isSpecial()) continue;
+        if (options.writableOnly && !region.writable) continue;
+
+        SnapshotRegion entry{};
+        entry.start = region.start;
+        entry.end = region.end;
+        entry.flatOffset = flatSize;
+        entry.firstChunk = chunks.size();
+        entry.chunkCount = (region.size() + options.chunkSize - 1) / options.chunkSize;
+        entry.nameOffset = names.size();
+        entry.nameLength = (uint32_t) region.path.size();
+        entry.permissions = (region.readable ? 1 : 0) | (region.writable ? 2 : 0) | (region.executable ? 4 : 0) | (region.shared ? 8 : 0);
+
+        names += region.path;
+        flatSize += region.size();
+        chunks.resize(chunks.size() + entry.chunkCount);
+        regions.push_back(entry);
+    }
+
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+
+    std::atomic<uint64_t> nextOffset{pageSize};
+    std::atomic<uint64_t> bytesRead{0}, bytesStored{0}, zeroPages{0}, unreadablePages{0};
+    std::atomic<bool> success{true};
+
+    ThreadPool pool {options.threads};
+    std::vector<std::future<void>> tasks;
+
+    for (const SnapshotRegion& region : regions) {
+        for (uint64_t i = 0; i < region.chunkCount; i++) {
+            tasks.push_back(pool.submit([&, i] {
+                SnapshotChunk& chunk = chunks[region.firstChunk + i];
+                uint64_t address = region.start + i * options.chunkSize;
+                size_t length = std::min<uint64_t>(options.chunkSize, region.end - address);
+                std::vector<char> buffer(length);
+
+                size_t valid = memory.read(address, buffer.data(), length);
+
+                // the read stops at the first unreadable page, the following ones are tried one by one
+                std::vector<bool> readable(length / pageSize, true);
+
+                for (size_t offset = valid / pageSize * pageSize; offset < length; offset += pageSize) {
+                    if (memory.read(address + offset, buffer.data() + offset, pageSize) == pageSize) continue;
+
+                    readable[offset / pageSize] = false;
+                    unreadablePages++;
+                }
+
+                // stored pages are packed at the start of the buffer
+                chunk.pageCount = (uint32_t) (length / pageSize);
+                size_t storedCount = 0;
+
+                for (size_t page = 0; page < chunk.pageCount; page++) {
+                    const char* data = buffer.data() + page * pageSize;
+
+                    if (!readable[page] || isZeroPage(data, pageSize)) {
+                        if (readable[page]) zeroPages++;
+                        continue;
+                    }
+
+                    chunk.storedPages[page / 64] |= 1ULL << (page % 64);
+                    if (storedCount != page) memmove(buffer.data() + storedCount * pageSize, data, pageSize);
+                    storedCount++;
+                }
+
+                bytesRead += length;
+
+                const char* output = buffer.data();
+                size_t outputSize = storedCount * pageSize;
+                std::vector<char> compressed;
+
+                // chunks that do not shrink are kept raw, they can then be mapped when loading
+                if (options.compression != SNAPSHOT_COMPRESSION_NONE && outputSize > 0
+                    && compressData(options.compression, output, outputSize, compressed) && compressed.size() < outputSize) {
+                    output = compressed.data();
+                    outputSize = compressed.size();
+                    chunk.compression = options.compression;
+                }
+
+                if (outputSize == 0) return;
+
+                // every chunk starts on a page so raw chunks can be mapped
+                uint64_t reservedSize = (outputSize + pageSize - 1) / pageSize * pageSize;
+                chunk.fileOffset = nextOffset.fetch_add(reservedSize);
+                chunk.storedSize = outputSize;
+                bytesStored += outputSize;
+
+                if (!writeAll(fd, output, outputSize, chunk.fileOffset)) success = false;
+            }));
+        }
+    }
+
+    for (auto& task : tasks) task.get();
+
+    if (options.stop) {
+        stopper.resume();
+        stats.stopTimeNs = monotonicNs() - stopStarted;
+    }
+
+    SnapshotHeader header{};
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = SNAPSHOT_VERSION;
+    header.pid = (uint64_t) pid;
+    header.pageSize = pageSize;
+    header.chunkSize = options.chunkSize;
+    header.flatSize = flatSize;
+    header.regionCount = regions.size();
+    header.chunkCount = chunks.size();
+    header.captureTime = (int64_t) time(nullptr);
+    header.stopTimeNs = stats.stopTimeNs;
+
+    header.regionTableOffset = nextOffset;
+    header.chunkTableOffset = header.regionTableOffset + regions.size() * sizeof(SnapshotRegion);
+    header.namesOffset = header.chunkTableOffset + chunks.size() * sizeof(SnapshotChunk);
+    header.namesSize = names.size();
+
+    success = success
+        && writeAll(fd, regions.data(), regions.size() * sizeof(SnapshotRegion), header.regionTableOffset)
+        && writeAll(fd, chunks.data(), chunks.size() * sizeof(SnapshotChunk), header.chunkTableOffset)
+        && writeAll(fd, names.data(), names.size(), header.namesOffset)
+        && writeAll(fd, &header, sizeof(header), 0);
+
+    success = (::close(fd) == 0) && success;
+
+    stats.regionCount = regions.size();
+    stats.bytesRead = bytesRead;
+    stats.bytesStored = bytesStored;
+    stats.zeroPages = zeroPages;
+    stats.unreadablePages = unreadablePages;
+    stats.elapsedNs = monotonicNs() - started;
+
+    return success;
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <sys/types.h>
+
+#include "../scanner/ResultSink.h"
+#include "../scanner/ThreadPool.h"
+
+// Indexed snapshot of the memory of a process, written by `walker snapshot`.
+//
+// File layout: SnapshotHeader, then the page data of every chunk at page aligned offsets, then the
+// region table, the chunk table and the region names. Regions are cut in chunks of chunkSize
+// bytes of address space. Zero pages are not stored, the stored pages of a chunk follow each other,
+// optionally compressed as a whole. Uncompressed chunks are mapped straight from the file when the
+// snapshot is loaded, so scanning a snapshot reads it at the speed of the page cache.
+
+const char SNAPSHOT_MAGIC[4] = { 'W', 'S', 'N', 'P' };
+const uint32_t SNAPSHOT_VERSION = 1;
+const size_t SNAPSHOT_MAX_CHUNK_PAGES = 256;
+
+typedef enum {
+    SNAPSHOT_COMPRESSION_NONE,
+    SNAPSHOT_COMPRESSION_ZLIB,
+    SNAPSHOT_COMPRESSION_LZ4,
+    SNAPSHOT_COMPRESSION_ZSTD
+} SnapshotCompression;
+
+// Details about each compression
+// { compression, name }
+const std::vector<std::tuple<SnapshotCompression, std::string>> COMPRESSION_DETAILS = {
+    { SNAPSHOT_COMPRESSION_NONE, "none" },
+    { SNAPSHOT_COMPRESSION_ZLIB, "zlib" },
+    { SNAPSHOT_COMPRESSION_LZ4, "lz4" },
+    { SNAPSHOT_COMPRESSION_ZSTD, "zstd" }
+};
+
+struct SnapshotHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t pid;
+    uint64_t pageSize;
+    uint64_t chunkSize;
+    // size of all the regions put back to back
+    uint64_t flatSize;
+    uint64_t regionCount;
+    uint64_t regionTableOffset;
+    uint64_t chunkCount;
+    uint64_t chunkTableOffset;
+    uint64_t namesOffset;
+    uint64_t namesSize;
+    int64_t captureTime;
+    // how long the process was stopped, 0 when it was not
+    uint64_t stopTimeNs;
+};
+
+struct SnapshotRegion {
+    uint64_t start;
+    uint64_t end;
+    uint64_t flatOffset;
+    uint64_t firstChunk;
+    uint64_t chunkCount;
+    uint64_t nameOffset;
+    uint32_t nameLength;
+    // r = 1, w = 2, x = 4, shared = 8
+    uint32_t permissions;
+};
+
+struct SnapshotChunk {
+    uint64_t fileOffset;
+    uint64_t storedSize;
+    uint32_t compression;
+    uint32_t pageCount;
+    // bit i is set when page i of the chunk is stored
+    uint64_t storedPages[SNAPSHOT_MAX_CHUNK_PAGES / 64];
+};
+
+// A snapshot loaded for scanning: the regions are laid out back to back in one reservation,
+// results are translated back to the addresses they had in the process.
+class Snapshot {
+public:
+    Snapshot() = default;
+    ~Snapshot();
+
+    Snapshot(const Snapshot&) = delete;
+    Snapshot& operator=(const Snapshot&) = delete;
+
+    static bool isSnapshot(const uint8_t* data, size_t size);
+    static SnapshotCompression getCompressionByName(const std::string& name);
+    static bool isCompressionSupported(SnapshotCompression compression);
+
+    bool open(const std::string& path, ThreadPool* pool);
+
+    const uint8_t* data() const { return (const uint8_t*) base; }
+    size_t size() const { return header.flatSize; }
+
+    const SnapshotHeader& getHeader() const { return header; }
+    const std::vector<SnapshotRegion>& getRegions() const { return regions; }
+    const std::string& getNames() const { return names; }
+
+    // index of the region holding a flat offset
+    size_t findRegion(uint64_t flatOffset) const;
+
+private:
+    bool loadChunk(int fd, const SnapshotRegion& region, size_t chunkIndex);
+
+    SnapshotHeader header{};
+    std::vector<SnapshotRegion> regions;
+    std::vector<SnapshotChunk> chunks;
+    std::string names;
+
+    char* base = nullptr;
+    size_t reserved = 0;
+};
+
+// Translates the flat offsets of a snapshot scan to process addresses, results straddling two
+// regions are dropped since the regions were not next to each other in the process
+class SnapshotAddressSink : public ResultSink {
+public:
+    SnapshotAddressSink(const Snapshot& snapshot, ResultSink& next);
+    // regions sorted by flat offset, laid end to end as in a snapshot
+    SnapshotAddressSink(const std::vector<SnapshotRegion>& regions, ResultSink& next);
+    bool push(const ScannerResult& result) override;
+
+private:
+    const std::vector<SnapshotRegion>& regions;
+    ResultSink& next;
+    size_t region = 0;
+};
+
+struct SnapshotOptions {
+    SnapshotCompression compression = SNAPSHOT_COMPRESSION_NONE;
+    bool writableOnly = false;
+    // stop every thread of the process with ptrace while its memory is read
+    bool stop = false;
+    size_t threads = 0;
+    size_t chunkSize = 1024 * 1024;
+};
+
+struct SnapshotStats {
+    uint64_t regionCount = 0;
+    uint64_t bytesRead = 0;
+    uint64_t bytesStored = 0;
+    uint64_t zeroPages = 0;
+    uint64_t unreadablePages = 0;
+    uint64_t stopTimeNs = 0;
+    uint64_t elapsedNs = 0;
+};
+
+class SnapshotWriter {
+public:
+    static bool capture(pid_t pid, const std::string& path, const SnapshotOptions& options, SnapshotStats& stats);
+};
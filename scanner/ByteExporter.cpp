@@ -0,0 +1,136 @@
+#include "ByteExporter.h"
+
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+ByteExporter::ByteExporter(const std::string& filename, const std::string& sourceFilename) {
+    outputFd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (!sourceFilename.empty()) sourceFd = open(sourceFilename.c_str(), O_RDONLY);
+}
+
+ByteExporter::~ByteExporter() {
+    close();
+}
+
+bool ByteExporter::isOpen() const {
+    return outputFd >= 0;
+}
+
+bool ByteExporter::push(const ScannerResult& result) {
+    if (outputFd < 0 || failed) return false;
+
+    if (sourceFd < 0) {
+        buffered.append((const char*) result.value, result.valueSize);
+        if (buffered.size() >= BUFFER_SIZE) flushRange();
+
+        return !failed;
+    }
+
+    // extend the pending range when this result directly follows it
+    if (rangeSize > 0 && result.offset == rangeOffset + rangeSize) {
+        rangeSize += result.valueSize;
+        return true;
+    }
+
+    flushRange();
+
+    rangeOffset = result.offset;
+    rangeSize = result.valueSize;
+    rangeData = (const char*) result.value;
+
+    return !failed;
+}
+
+bool ByteExporter::close() {
+    flushRange();
+
+    if (outputFd >= 0 && ::close(outputFd) != 0) failed = true;
+    if (sourceFd >= 0) ::close(sourceFd);
+
+    outputFd = -1;
+    sourceFd = -1;
+
+    return !failed;
+}
+
+void ByteExporter::flushRange() {
+    if (outputFd < 0 || failed) return;
+
+    if (!buffered.empty() && !writeFromMemory(buffered.data(), buffered.size())) failed = true;
+    buffered.clear();
+
+    if (rangeSize == 0 || failed) return;
+
+    size_t copied = copyFromSource(rangeOffset, rangeSize);
+
+    // whatever could not be copied in-kernel is written from the scanned buffer
+    if (copied < rangeSize && (rangeData == nullptr || !writeFromMemory(rangeData + copied, rangeSize - copied))) {
+        failed = true;
+    }
+
+    rangeSize = 0;
+    rangeData = nullptr;
+}
+
+size_t ByteExporter::copyFromSource(size_t offset, size_t size) {
+#ifdef __linux__
+    if (sourceFd < 0) return 0;
+
+    auto position = (off_t) offset;
+
+    while (size > 0 && copyFileRangeSupported) {
+        loff_t input = position;
+        ssize_t copied = copy_file_range(sourceFd, &input, outputFd, nullptr, size, 0);
+
+        if (copied > 0) {
+            position += copied;
+            size -= copied;
+        } else if (copied < 0 && errno == EINTR) {
+            continue;
+        } else if (copied < 0 && (errno == EXDEV || errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP)) {
+            copyFileRangeSupported = false;
+        } else {
+            return (size_t) position - offset;
+        }
+    }
+
+    while (size > 0 && sendfileSupported) {
+        ssize_t copied = sendfile(outputFd, sourceFd, &position, size);
+
+        if (copied > 0) {
+            size -= copied;
+        } else if (copied < 0 && errno == EINTR) {
+            continue;
+        } else if (copied < 0 && (errno == EINVAL || errno == ENOSYS)) {
+            sendfileSupported = false;
+        } else {
+            break;
+        }
+    }
+
+    return (size_t) position - offset;
+#else
+    return 0;
+#endif
+}
+
+bool ByteExporter::writeFromMemory(const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(outputFd, data, size);
+
+        if (written <= 0) {
+            if (written < 0 && errno == EINTR) continue;
+            return false;
+        }
+
+        data += written;
+        size -= written;
+    }
+
+    return true;
+}
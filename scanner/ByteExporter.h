@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+
+#include "ResultSink.h"
+
+// Writes the raw bytes of every result to a binary file, back to back.
+// When the scanned buffer comes from a file, the bytes are copied in-kernel from that file
+// (copy_file_range, then sendfile) instead of going through user space; adjacent results are
+// coalesced into a single copy. Without a source file the results may point into buffers that are
+// reused once push returns (the pieces of a stream), so their bytes are copied to a buffer at once.
+class ByteExporter : public ResultSink {
+public:
+    static constexpr size_t BUFFER_SIZE = 1024 * 1024;
+
+    ByteExporter(const std::string& filename, const std::string& sourceFilename = "");
+    ~ByteExporter() override;
+
+    bool isOpen() const;
+
+    // false once a write failed, the exporter then takes no more results
+    bool push(const ScannerResult& result) override;
+    // false when some of the bytes could not be written, the file is then incomplete
+    bool close();
+
+    bool hasFailed() const { return failed; }
+
+private:
+    void flushRange();
+    size_t copyFromSource(size_t offset, size_t size);
+    bool writeFromMemory(const char* data, size_t size);
+
+    int outputFd = -1;
+    int sourceFd = -1;
+
+    bool copyFileRangeSupported = true;
+    bool sendfileSupported = true;
+
+    size_t rangeOffset = 0;
+    size_t rangeSize = 0;
+    // stays valid until the range is flushed, the source file is mapped for the whole scan
+    const char* rangeData = nullptr;
+
+    // the bytes of the results when there is no source file
+    std::string buffered;
+
+    // set by the first short copy or write
+    std::atomic<bool> failed{false};
+};
@@ -0,0 +1,60 @@
+#include "CApi.h"
+
+#include <exception>
+
+#include "CompiledStructure.h"
+#include "StructureParser.h"
+
+struct walker_structure {
+    std::shared_ptr<CompiledStructure> structure;
+};
+
+walker_structure* walker_structure_from_json(const char* json) {
+    if (json == nullptr) return nullptr;
+
+    try {
+        auto structure = std::make_shared<CompiledStructure>(StructureParser::parseString(json));
+        if (structure->isEmpty()) return nullptr;
+
+        return new walker_structure{ structure };
+    } catch (const std::exception& e) {
+        return nullptr;
+    }
+}
+
+walker_structure* walker_structure_from_file(const char* path) {
+    if (path == nullptr) return nullptr;
+
+    try {
+        std::shared_ptr<CompiledStructure> structure = StructureParser{path}.compile();
+        if (structure->isEmpty()) return nullptr;
+
+        return new walker_structure{ structure };
+    } catch (const std::exception& e) {
+        return nullptr;
+    }
+}
+
+void walker_structure_free(walker_structure* structure) {
+    delete structure;
+}
+
+uint64_t walker_structure_size(const walker_structure* structure) {
+    if (structure == nullptr) return 0;
+    return structure->structure->getSize();
+}
+
+int64_t walker_scan(const walker_structure* structure, const uint8_t* data, size_t size, walker_result_callback callback, void* user) {
+    if (structure == nullptr || callback == nullptr) return -1;
+    if (data == nullptr && size > 0) return -1;
+
+    try {
+        CallbackSink sink{[callback, user](const ScannerResult& result) {
+            return callback(result.offset, result.valueSize, (const uint8_t*) result.value, user) != 0;
+        }};
+
+        return (int64_t) structure->structure->scan((const char*) data, size, sink);
+    } catch (const std::exception& e) {
+        return -1;
+    }
+}
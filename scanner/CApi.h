@@ -0,0 +1,32 @@
+#ifndef WALKER_CAPI_H
+#define WALKER_CAPI_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Opaque compiled structure, reusable across any number of scans and threads
+typedef struct walker_structure walker_structure;
+
+// Called for every result in increasing offset order, return 0 to stop the scan
+typedef int (*walker_result_callback)(uint64_t offset, uint64_t size, const uint8_t* value, void* user);
+
+// Compile a structure from a JSON definition (string or file), returns NULL on error
+walker_structure* walker_structure_from_json(const char* json);
+walker_structure* walker_structure_from_file(const char* path);
+void walker_structure_free(walker_structure* structure);
+
+uint64_t walker_structure_size(const walker_structure* structure);
+
+// Scan the caller's memory in place, nothing is copied.
+// Returns the number of results reported to the callback, or -1 on error.
+int64_t walker_scan(const walker_structure* structure, const uint8_t* data, size_t size, walker_result_callback callback, void* user);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //WALKER_CAPI_H
@@ -0,0 +1,113 @@
+#include "CompiledStructure.h"
+
+#include <algorithm>
+
+CompiledStructure::CompiledStructure(std::vector<ScannerField> fields) : fields(std::move(fields)), layout(this->fields) {}
+
+CompiledStructure::~CompiledStructure() {
+    for (ScannerField& field : fields) {
+        for (ScannerCriteria& criteria : field.criterias) {
+            ScanUtils::freePrimitiveValue(criteria.value, field.primitive);
+            criteria.value = nullptr;
+        }
+    }
+}
+
+std::shared_ptr<CompiledStructure> CompiledStructure::copyOf(const std::vector<ScannerField>& fields) {
+    std::vector<ScannerField> copies = fields;
+
+    for (ScannerField& field : copies) {
+        for (ScannerCriteria& criteria : field.criterias) {
+            criteria.value = ScanUtils::clonePrimitiveValue(criteria.value, field.primitive);
+        }
+    }
+
+    return std::make_shared<CompiledStructure>(std::move(copies));
+}
+
+void ScanCounters::resize(size_t criteriaCount) {
+    evaluated.resize(criteriaCount);
+    rejected.resize(criteriaCount);
+}
+
+void ScanCounters::merge(const ScanCounters& other) {
+    resize(std::max(evaluated.size(), other.evaluated.size()));
+
+    for (size_t i = 0; i < other.evaluated.size(); i++) {
+        evaluated[i] += other.evaluated[i];
+        rejected[i] += other.rejected[i];
+    }
+}
+
+size_t CompiledStructure::getCriteriaCount() const {
+    size_t count = 0;
+    for (const ScannerField& field : fields) count += field.criterias.size();
+    return count;
+}
+
+bool CompiledStructure::matches(const char* data) const {
+    for (size_t i = 0; i < fields.size(); i++) {
+        if (!ScanUtils::matchesField((void*) (data + layout.getFieldOffset(i)), fields[i])) return false;
+    }
+
+    return true;
+}
+
+size_t CompiledStructure::scan(const char* data, size_t size, ResultSink& sink) const {
+    size_t count = 0;
+    size_t structureSize = getSize();
+
+    if (data == nullptr) return count;
+    if (fields.empty()) return count;
+    if (structureSize > size) return count;
+
+    for (size_t i = 0; i <= size - structureSize; i++) {
+        if (matches(data + i)) {
+            count++;
+            if (!sink.push(ScannerResult{ structureSize, i, (void*) (data + i) })) break;
+        }
+    }
+
+    return count;
+}
+
+bool CompiledStructure::matches(const char* data, ScanCounters& counters) const {
+    size_t index = 0;
+
+    for (size_t i = 0; i < fields.size(); i++) {
+        void* fieldData = (void*) (data + layout.getFieldOffset(i));
+
+        for (const ScannerCriteria& criteria : fields[i].criterias) {
+            counters.evaluated[index]++;
+
+            if (!ScanUtils::matchesCriteria(fieldData, criteria, fields[i].primitive, fields[i].size)) {
+                counters.rejected[index]++;
+                return false;
+            }
+
+            index++;
+        }
+    }
+
+    return true;
+}
+
+size_t CompiledStructure::scan(const char* data, size_t size, ResultSink& sink, ScanCounters& counters) const {
+    size_t count = 0;
+    size_t structureSize = getSize();
+
+    if (data == nullptr) return count;
+    if (fields.empty()) return count;
+    if (structureSize > size) return count;
+
+    counters.resize(getCriteriaCount());
+
+    for (size_t i = 0; i <= size - structureSize; i++) {
+        if (matches(data + i, counters)) {
+            count++;
+            if (!sink.push(ScannerResult{ structureSize, i, (void*) (data + i) })) break;
+        }
+    }
+
+    return count;
+}
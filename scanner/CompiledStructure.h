@@ -0,0 +1,54 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ScanUtils.h"
+#include "StructureLayout.h"
+#include "ResultSink.h"
+
+// How many times each criteria was tested and how many times it rejected the offset, criteria are
+// numbered in field order. Every thread fills its own counters, they are merged once its chunk is done.
+struct ScanCounters {
+    std::vector<uint64_t> evaluated;
+    std::vector<uint64_t> rejected;
+
+    void resize(size_t criteriaCount);
+    void merge(const ScanCounters& other);
+};
+
+// A parsed structure ready to be matched against any number of buffers.
+// It owns the criteria values of its fields and never modifies them, so a single instance can be
+// shared between threads and scans.
+class CompiledStructure {
+public:
+    // takes ownership of the criteria values of the given fields
+    explicit CompiledStructure(std::vector<ScannerField> fields);
+    ~CompiledStructure();
+
+    CompiledStructure(const CompiledStructure&) = delete;
+    CompiledStructure& operator=(const CompiledStructure&) = delete;
+
+    // builds a structure from fields whose criteria values stay owned by the caller
+    static std::shared_ptr<CompiledStructure> copyOf(const std::vector<ScannerField>& fields);
+
+    const std::vector<ScannerField>& getFields() const { return fields; }
+    const StructureLayout& getLayout() const { return layout; }
+    size_t getSize() const { return layout.getStructureSize(); }
+    bool isEmpty() const { return fields.empty(); }
+
+    size_t getCriteriaCount() const;
+
+    bool matches(const char* data) const;
+    // same as matches, counting the criteria tested and the one that rejected the offset
+    bool matches(const char* data, ScanCounters& counters) const;
+
+    // scans a non-owning view, reported offsets are relative to data
+    size_t scan(const char* data, size_t size, ResultSink& sink) const;
+    size_t scan(const char* data, size_t size, ResultSink& sink, ScanCounters& counters) const;
+
+private:
+    std::vector<ScannerField> fields;
+    StructureLayout layout;
+};
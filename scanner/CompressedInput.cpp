@@ -0,0 +1,619 @@
+#include "CompressedInput.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "ScanTrace.h"
+
+#ifdef WALKER_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef WALKER_HAVE_LZ4
+#include <lz4.h>
+#endif
+
+#ifdef WALKER_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+// larger frames are streamed rather than decompressed to memory as a whole
+static constexpr uint64_t MAX_PARALLEL_BLOCK_SIZE = 64 * 1024 * 1024;
+static constexpr size_t STREAM_BUFFER_SIZE = 1024 * 1024;
+static constexpr size_t LZ4_HISTORY_SIZE = 64 * 1024;
+
+static constexpr uint32_t ZSTD_FRAME_MAGIC = 0xFD2FB528;
+static constexpr uint32_t LZ4_FRAME_MAGIC = 0x184D2204;
+static constexpr uint32_t SKIPPABLE_FRAME_MAGIC = 0x184D2A50;
+static constexpr uint32_t SEEK_TABLE_FRAME_MAGIC = 0x184D2A5E;
+static constexpr uint32_t SEEKABLE_MAGIC = 0x8F92EAB1;
+
+static uint32_t readLittle32(const uint8_t* bytes) {
+    return (uint32_t) bytes[0] | (uint32_t) bytes[1] << 8 | (uint32_t) bytes[2] << 16 | (uint32_t) bytes[3] << 24;
+}
+
+CompressedInput::CompressedInput(const uint8_t* data, size_t size, ThreadPool* pool)
+    : data(data), size(size), pool(pool), format(detect(data, size)) {}
+
+CompressedFormat CompressedInput::detect(const uint8_t* data, size_t size) {
+    if (size >= 18 && data[0] == 0x1F && data[1] == 0x8B && data[2] == 8) return COMPRESSED_FORMAT_GZIP;
+    if (size >= 4 && readLittle32(data) == ZSTD_FRAME_MAGIC) return COMPRESSED_FORMAT_ZSTD;
+    if (size >= 4 && readLittle32(data) == LZ4_FRAME_MAGIC) return COMPRESSED_FORMAT_LZ4;
+
+    return COMPRESSED_FORMAT_NONE;
+}
+
+bool CompressedInput::isSupported(CompressedFormat format) {
+    switch (format) {
+#ifdef WALKER_HAVE_ZLIB
+        case COMPRESSED_FORMAT_GZIP:
+            return true;
+#endif
+#ifdef WALKER_HAVE_ZSTD
+        case COMPRESSED_FORMAT_ZSTD:
+            return true;
+#endif
+#ifdef WALKER_HAVE_LZ4
+        case COMPRESSED_FORMAT_LZ4:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+std::string CompressedInput::getFormatName(CompressedFormat format) {
+    for (const auto& i : COMPRESSED_FORMAT_DETAILS) {
+        if (std::get<CompressedFormat>(i) == format) {
+            return std::get<std::string>(i);
+        }
+    }
+
+    return "none";
+}
+
+bool CompressedInput::read(const DataCallback& onData) {
+    position = 0;
+
+    if (!isSupported(format)) return false;
+
+    blocks.clear();
+    lz4BlockSize = 0;
+    truncated = false;
+    independent = split();
+
+    return independent ? readParallel(onData) : readSequential(onData);
+}
+
+bool CompressedInput::split() {
+    switch (format) {
+        case COMPRESSED_FORMAT_GZIP:
+            return splitGzip();
+        case COMPRESSED_FORMAT_ZSTD:
+            return splitZstd();
+        case COMPRESSED_FORMAT_LZ4:
+            return splitLz4();
+        default:
+            return false;
+    }
+}
+
+// BGZF files are gzip members that store their own size in a "BC" extra field, plain gzip files
+// are a single stream that can only be decompressed from its start
+bool CompressedInput::splitGzip() {
+    size_t offset = 0;
+
+    while (offset < size) {
+        const uint8_t* member = data + offset;
+        size_t available = size - offset;
+
+        if (available < 18 || member[0] != 0x1F || member[1] != 0x8B || member[2] != 8 || (member[3] & 4) == 0) return false;
+
+        size_t extraEnd = 12 + (member[10] | member[11] << 8);
+        uint64_t memberSize = 0;
+
+        if (extraEnd > available) return false;
+
+        for (size_t i = 12; i + 4 <= extraEnd; i += 4 + (member[i + 2] | member[i + 3] << 8)) {
+            if (member[i] == 'B' && member[i + 1] == 'C' && i + 6 <= extraEnd) {
+                memberSize = (uint64_t) (member[i + 4] | member[i + 5] << 8) + 1;
+            }
+        }
+
+        if (memberSize < extraEnd + 8 || memberSize > available) return false;
+
+        blocks.push_back(Block{ offset, memberSize, readLittle32(member + memberSize - 4), false, false });
+        offset += memberSize;
+    }
+
+    return blocks.size() > 1;
+}
+
+// every zstd frame is independent, the seekable format is a series of small frames followed by a
+// skippable frame holding the seek table, which gives the decompressed size of frames that do not
+bool CompressedInput::splitZstd() {
+#ifdef WALKER_HAVE_ZSTD
+    std::vector<std::pair<uint64_t, uint64_t>> seekTable = readSeekTable();
+    size_t offset = 0;
+
+    while (offset < size) {
+        size_t frameSize = ZSTD_findFrameCompressedSize(data + offset, size - offset);
+        if (ZSTD_isError(frameSize)) return false;
+
+        if ((readLittle32(data + offset) & 0xFFFFFFF0) != SKIPPABLE_FRAME_MAGIC) {
+            unsigned long long contentSize = ZSTD_getFrameContentSize(data + offset, size - offset);
+
+            if (contentSize == ZSTD_CONTENTSIZE_UNKNOWN) {
+                auto entry = std::lower_bound(seekTable.begin(), seekTable.end(), std::make_pair((uint64_t) offset, (uint64_t) 0));
+                if (entry != seekTable.end() && entry->first == offset) contentSize = entry->second;
+            }
+
+            if (contentSize == ZSTD_CONTENTSIZE_ERROR || contentSize == ZSTD_CONTENTSIZE_UNKNOWN) return false;
+            if (contentSize > MAX_PARALLEL_BLOCK_SIZE) return false;
+
+            blocks.push_back(Block{ offset, frameSize, contentSize, false, false });
+        }
+
+        offset += frameSize;
+    }
+
+    return blocks.size() > 1;
+#else
+    return false;
+#endif
+}
+
+// the seek table ends the file: a skippable frame holding the compressed and decompressed size of
+// every frame (and their checksum when flagged), then the frame count, a descriptor and a magic
+std::vector<std::pair<uint64_t, uint64_t>> CompressedInput::readSeekTable() const {
+    std::vector<std::pair<uint64_t, uint64_t>> frames;
+    if (size < 17 || readLittle32(data + size - 4) != SEEKABLE_MAGIC) return frames;
+
+    uint64_t frameCount = readLittle32(data + size - 9);
+    uint64_t entrySize = (data[size - 5] & 0x80) != 0 ? 12 : 8;
+    uint64_t tableSize = frameCount * entrySize + 9;
+
+    if (tableSize + 8 > size) return frames;
+
+    const uint8_t* frame = data + size - tableSize - 8;
+    if (readLittle32(frame) != SEEK_TABLE_FRAME_MAGIC || readLittle32(frame + 4) != tableSize) return frames;
+
+    uint64_t offset = 0;
+
+    for (uint64_t i = 0; i < frameCount; i++) {
+        const uint8_t* entry = frame + 8 + i * entrySize;
+
+        frames.emplace_back(offset, readLittle32(entry + 4));
+        offset += readLittle32(entry);
+    }
+
+    // a table that does not add up to the frames before it belongs to something else
+    if (offset != size - tableSize - 8) frames.clear();
+
+    return frames;
+}
+
+// LZ4 frames are parsed down to their blocks, which can be decompressed in parallel when the
+// frame flags them as independent
+bool CompressedInput::splitLz4() {
+    size_t offset = 0;
+    bool allIndependent = true;
+
+    // the blocks parsed before the damage are still streamed, the file is then reported as corrupt
+    auto fail = [this] {
+        truncated = true;
+        return false;
+    };
+
+    while (offset < size) {
+        if (size - offset < 8) return fail();
+
+        uint32_t magic = readLittle32(data + offset);
+
+        if ((magic & 0xFFFFFFF0) == SKIPPABLE_FRAME_MAGIC) {
+            uint64_t frameSize = 8 + (uint64_t) readLittle32(data + offset + 4);
+            if (frameSize > size - offset) return fail();
+
+            offset += frameSize;
+            continue;
+        }
+
+        uint8_t flags = data[offset + 4];
+        uint8_t descriptor = data[offset + 5];
+
+        // dictionaries are not supported
+        if (magic != LZ4_FRAME_MAGIC || (flags >> 6) != 1 || (flags & 1) != 0) return fail();
+
+        bool blockChecksum = (flags & 0x10) != 0;
+        bool contentChecksum = (flags & 0x04) != 0;
+        size_t position = offset + 7 + ((flags & 0x08) != 0 ? 8 : 0);
+        bool frameStart = true;
+
+        allIndependent = allIndependent && (flags & 0x20) != 0;
+        lz4BlockSize = std::max(lz4BlockSize, (size_t) 1 << (8 + 2 * ((descriptor >> 4) & 7)));
+
+        while (true) {
+            if (position + 4 > size) return fail();
+
+            uint32_t blockSize = readLittle32(data + position);
+            position += 4;
+
+            if (blockSize == 0) break;
+
+            bool stored = (blockSize & 0x80000000) != 0;
+            blockSize &= 0x7FFFFFFF;
+
+            if (blockSize > size - position) return fail();
+
+            blocks.push_back(Block{ position, blockSize, stored ? blockSize : 0, stored, frameStart });
+            position += blockSize + (blockChecksum ? 4 : 0);
+            frameStart = false;
+        }
+
+        position += contentChecksum ? 4 : 0;
+        if (position > size) return fail();
+
+        offset = position;
+    }
+
+    return allIndependent && blocks.size() > 1;
+}
+
+// the cases are those of the libraries this build has, possibly none
+bool CompressedInput::decompressBlock([[maybe_unused]] const Block& block, std::vector<char>& output) const {
+    [[maybe_unused]] size_t start = output.size();
+
+    switch (format) {
+#ifdef WALKER_HAVE_ZLIB
+        case COMPRESSED_FORMAT_GZIP: {
+            if (block.decompressedSize == 0) return true;
+
+            z_stream stream{};
+            if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK) return false;
+
+            output.resize(start + block.decompressedSize);
+            stream.next_in = (Bytef*) data + block.offset;
+            stream.avail_in = (uInt) block.size;
+            stream.next_out = (Bytef*) output.data() + start;
+            stream.avail_out = (uInt) block.decompressedSize;
+
+            int status = inflate(&stream, Z_FINISH);
+            inflateEnd(&stream);
+
+            return status == Z_STREAM_END && stream.avail_out == 0;
+        }
+#endif
+#ifdef WALKER_HAVE_ZSTD
+        case COMPRESSED_FORMAT_ZSTD: {
+            output.resize(start + block.decompressedSize);
+
+            size_t length = ZSTD_decompress(output.data() + start, block.decompressedSize, data + block.offset, block.size);
+            return !ZSTD_isError(length) && length == block.decompressedSize;
+        }
+#endif
+#ifdef WALKER_HAVE_LZ4
+        case COMPRESSED_FORMAT_LZ4: {
+            if (block.stored) {
+                output.insert(output.end(), (const char*) data + block.offset, (const char*) data + block.offset + block.size);
+                return true;
+            }
+
+            output.resize(start + lz4BlockSize);
+
+            int length = LZ4_decompress_safe((const char*) data + block.offset, output.data() + start, (int) block.size, (int) lz4BlockSize);
+            if (length < 0) return false;
+
+            output.resize(start + length);
+            return true;
+        }
+#endif
+        default:
+            return false;
+    }
+}
+
+bool CompressedInput::readParallel(const DataCallback& onData) {
+    struct Batch {
+        size_t first;
+        size_t last;
+        std::vector<char> output;
+        bool valid = true;
+        std::future<void> done;
+    };
+
+    // a few batches are decompressed ahead of the one handed to the callback
+    size_t ahead = pool != nullptr ? std::max<size_t>(2, pool->getThreadCount() * 2) : 1;
+    std::deque<std::unique_ptr<Batch>> pending;
+    size_t next = 0;
+    bool valid = true;
+
+    auto submit = [&] {
+        auto batch = std::make_unique<Batch>();
+        uint64_t batchSize = 0;
+
+        batch->first = next;
+
+        while (next < blocks.size() && batchSize < PIECE_SIZE) {
+            batchSize += blocks[next].decompressedSize > 0 ? blocks[next].decompressedSize : lz4BlockSize;
+            next++;
+        }
+
+        batch->last = next;
+
+        Batch* task = batch.get();
+        auto decompress = [this, task] {
+            TraceSpan span{"chunk read", "read", blocks[task->first].offset};
+
+            for (size_t i = task->first; i < task->last && task->valid; i++) {
+                task->valid = decompressBlock(blocks[i], task->output);
+            }
+
+            span.setBytes(task->output.size());
+        };
+
+        if (pool != nullptr) {
+            batch->done = pool->submit(decompress);
+        } else {
+            decompress();
+        }
+
+        pending.push_back(std::move(batch));
+    };
+
+    while (valid && (next < blocks.size() || !pending.empty())) {
+        while (next < blocks.size() && pending.size() < ahead) submit();
+
+        std::unique_ptr<Batch> batch = std::move(pending.front());
+        pending.pop_front();
+
+        if (batch->done.valid()) batch->done.get();
+
+        valid = batch->valid;
+        if (!valid) break;
+
+        position += batch->output.size();
+        if (!batch->output.empty() && !onData(batch->output.data(), batch->output.size())) break;
+    }
+
+    // the batches still running write into memory owned here
+    for (auto& batch : pending) {
+        if (batch->done.valid()) batch->done.wait();
+    }
+
+    return valid;
+}
+
+// a single thread decompresses the stream while the callback works on the previous piece
+bool CompressedInput::readSequential(const DataCallback& onData) {
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<std::vector<char>> ready;
+    bool finished = false, stopping = false, valid = true;
+
+    auto handOff = [&](std::vector<char>& piece) {
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [&] { return stopping || ready.size() < 2; });
+
+        if (stopping) return false;
+
+        ready.push_back(std::move(piece));
+        piece = {};
+        condition.notify_all();
+
+        return true;
+    };
+
+    std::thread producer([&] {
+        std::vector<char> piece;
+        uint64_t pieceOffset = 0;
+        auto pieceStart = std::chrono::steady_clock::now();
+
+        // each piece is a span, from its first decompressed byte to its hand off
+        auto finishPiece = [&] {
+            ScanTrace::span("chunk read", "read", pieceStart, pieceOffset, piece.size());
+            pieceOffset += piece.size();
+            pieceStart = std::chrono::steady_clock::now();
+        };
+
+        bool success = stream([&](const char* bytes, size_t count) {
+            while (count > 0) {
+                if (piece.capacity() < PIECE_SIZE) piece.reserve(PIECE_SIZE);
+
+                size_t length = std::min(count, PIECE_SIZE - piece.size());
+                piece.insert(piece.end(), bytes, bytes + length);
+                bytes += length;
+                count -= length;
+
+                if (piece.size() < PIECE_SIZE) continue;
+
+                finishPiece();
+                if (!handOff(piece)) return false;
+            }
+
+            return true;
+        });
+
+        // the bytes decompressed before an error are still scanned
+        if (!piece.empty()) {
+            finishPiece();
+            handOff(piece);
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        valid = success || stopping;
+        finished = true;
+        condition.notify_all();
+    });
+
+    while (true) {
+        std::vector<char> piece;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [&] { return finished || !ready.empty(); });
+
+            if (ready.empty()) break;
+
+            piece = std::move(ready.front());
+            ready.pop_front();
+            condition.notify_all();
+        }
+
+        position += piece.size();
+
+        if (!onData(piece.data(), piece.size())) {
+            std::unique_lock<std::mutex> lock(mutex);
+            stopping = true;
+            condition.notify_all();
+            break;
+        }
+    }
+
+    producer.join();
+
+    return valid;
+}
+
+bool CompressedInput::stream(const DataCallback& onData) const {
+    switch (format) {
+        case COMPRESSED_FORMAT_GZIP:
+            return streamGzip(onData);
+        case COMPRESSED_FORMAT_ZSTD:
+            return streamZstd(onData);
+        case COMPRESSED_FORMAT_LZ4:
+            return streamLz4(onData);
+        default:
+            return false;
+    }
+}
+
+bool CompressedInput::streamGzip(const DataCallback& onData) const {
+#ifdef WALKER_HAVE_ZLIB
+    z_stream stream{};
+    if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK) return false;
+
+    std::vector<char> buffer(STREAM_BUFFER_SIZE);
+    const uint8_t* input = data;
+    size_t remaining = size;
+    bool success = true;
+
+    while (true) {
+        // avail_in is 32 bits wide
+        if (stream.avail_in == 0 && remaining > 0) {
+            size_t length = std::min<size_t>(remaining, 1 << 30);
+
+            stream.next_in = (Bytef*) input;
+            stream.avail_in = (uInt) length;
+            input += length;
+            remaining -= length;
+        }
+
+        stream.next_out = (Bytef*) buffer.data();
+        stream.avail_out = (uInt) buffer.size();
+
+        int status = inflate(&stream, Z_NO_FLUSH);
+        size_t produced = buffer.size() - stream.avail_out;
+
+        if (status != Z_OK && status != Z_STREAM_END && status != Z_BUF_ERROR) {
+            success = false;
+            break;
+        }
+
+        if (produced > 0 && !onData(buffer.data(), produced)) {
+            success = false;
+            break;
+        }
+
+        if (status == Z_STREAM_END) {
+            // concatenated members are decompressed one after the other, trailing garbage is ignored
+            if (stream.avail_in == 0 && remaining == 0) break;
+            if (stream.avail_in > 0 && stream.next_in[0] != 0x1F) break;
+
+            inflateReset(&stream);
+        } else if (produced == 0 && stream.avail_in == 0 && remaining == 0) {
+            // truncated stream
+            success = false;
+            break;
+        }
+    }
+
+    inflateEnd(&stream);
+    return success;
+#else
+    (void) onData;
+    return false;
+#endif
+}
+
+bool CompressedInput::streamZstd(const DataCallback& onData) const {
+#ifdef WALKER_HAVE_ZSTD
+    ZSTD_DStream* stream = ZSTD_createDStream();
+    if (stream == nullptr) return false;
+
+    ZSTD_initDStream(stream);
+
+    std::vector<char> buffer(ZSTD_DStreamOutSize());
+    ZSTD_inBuffer input{ data, size, 0 };
+    size_t status = 0;
+    bool success = true, more = true;
+
+    while (more) {
+        ZSTD_outBuffer output{ buffer.data(), buffer.size(), 0 };
+        status = ZSTD_decompressStream(stream, &output, &input);
+
+        if (ZSTD_isError(status) || (output.pos > 0 && !onData(buffer.data(), output.pos))) {
+            success = false;
+            break;
+        }
+
+        more = input.pos < input.size || output.pos == output.size;
+    }
+
+    ZSTD_freeDStream(stream);
+
+    // a non zero status means the last frame is incomplete
+    return success && status == 0;
+#else
+    (void) onData;
+    return false;
+#endif
+}
+
+// blocks that depend on the previous ones get the last 64 KiB of the frame as dictionary
+bool CompressedInput::streamLz4(const DataCallback& onData) const {
+#ifdef WALKER_HAVE_LZ4
+    if (lz4BlockSize == 0) return false;
+
+    std::vector<char> history;
+    std::vector<char> buffer(lz4BlockSize);
+
+    for (const Block& block : blocks) {
+        const char* source = (const char*) data + block.offset;
+        int length = (int) block.size;
+
+        if (block.frameStart) history.clear();
+
+        if (!block.stored) {
+            length = LZ4_decompress_safe_usingDict(source, buffer.data(), (int) block.size, (int) buffer.size(), history.data(), (int) history.size());
+            if (length < 0) return false;
+
+            source = buffer.data();
+        }
+
+        if (!onData(source, (size_t) length)) return false;
+
+        history.insert(history.end(), source, source + length);
+        if (history.size() > LZ4_HISTORY_SIZE) history.erase(history.begin(), history.end() - LZ4_HISTORY_SIZE);
+    }
+
+    return !truncated;
+#else
+    (void) onData;
+    return false;
+#endif
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "ThreadPool.h"
+
+typedef enum {
+    COMPRESSED_FORMAT_NONE,
+    COMPRESSED_FORMAT_GZIP,
+    COMPRESSED_FORMAT_ZSTD,
+    COMPRESSED_FORMAT_LZ4
+} CompressedFormat;
+
+// Details about each compressed format
+// { format, name }
+const std::vector<std::tuple<CompressedFormat, std::string>> COMPRESSED_FORMAT_DETAILS = {
+    { COMPRESSED_FORMAT_GZIP, "gzip" },
+    { COMPRESSED_FORMAT_ZSTD, "zstd" },
+    { COMPRESSED_FORMAT_LZ4, "lz4" }
+};
+
+// Decompresses a compressed dump in order, without writing it to disk.
+//
+// Inputs made of independent blocks are decompressed in parallel, a few blocks ahead of the
+// consumer: BGZF gzip files (members announcing their size), zstd files (every frame, which covers
+// the seekable format, whose seek table gives the sizes frames may leave out) and LZ4 frames with
+// independent blocks. Other gzip and LZ4 files are decompressed by a single thread, while the
+// consumer works on the previous piece.
+class CompressedInput {
+public:
+    // size of the pieces handed to the consumer for sequential inputs, and of the parallel batches
+    static constexpr size_t PIECE_SIZE = 4 * 1024 * 1024;
+
+    // receives the next decompressed bytes, returns false to stop reading
+    typedef std::function<bool(const char* data, size_t size)> DataCallback;
+
+    CompressedInput(const uint8_t* data, size_t size, ThreadPool* pool);
+
+    static CompressedFormat detect(const uint8_t* data, size_t size);
+    static bool isSupported(CompressedFormat format);
+    static std::string getFormatName(CompressedFormat format);
+
+    // false when the input is corrupt or truncated, not when the callback stopped the reading
+    bool read(const DataCallback& onData);
+
+    CompressedFormat getFormat() const { return format; }
+    bool isParallel() const { return independent; }
+    uint64_t getPosition() const { return position; }
+
+private:
+    struct Block {
+        uint64_t offset;
+        uint64_t size;
+        // 0 when the frame does not say
+        uint64_t decompressedSize;
+        // LZ4 blocks kept uncompressed, and the first block of each LZ4 frame
+        bool stored;
+        bool frameStart;
+    };
+
+    bool split();
+    bool splitGzip();
+    bool splitZstd();
+    bool splitLz4();
+    // (offset, decompressed size) of every frame listed by a zstd seek table, empty without one
+    std::vector<std::pair<uint64_t, uint64_t>> readSeekTable() const;
+
+    bool decompressBlock(const Block& block, std::vector<char>& output) const;
+
+    bool readParallel(const DataCallback& onData);
+    bool readSequential(const DataCallback& onData);
+
+    bool stream(const DataCallback& onData) const;
+    bool streamGzip(const DataCallback& onData) const;
+    bool streamZstd(const DataCallback& onData) const;
+    bool streamLz4(const DataCallback& onData) const;
+
+    const uint8_t* data;
+    size_t size;
+    ThreadPool* pool;
+
+    CompressedFormat format;
+    std::vector<Block> blocks;
+    bool independent = false;
+    size_t lz4BlockSize = 0;
+    // the LZ4 file could only be parsed up to a damaged or missing part, blocks holds what precedes
+    bool truncated = false;
+
+    uint64_t position = 0;
+};
@@ -0,0 +1,107 @@
+#include "FileFollower.h"
+
+#include <cerrno>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+FileFollower::FileFollower(std::string path) : path(std::move(path)) {}
+
+FileFollower::~FileFollower() {
+    if (fd >= 0) close(fd);
+    if (inotifyFd >= 0) close(inotifyFd);
+    if (stopFd >= 0) close(stopFd);
+}
+
+bool FileFollower::open() {
+    fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    inotifyFd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    stopFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (inotifyFd < 0 || stopFd < 0) return false;
+
+    if (inotify_add_watch(inotifyFd, path.c_str(), IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF) < 0) return false;
+
+    buffer = std::make_unique<char[]>(READ_SIZE);
+    return true;
+}
+
+void FileFollower::stop() {
+    // only async-signal-safe calls here
+    uint64_t one = 1;
+    if (stopFd >= 0) (void) !::write(stopFd, &one, sizeof(one));
+}
+
+bool FileFollower::readAvailable(const DataCallback& onData, bool& keepGoing) {
+    while (keepGoing) {
+        ssize_t bytesRead = pread(fd, buffer.get(), READ_SIZE, (off_t) position);
+
+        if (bytesRead < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+
+        if (bytesRead == 0) break;
+
+        position += (uint64_t) bytesRead;
+        keepGoing = onData(buffer.get(), (size_t) bytesRead);
+    }
+
+    return true;
+}
+
+bool FileFollower::run(const DataCallback& onData, const std::function<void()>& onTruncate) {
+    bool keepGoing = true;
+
+    if (fd < 0) return false;
+
+    while (keepGoing) {
+        struct stat info{};
+        if (fstat(fd, &info) != 0) return false;
+
+        if ((uint64_t) info.st_size < position) {
+            position = 0;
+            onTruncate();
+        }
+
+        if (!readAvailable(onData, keepGoing)) return false;
+        if (!keepGoing) break;
+
+        // sleep until the file changes or stop() is called
+        struct pollfd fds[2] = { { inotifyFd, POLLIN, 0 }, { stopFd, POLLIN, 0 } };
+
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+
+        if (fds[1].revents & POLLIN) break;
+
+        alignas(struct inotify_event) char events[4096];
+        ssize_t length;
+        bool removed = false;
+
+        while ((length = read(inotifyFd, events, sizeof(events))) > 0) {
+            for (char* cursor = events; cursor < events + length; ) {
+                auto event = (struct inotify_event*) cursor;
+
+                if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) removed = true;
+
+                cursor += sizeof(struct inotify_event) + event->len;
+            }
+        }
+
+        // the followed file is gone, read what was written before it went away and stop
+        if (removed) {
+            readAvailable(onData, keepGoing);
+            break;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+// Reads a file as it grows. The bytes already in the file are read first, then inotify wakes the
+// follower up on every write so appended bytes are delivered within milliseconds, without polling.
+class FileFollower {
+public:
+    static constexpr size_t READ_SIZE = 1024 * 1024;
+
+    // receives the next bytes of the file, returns false to stop following
+    typedef std::function<bool(const char* data, size_t size)> DataCallback;
+
+    explicit FileFollower(std::string path);
+    ~FileFollower();
+
+    FileFollower(const FileFollower&) = delete;
+    FileFollower& operator=(const FileFollower&) = delete;
+
+    bool open();
+
+    // follows the file until the callback returns false, stop() is called, or the file is removed;
+    // onTruncate is called when the file shrinks, reading then starts over from its beginning
+    bool run(const DataCallback& onData, const std::function<void()>& onTruncate);
+
+    // can be called from another thread or a signal handler
+    void stop();
+
+private:
+    bool readAvailable(const DataCallback& onData, bool& keepGoing);
+
+    std::string path;
+    int fd = -1;
+    int inotifyFd = -1;
+    int stopFd = -1;
+
+    uint64_t position = 0;
+    std::unique_ptr<char[]> buffer;
+};
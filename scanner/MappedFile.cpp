@@ -0,0 +1,69 @@
+#include "MappedFile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static int64_t modificationTimeOf(const struct stat& info) {
+    return (int64_t) info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const std::string& filePath) {
+    close();
+
+    int fd = ::open(filePath.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat info{};
+
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        ::close(fd);
+        return false;
+    }
+
+    length = (size_t) info.st_size;
+
+    if (length > 0) {
+        void* address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (address == MAP_FAILED) {
+            ::close(fd);
+            length = 0;
+            return false;
+        }
+
+        mapping = (uint8_t*) address;
+        madvise(mapping, length, MADV_SEQUENTIAL);
+    }
+
+    // the mapping stays valid once the descriptor is closed
+    ::close(fd);
+
+    path = filePath;
+    inode = (uint64_t) info.st_ino;
+    modificationTime = modificationTimeOf(info);
+    opened = true;
+
+    return true;
+}
+
+void MappedFile::close() {
+    if (mapping != nullptr) munmap(mapping, length);
+
+    mapping = nullptr;
+    length = 0;
+    opened = false;
+}
+
+bool MappedFile::isUpToDate() const {
+    struct stat info{};
+
+    if (!opened || stat(path.c_str(), &info) != 0) return false;
+
+    return (uint64_t) info.st_ino == inode && (size_t) info.st_size == length && modificationTimeOf(info) == modificationTime;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    bool isOpen() const { return opened; }
+    const uint8_t* data() const { return mapping; }
+    size_t size() const { return length; }
+
+    const std::string& getPath() const { return path; }
+    uint64_t getInode() const { return inode; }
+    int64_t getModificationTime() const { return modificationTime; }
+
+    // true when the file on disk still has the identity recorded when it was mapped
+    bool isUpToDate() const;
+
+private:
+    std::string path;
+    uint8_t* mapping = nullptr;
+    size_t length = 0;
+    bool opened = false;
+
+    uint64_t inode = 0;
+    int64_t modificationTime = 0;
+};
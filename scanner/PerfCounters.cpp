@@ -0,0 +1,298 @@
+#include "PerfCounters.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+void PerfSample::add(const PerfSample& other) {
+    for (size_t i = 0; i < PERF_EVENT_COUNT; i++) {
+        values[i] += other.values[i];
+        available[i] = available[i] || other.available[i];
+    }
+}
+
+PerfSample PerfSample::since(const PerfSample& start) const {
+    PerfSample difference;
+
+    for (size_t i = 0; i < PERF_EVENT_COUNT; i++) {
+        difference.available[i] = available[i];
+        difference.values[i] = available[i] ? values[i] - start.values[i] : 0;
+    }
+
+    return difference;
+}
+
+static void describeEvent(PerfEvent event, perf_event_attr& attr) {
+    switch (event) {
+        case PERF_EVENT_CYCLES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case PERF_EVENT_INSTRUCTIONS:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case PERF_EVENT_BRANCHES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_BRANCH_INSTRUCTIONS;
+            break;
+        case PERF_EVENT_BRANCH_MISSES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+        case PERF_EVENT_L1D_MISSES:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        case PERF_EVENT_LLC_MISSES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            break;
+        case PERF_EVENT_DTLB_MISSES:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        case PERF_EVENT_COUNT:
+            break;
+    }
+}
+
+static std::string describeError(int error) {
+    switch (error) {
+        case EACCES:
+        case EPERM:
+            return "not allowed, see /proc/sys/kernel/perf_event_paranoid";
+        case ENOENT:
+        case EOPNOTSUPP:
+        case ENODEV:
+            return "no hardware counters on this machine";
+        case ENOSYS:
+            return "perf_event_open is not supported by the kernel";
+        default:
+            return strerror(error);
+    }
+}
+
+PerfCounters::~PerfCounters() {
+    for (ThreadCounters& thread : threads) {
+        for (int fd : thread.fds) ::close(fd);
+    }
+}
+
+bool PerfCounters::open(ThreadCounters& counters) {
+    int lastError = 0;
+
+    for (int group = 0; group < 2; group++) {
+        int leader = -1;
+        std::vector<PerfEvent> events;
+
+        for (const auto& details : PERF_EVENT_DETAILS) {
+            if (std::get<int>(details) != group) continue;
+
+            perf_event_attr attr{};
+            attr.size = sizeof(attr);
+            attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            // user space only, allowed with the default perf_event_paranoid
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            describeEvent(std::get<PerfEvent>(details), attr);
+
+            int fd = (int) syscall(SYS_perf_event_open, &attr, counters.tid, -1, leader, PERF_FLAG_FD_CLOEXEC);
+
+            if (fd < 0) {
+                lastError = errno;
+                continue;
+            }
+
+            if (leader < 0) leader = fd;
+            counters.fds.push_back(fd);
+            events.push_back(std::get<PerfEvent>(details));
+        }
+
+        if (leader >= 0) counters.groups.emplace_back(leader, events);
+    }
+
+    if (counters.groups.empty()) {
+        error = describeError(lastError);
+        return false;
+    }
+
+    return true;
+}
+
+PerfSample PerfCounters::read(const ThreadCounters& counters) const {
+    PerfSample sample;
+
+    for (const auto& group : counters.groups) {
+        // nr, time enabled, time running, then one value per event
+        uint64_t buffer[3 + PERF_EVENT_COUNT]{};
+        ssize_t length = ::read(group.first, buffer, sizeof(buffer));
+
+        if (length < (ssize_t) (3 * sizeof(uint64_t))) continue;
+
+        uint64_t count = std::min<uint64_t>(buffer[0], group.second.size());
+        uint64_t enabled = buffer[1], running = buffer[2];
+
+        // a group that never got the PMU has no value at all
+        if (running == 0) continue;
+
+        for (size_t i = 0; i < count; i++) {
+            PerfEvent event = group.second[i];
+            sample.values[event] = (double) buffer[3 + i] * enabled / running;
+            sample.available[event] = true;
+        }
+    }
+
+    return sample;
+}
+
+void PerfCounters::attachThreads() {
+    DIR* directory = opendir("/proc/self/task");
+    if (directory == nullptr) return;
+
+    while (struct dirent* entry = readdir(directory)) {
+        if (entry->d_name[0] < '0' || entry->d_name[0] > '9') continue;
+
+        auto tid = (pid_t) atoi(entry->d_name);
+        if (std::find(attempted.begin(), attempted.end(), tid) != attempted.end()) continue;
+
+        attempted.push_back(tid);
+
+        ThreadCounters counters{};
+        counters.tid = tid;
+
+        if (open(counters)) {
+            threads.push_back(std::move(counters));
+            error.clear();
+        }
+    }
+
+    closedir(directory);
+}
+
+void PerfCounters::begin(ScanPhase phase) {
+    attachThreads();
+
+    for (ThreadCounters& thread : threads) thread.atBegin[phase] = read(thread);
+}
+
+void PerfCounters::end(ScanPhase phase) {
+    for (ThreadCounters& thread : threads) thread.phases[phase].add(read(thread).since(thread.atBegin[phase]));
+}
+
+static double ratio(const PerfSample& sample, PerfEvent numerator, PerfEvent denominator) {
+    if (!sample.available[numerator] || !sample.available[denominator] || sample.values[denominator] == 0) return -1;
+    return sample.values[numerator] / sample.values[denominator];
+}
+
+static double perByte(const PerfSample& sample, PerfEvent event, uint64_t bytes) {
+    if (!sample.available[event] || bytes == 0) return -1;
+    return sample.values[event] / (double) bytes;
+}
+
+static std::string describeSample(const PerfSample& sample, uint64_t bytes) {
+    char text[64];
+    std::string line;
+
+    auto append = [&](const char* format, double value, const char* missing) {
+        if (value < 0) {
+            line += missing;
+        } else {
+            snprintf(text, sizeof(text), format, value);
+            line += text;
+        }
+    };
+
+    append("%.0f cycles", sample.available[PERF_EVENT_CYCLES] ? sample.values[PERF_EVENT_CYCLES] : -1, "cycles n/a");
+    append(", IPC %.2f", ratio(sample, PERF_EVENT_INSTRUCTIONS, PERF_EVENT_CYCLES), ", IPC n/a");
+    append(", %.2f %% branch misses", ratio(sample, PERF_EVENT_BRANCH_MISSES, PERF_EVENT_BRANCHES) * 100, ", branch misses n/a");
+    line += ", per byte:";
+    append(" %.4f L1D misses", perByte(sample, PERF_EVENT_L1D_MISSES, bytes), " L1D n/a");
+    append(", %.4f LLC misses", perByte(sample, PERF_EVENT_LLC_MISSES, bytes), ", LLC n/a");
+    append(", %.5f dTLB misses", perByte(sample, PERF_EVENT_DTLB_MISSES, bytes), ", dTLB n/a");
+
+    return line;
+}
+
+static json sampleJson(const PerfSample& sample, uint64_t bytes) {
+    json values = json::object();
+
+    for (const auto& details : PERF_EVENT_DETAILS) {
+        PerfEvent event = std::get<PerfEvent>(details);
+        if (sample.available[event]) values[std::get<std::string>(details)] = sample.values[event];
+    }
+
+    double ipc = ratio(sample, PERF_EVENT_INSTRUCTIONS, PERF_EVENT_CYCLES);
+    double branchMissRate = ratio(sample, PERF_EVENT_BRANCH_MISSES, PERF_EVENT_BRANCHES);
+
+    if (ipc >= 0) values["ipc"] = ipc;
+    if (branchMissRate >= 0) values["branch_miss_rate"] = branchMissRate;
+
+    for (auto event : { PERF_EVENT_L1D_MISSES, PERF_EVENT_LLC_MISSES, PERF_EVENT_DTLB_MISSES }) {
+        double value = perByte(sample, event, bytes);
+        if (value >= 0) values[std::get<std::string>(PERF_EVENT_DETAILS[event]) + "_per_byte"] = value;
+    }
+
+    return values;
+}
+
+void PerfCounters::print(std::ostream& out, uint64_t bytes) const {
+    if (!isAvailable()) {
+        out << "* Hardware counters are not available: " << error << "." << std::endl;
+        return;
+    }
+
+    for (const auto& details : PHASE_DETAILS) {
+        ScanPhase phase = std::get<ScanPhase>(details);
+        PerfSample total;
+        size_t busyThreads = 0;
+
+        for (const ThreadCounters& thread : threads) {
+            total.add(thread.phases[phase]);
+            if (thread.phases[phase].values[PERF_EVENT_CYCLES] > 0) busyThreads++;
+        }
+
+        if (total.values[PERF_EVENT_CYCLES] <= 0) continue;
+
+        out << "* Counters of the " << std::get<std::string>(details) << " phase: " << describeSample(total, bytes) << std::endl;
+
+        if (busyThreads < 2) continue;
+
+        for (const ThreadCounters& thread : threads) {
+            if (thread.phases[phase].values[PERF_EVENT_CYCLES] <= 0) continue;
+            out << "*   thread " << thread.tid << ": " << describeSample(thread.phases[phase], bytes) << std::endl;
+        }
+    }
+}
+
+json PerfCounters::toJson(uint64_t bytes) const {
+    if (!isAvailable()) return { { "available", false }, { "error", error } };
+
+    json phases = json::object();
+    json perThread = json::array();
+
+    for (const auto& details : PHASE_DETAILS) {
+        ScanPhase phase = std::get<ScanPhase>(details);
+        PerfSample total;
+
+        for (const ThreadCounters& thread : threads) total.add(thread.phases[phase]);
+        phases[std::get<std::string>(details)] = sampleJson(total, bytes);
+    }
+
+    for (const ThreadCounters& thread : threads) {
+        json threadPhases = json::object();
+
+        for (const auto& details : PHASE_DETAILS) {
+            threadPhases[std::get<std::string>(details)] = sampleJson(thread.phases[std::get<ScanPhase>(details)], bytes);
+        }
+
+        perThread.push_back({ { "tid", thread.tid }, { "phases", threadPhases } });
+    }
+
+    return { { "available", true }, { "phases", phases }, { "threads", perThread } };
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <sys/types.h>
+
+#include "ScanUtils.h"
+#include "ScanStatistics.h"
+
+typedef enum {
+    PERF_EVENT_CYCLES,
+    PERF_EVENT_INSTRUCTIONS,
+    PERF_EVENT_BRANCHES,
+    PERF_EVENT_BRANCH_MISSES,
+    PERF_EVENT_L1D_MISSES,
+    PERF_EVENT_LLC_MISSES,
+    PERF_EVENT_DTLB_MISSES,
+    PERF_EVENT_COUNT
+} PerfEvent;
+
+// Details about each hardware event, events of the same group are scheduled on the PMU together
+// { event, name, group }
+const std::vector<std::tuple<PerfEvent, std::string, int>> PERF_EVENT_DETAILS = {
+    { PERF_EVENT_CYCLES, "cycles", 0 },
+    { PERF_EVENT_INSTRUCTIONS, "instructions", 0 },
+    { PERF_EVENT_BRANCHES, "branches", 0 },
+    { PERF_EVENT_BRANCH_MISSES, "branch_misses", 0 },
+    { PERF_EVENT_L1D_MISSES, "l1d_misses", 1 },
+    { PERF_EVENT_LLC_MISSES, "llc_misses", 1 },
+    { PERF_EVENT_DTLB_MISSES, "dtlb_misses", 1 }
+};
+
+// Counts of each event, scaled when the PMU was shared between groups
+struct PerfSample {
+    double values[PERF_EVENT_COUNT]{};
+    bool available[PERF_EVENT_COUNT]{};
+
+    void add(const PerfSample& other);
+    PerfSample since(const PerfSample& start) const;
+};
+
+// Hardware counters of every thread of the process, read at the start and end of each scan phase.
+// The counters are opened from the outside for each thread id, the threads themselves run unchanged.
+// Events the machine or the kernel settings do not allow are left out, without counters at all
+// isAvailable() is false and getError() tells why.
+class PerfCounters {
+public:
+    PerfCounters() = default;
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    // opens counters for the threads started since the last call
+    void attachThreads();
+
+    bool isAvailable() const { return !threads.empty(); }
+    const std::string& getError() const { return error; }
+
+    void begin(ScanPhase phase);
+    void end(ScanPhase phase);
+
+    // ratios per byte use the bytes scanned
+    void print(std::ostream& out, uint64_t bytes) const;
+    json toJson(uint64_t bytes) const;
+
+private:
+    struct ThreadCounters {
+        pid_t tid;
+        std::vector<int> fds;
+        // leader of each group and the events it reads, in the order they were added
+        std::vector<std::pair<int, std::vector<PerfEvent>>> groups;
+
+        PerfSample atBegin[SCAN_PHASE_COUNT];
+        PerfSample phases[SCAN_PHASE_COUNT];
+    };
+
+    bool open(ThreadCounters& counters);
+    PerfSample read(const ThreadCounters& counters) const;
+
+    std::vector<ThreadCounters> threads;
+    std::vector<pid_t> attempted;
+    std::string error = "not started";
+};
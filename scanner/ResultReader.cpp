@@ -0,0 +1,91 @@
+#include "ResultReader.h"
+
+#include <charconv>
+#include <cstring>
+
+static constexpr size_t BINARY_HEADER_SIZE = sizeof(BINARY_RESULTS_MAGIC) + sizeof(uint32_t) + sizeof(uint64_t);
+
+bool ResultReader::open(const std::string& filename) {
+    format = RESULT_FORMAT_NONE;
+    position = 0;
+    lastOffset = 0;
+    valueSize = 0;
+
+    if (!file.open(filename)) return false;
+
+    const uint8_t* data = file.data();
+
+    if (file.size() >= BINARY_HEADER_SIZE && memcmp(data, BINARY_RESULTS_MAGIC, sizeof(BINARY_RESULTS_MAGIC)) == 0) {
+        uint32_t version;
+        uint64_t size;
+        memcpy(&version, data + sizeof(BINARY_RESULTS_MAGIC), sizeof(version));
+        memcpy(&size, data + sizeof(BINARY_RESULTS_MAGIC) + sizeof(version), sizeof(size));
+
+        if (version != BINARY_RESULTS_VERSION) return false;
+
+        format = RESULT_FORMAT_BINARY;
+        valueSize = size;
+        position = BINARY_HEADER_SIZE;
+    } else {
+        format = RESULT_FORMAT_TEXT;
+    }
+
+    return true;
+}
+
+bool ResultReader::next(uint64_t& offset) {
+    if (format == RESULT_FORMAT_BINARY) return nextBinary(offset);
+    if (format == RESULT_FORMAT_TEXT) return nextText(offset);
+
+    return false;
+}
+
+bool ResultReader::nextBinary(uint64_t& offset) {
+    const uint8_t* data = file.data();
+    uint64_t delta = 0;
+    unsigned shift = 0;
+    uint8_t byte;
+
+    if (position >= file.size()) return false;
+
+    do {
+        // a truncated or overlong varint means the file is damaged
+        if (position >= file.size() || shift > 63) return false;
+
+        byte = data[position++];
+        delta |= (uint64_t) (byte & 0x7F) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+
+    lastOffset += delta;
+    offset = lastOffset;
+
+    return true;
+}
+
+bool ResultReader::nextText(uint64_t& offset) {
+    auto data = (const char*) file.data();
+    size_t size = file.size();
+
+    while (position < size) {
+        size_t end = position;
+        while (end < size && data[end] != '\n') end++;
+
+        const char* line = data + position;
+        size_t length = end - position;
+        position = end + 1;
+
+        // watch events: added results are read, removed ones skipped
+        if (length > 0 && line[0] == '+') {
+            line++;
+            length--;
+        }
+
+        if (length > 2 && line[0] == '0' && (line[1] == 'x' || line[1] == 'X')) {
+            auto parsed = std::from_chars(line + 2, line + length, offset, 16);
+            if (parsed.ec == std::errc()) return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "MappedFile.h"
+#include "ResultWriter.h"
+
+// Reads back the offsets of a result file written in the binary or text format, or the addresses
+// added in a watch event file.
+// The format is detected from the binary header, results come out in the order they were written.
+class ResultReader {
+public:
+    bool open(const std::string& filename);
+
+    ResultFormat getFormat() const { return format; }
+    // structure size recorded by the binary format, 0 for text files
+    size_t getValueSize() const { return valueSize; }
+
+    // reads the next offset, returns false at the end of the file or on malformed data
+    bool next(uint64_t& offset);
+
+private:
+    bool nextBinary(uint64_t& offset);
+    bool nextText(uint64_t& offset);
+
+    MappedFile file;
+    ResultFormat format = RESULT_FORMAT_NONE;
+    size_t valueSize = 0;
+
+    size_t position = 0;
+    uint64_t lastOffset = 0;
+};
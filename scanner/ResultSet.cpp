@@ -0,0 +1,83 @@
+#include "ResultSet.h"
+
+ResultSet::ResultSet(size_t valueSize, const char* buffer) {
+    this->valueSize = valueSize;
+    this->buffer = buffer;
+}
+
+void ResultSet::push(size_t offset) {
+    // offsets are pushed in increasing order, so the delta always fits an unsigned varint
+    uint64_t delta = offset - lastOffset;
+
+    while (delta >= 0x80) {
+        writeByte((uint8_t) (delta | 0x80));
+        delta >>= 7;
+    }
+    writeByte((uint8_t) delta);
+
+    lastOffset = offset;
+    count++;
+}
+
+void ResultSet::clear() {
+    pages.clear();
+    pageUsed = PAGE_SIZE;
+    count = 0;
+    lastOffset = 0;
+}
+
+size_t ResultSet::memoryUsage() const {
+    return pages.size() * PAGE_SIZE + pages.capacity() * sizeof(std::unique_ptr<uint8_t[]>);
+}
+
+void ResultSet::writeByte(uint8_t byte) {
+    if (pageUsed == PAGE_SIZE) {
+        pages.emplace_back(new uint8_t[PAGE_SIZE]);
+        pageUsed = 0;
+    }
+
+    pages.back()[pageUsed++] = byte;
+}
+
+ResultSet::Iterator ResultSet::begin() const {
+    return Iterator{this, 0};
+}
+
+ResultSet::Iterator ResultSet::end() const {
+    return Iterator{this, count};
+}
+
+ResultSet::Iterator::Iterator(const ResultSet* set, size_t index) {
+    this->set = set;
+    this->index = index;
+
+    if (index < set->count) decode();
+}
+
+ScannerResult ResultSet::Iterator::operator*() const {
+    return ScannerResult{ set->valueSize, offset, (void*) (set->buffer != nullptr ? set->buffer + offset : nullptr) };
+}
+
+ResultSet::Iterator& ResultSet::Iterator::operator++() {
+    if (++index < set->count) decode();
+    return *this;
+}
+
+void ResultSet::Iterator::decode() {
+    uint64_t delta = 0;
+    unsigned shift = 0;
+    uint8_t byte;
+
+    do {
+        if (position == PAGE_SIZE) {
+            page++;
+            position = 0;
+        }
+
+        byte = set->pages[page][position++];
+        delta |= (uint64_t) (byte & 0x7F) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+
+    offset += delta;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "ScanUtils.h"
+
+// Compact, append-only container for scan results.
+// Offsets are pushed in increasing order and stored as LEB128-encoded deltas in fixed-size pages,
+// so dense hits cost ~1 byte each instead of a full ScannerResult (24 bytes), and growing the set
+// never reallocates or copies what was already stored.
+class ResultSet {
+public:
+    static constexpr size_t PAGE_SIZE = 64 * 1024;
+
+    explicit ResultSet(size_t valueSize = 0, const char* buffer = nullptr);
+
+    ResultSet(ResultSet&& other) noexcept = default;
+    ResultSet& operator=(ResultSet&& other) noexcept = default;
+
+    void push(size_t offset);
+    void clear();
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    size_t getValueSize() const { return valueSize; }
+    size_t memoryUsage() const;
+
+    class Iterator {
+    public:
+        Iterator(const ResultSet* set, size_t index);
+
+        ScannerResult operator*() const;
+        Iterator& operator++();
+        bool operator!=(const Iterator& other) const { return index != other.index; }
+
+    private:
+        void decode();
+
+        const ResultSet* set;
+        size_t index;
+        size_t page = 0;
+        size_t position = 0;
+        size_t offset = 0;
+    };
+
+    Iterator begin() const;
+    Iterator end() const;
+
+private:
+    void writeByte(uint8_t byte);
+
+    std::vector<std::unique_ptr<uint8_t[]>> pages;
+    size_t pageUsed = PAGE_SIZE;
+
+    size_t count = 0;
+    size_t lastOffset = 0;
+
+    size_t valueSize;
+    const char* buffer;
+};
@@ -0,0 +1,61 @@
+#include "ResultSink.h"
+
+bool CountingSink::push(const ScannerResult&) {
+    count++;
+    return true;
+}
+
+ResultSetSink::ResultSetSink(ResultSet& results) : results(results) {}
+
+bool ResultSetSink::push(const ScannerResult& result) {
+    results.push(result.offset);
+    return true;
+}
+
+WriterSink::WriterSink(ResultWriter& writer) : writer(writer) {}
+
+bool WriterSink::push(const ScannerResult& result) {
+    writer.write(result);
+    return true;
+}
+
+CallbackSink::CallbackSink(std::function<bool(const ScannerResult&)> callback) : callback(std::move(callback)) {}
+
+bool CallbackSink::push(const ScannerResult& result) {
+    return callback(result);
+}
+
+FieldSink::FieldSink(const std::vector<ScannerField>& fields, std::function<bool(const ScannerResult&, const std::vector<FieldView>&)> callback)
+    : layout(fields), callback(std::move(callback)) {}
+
+bool FieldSink::push(const ScannerResult& result) {
+    layout.fields(result, views);
+    return callback(result, views);
+}
+
+TeeSink::TeeSink(std::vector<ResultSink*> sinks) : sinks(std::move(sinks)) {}
+
+bool TeeSink::push(const ScannerResult& result) {
+    bool keepGoing = false;
+
+    for (ResultSink*& sink : sinks) {
+        if (sink == nullptr) continue;
+
+        if (sink->push(result)) {
+            keepGoing = true;
+        } else {
+            sink = nullptr;
+        }
+    }
+
+    return keepGoing;
+}
+
+LimitSink::LimitSink(ResultSink& next, size_t maxResults) : next(next), maxResults(maxResults) {}
+
+bool LimitSink::push(const ScannerResult& result) {
+    if (count >= maxResults) return false;
+
+    count++;
+    return next.push(result) && count < maxResults;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include "ScanUtils.h"
+#include "ResultSet.h"
+#include "ResultWriter.h"
+#include "StructureLayout.h"
+
+// Receives scan results as soon as they are found, in increasing offset order.
+// Returning false from push stops the scan.
+class ResultSink {
+public:
+    virtual ~ResultSink() = default;
+    virtual bool push(const ScannerResult& result) = 0;
+};
+
+// Only counts the results, nothing is stored
+class CountingSink : public ResultSink {
+public:
+    bool push(const ScannerResult& result) override;
+    size_t getCount() const { return count; }
+
+private:
+    size_t count = 0;
+};
+
+// Appends the results to a compact ResultSet
+class ResultSetSink : public ResultSink {
+public:
+    explicit ResultSetSink(ResultSet& results);
+    bool push(const ScannerResult& result) override;
+
+private:
+    ResultSet& results;
+};
+
+// Streams the results to a ResultWriter
+class WriterSink : public ResultSink {
+public:
+    explicit WriterSink(ResultWriter& writer);
+    bool push(const ScannerResult& result) override;
+
+private:
+    ResultWriter& writer;
+};
+
+// Forwards results to a callback
+class CallbackSink : public ResultSink {
+public:
+    explicit CallbackSink(std::function<bool(const ScannerResult&)> callback);
+    bool push(const ScannerResult& result) override;
+
+private:
+    std::function<bool(const ScannerResult&)> callback;
+};
+
+// Forwards results to a callback along with a view over every field, the field bytes are not copied
+class FieldSink : public ResultSink {
+public:
+    FieldSink(const std::vector<ScannerField>& fields, std::function<bool(const ScannerResult&, const std::vector<FieldView>&)> callback);
+    bool push(const ScannerResult& result) override;
+
+private:
+    StructureLayout layout;
+    std::vector<FieldView> views;
+    std::function<bool(const ScannerResult&, const std::vector<FieldView>&)> callback;
+};
+
+// Forwards results to several sinks, stops once all of them stopped
+class TeeSink : public ResultSink {
+public:
+    explicit TeeSink(std::vector<ResultSink*> sinks);
+    bool push(const ScannerResult& result) override;
+
+private:
+    std::vector<ResultSink*> sinks;
+};
+
+// Forwards at most maxResults results to another sink, then stops the scan
+class LimitSink : public ResultSink {
+public:
+    LimitSink(ResultSink& next, size_t maxResults);
+    bool push(const ScannerResult& result) override;
+    size_t getCount() const { return count; }
+
+private:
+    ResultSink& next;
+    size_t maxResults;
+    size_t count = 0;
+};
@@ -0,0 +1,353 @@
+#include "ResultWriter.h"
+
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "ScanTrace.h"
+
+ResultWriter::ResultWriter(const std::string& filename, ResultFormat format, const std::vector<ScannerField>& fields, bool async)
+    : format(format), layout(fields), async(async) {
+    fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    opened = fd >= 0;
+
+    output = [this](const char* data, size_t size) {
+        while (size > 0) {
+            ssize_t written = ::write(fd, data, size);
+
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+
+            data += written;
+            size -= written;
+        }
+
+        return true;
+    };
+
+    start();
+}
+
+ResultWriter::ResultWriter(ResultOutput output, ResultFormat format, const std::vector<ScannerField>& fields, bool async)
+    : opened(true), output(std::move(output)), format(format), layout(fields), async(async) {
+    start();
+}
+
+void ResultWriter::start() {
+    if (!opened) return;
+
+    pending.reserve(BUFFER_SIZE);
+    writing.reserve(BUFFER_SIZE);
+
+    if (this->async) writer = std::thread(&ResultWriter::writerLoop, this);
+
+    writeHeader();
+}
+
+ResultWriter::~ResultWriter() {
+    close();
+}
+
+bool ResultWriter::isOpen() const {
+    return opened;
+}
+
+void ResultWriter::write(const ScannerResult& result) {
+    if (!opened || failed) return;
+
+    switch (format) {
+        case RESULT_FORMAT_TEXT:
+            writeText(result);
+            break;
+        case RESULT_FORMAT_CSV:
+            writeCsv(result);
+            break;
+        case RESULT_FORMAT_JSONL:
+            writeJsonl(result);
+            break;
+        case RESULT_FORMAT_BINARY:
+            writeBinary(result);
+            break;
+        case RESULT_FORMAT_NONE:
+            return;
+    }
+
+    if (pending.size() >= BUFFER_SIZE) {
+        flush();
+    } else if (++sinceClockCheck >= clockStride) {
+        // keep slow result streams visible without reading the clock for every dense result
+        auto now = std::chrono::steady_clock::now();
+        sinceClockCheck = 0;
+
+        if (now - lastFlush >= FLUSH_INTERVAL) {
+            flush();
+            clockStride = 1;
+        } else if (clockStride < 4096) {
+            clockStride *= 2;
+        }
+    }
+}
+
+bool ResultWriter::close() {
+    if (!opened) return !failed;
+
+    flush();
+
+    if (writer.joinable()) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this] { return writing.empty(); });
+            stopping = true;
+        }
+        condition.notify_all();
+        writer.join();
+    }
+
+    // delayed write errors of some file systems are only reported by close
+    if (fd >= 0 && ::close(fd) != 0) failed = true;
+
+    fd = -1;
+    opened = false;
+    return !failed;
+}
+
+ResultFormat ResultWriter::getFormatByName(const std::string& name) {
+    for (const auto& i : FORMAT_DETAILS) {
+        if (std::get<std::string>(i) == name) {
+            return std::get<ResultFormat>(i);
+        }
+    }
+
+    return RESULT_FORMAT_NONE;
+}
+
+void ResultWriter::writeHeader() {
+    if (format == RESULT_FORMAT_CSV) {
+        pending += "offset,size";
+
+        for (size_t i = 0; i < layout.getFieldCount(); i++) {
+            pending += ",field";
+            appendDecimal(i);
+            pending += '_';
+            pending += std::get<std::string>(PRIM_DETAILS[layout.getFieldPrimitive(i)]);
+        }
+
+        pending += '\n';
+    } else if (format == RESULT_FORMAT_BINARY) {
+        uint64_t valueSize = layout.getStructureSize();
+
+        pending.append(BINARY_RESULTS_MAGIC, sizeof(BINARY_RESULTS_MAGIC));
+        pending.append((const char*) &BINARY_RESULTS_VERSION, sizeof(BINARY_RESULTS_VERSION));
+        pending.append((const char*) &valueSize, sizeof(valueSize));
+    }
+}
+
+void ResultWriter::writeText(const ScannerResult& result) {
+    pending += "0x";
+    appendHex(result.offset);
+    pending += '\n';
+}
+
+void ResultWriter::writeCsv(const ScannerResult& result) {
+    appendDecimal(result.offset);
+    pending += ',';
+    appendDecimal(result.valueSize);
+
+    for (size_t i = 0; i < layout.getFieldCount(); i++) {
+        pending += ',';
+        appendValue(pending, layout.field(result, i), false);
+    }
+
+    pending += '\n';
+}
+
+void ResultWriter::writeJsonl(const ScannerResult& result) {
+    pending += "{\"offset\":";
+    appendDecimal(result.offset);
+    pending += ",\"size\":";
+    appendDecimal(result.valueSize);
+    pending += ",\"fields\":[";
+
+    for (size_t i = 0; i < layout.getFieldCount(); i++) {
+        if (i > 0) pending += ',';
+        appendValue(pending, layout.field(result, i), true);
+    }
+
+    pending += "]}\n";
+}
+
+void ResultWriter::writeBinary(const ScannerResult& result) {
+    uint64_t delta = result.offset - lastOffset;
+
+    while (delta >= 0x80) {
+        pending += (char) (delta | 0x80);
+        delta >>= 7;
+    }
+    pending += (char) delta;
+
+    lastOffset = result.offset;
+}
+
+void ResultWriter::appendHex(uint64_t value) {
+    char digits[16];
+    auto end = std::to_chars(digits, digits + sizeof(digits), value, 16).ptr;
+    pending.append(digits, end - digits);
+}
+
+void ResultWriter::appendDecimal(uint64_t value) {
+    char digits[20];
+    auto end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+    pending.append(digits, end - digits);
+}
+
+template<typename T>
+static void appendInteger(std::string& out, T value) {
+    char digits[24];
+    auto end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+    out.append(digits, end - digits);
+}
+
+template<typename T>
+static void appendFloating(std::string& out, T value, bool json) {
+    char digits[32];
+    int length = snprintf(digits, sizeof(digits), "%.*g", std::is_same<T, float>::value ? 9 : 17, (double) value);
+
+    // JSON has no literal for nan and infinities
+    if (json && !std::isfinite(value)) {
+        out += "null";
+        return;
+    }
+
+    out.append(digits, length);
+}
+
+void ResultWriter::appendValue(std::string& out, const FieldView& view, bool json) {
+    static const char HEX_DIGITS[] = "0123456789abcdef";
+
+    if (view.data == nullptr) {
+        if (json) out += "null";
+        return;
+    }
+
+    switch (view.primitive) {
+        case SCANNER_PRIMITIVE_UINT8:
+            return appendInteger(out, view.as<uint8_t>());
+        case SCANNER_PRIMITIVE_UINT16:
+            return appendInteger(out, view.as<uint16_t>());
+        case SCANNER_PRIMITIVE_UINT32:
+            return appendInteger(out, view.as<uint32_t>());
+        case SCANNER_PRIMITIVE_UINT64:
+            return appendInteger(out, view.as<uint64_t>());
+        case SCANNER_PRIMITIVE_INT8:
+            return appendInteger(out, view.as<int8_t>());
+        case SCANNER_PRIMITIVE_INT16:
+            return appendInteger(out, view.as<int16_t>());
+        case SCANNER_PRIMITIVE_INT32:
+            return appendInteger(out, view.as<int32_t>());
+        case SCANNER_PRIMITIVE_INT64:
+            return appendInteger(out, view.as<int64_t>());
+        case SCANNER_PRIMITIVE_FLOAT:
+            return appendFloating(out, view.as<float>(), json);
+        case SCANNER_PRIMITIVE_DOUBLE:
+            return appendFloating(out, view.as<double>(), json);
+        case SCANNER_PRIMITIVE_POINTER: {
+            char digits[16];
+            auto end = std::to_chars(digits, digits + sizeof(digits), view.as<uintptr_t>(), 16).ptr;
+
+            if (json) out += '"';
+            out += "0x";
+            out.append(digits, end - digits);
+            if (json) out += '"';
+            return;
+        }
+        case SCANNER_PRIMITIVE_BYTES: {
+            if (json) out += '"';
+
+            for (size_t i = 0; i < view.size; i++) {
+                auto byte = (uint8_t) view.data[i];
+                if (i > 0) out += ' ';
+                out += HEX_DIGITS[byte >> 4];
+                out += HEX_DIGITS[byte & 0xF];
+            }
+
+            if (json) out += '"';
+            return;
+        }
+        case SCANNER_PRIMITIVE_STRING: {
+            // printable ASCII is kept as is, everything else is escaped for the target format
+            out += '"';
+
+            for (size_t i = 0; i < view.size; i++) {
+                auto c = (uint8_t) view.data[i];
+
+                if (c == '"') {
+                    out += json ? "\\\"" : "\"\"";
+                } else if (c == '\\' && json) {
+                    out += "\\\\";
+                } else if (c >= 0x20 && c < 0x7F) {
+                    out += (char) c;
+                } else {
+                    out += json ? "\\u00" : "\\x";
+                    out += HEX_DIGITS[c >> 4];
+                    out += HEX_DIGITS[c & 0xF];
+                }
+            }
+
+            out += '"';
+            return;
+        }
+        case SCANNER_PRIMITIVE_NONE:
+            break;
+    }
+}
+
+void ResultWriter::flush() {
+    lastFlush = std::chrono::steady_clock::now();
+
+    if (failed) pending.clear();
+    if (pending.empty()) return;
+
+    if (!async) {
+        timedOutput(pending);
+        pending.clear();
+        return;
+    }
+
+    // hand the filled buffer to the writer thread and keep filling the one it released
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [this] { return writing.empty(); });
+        std::swap(pending, writing);
+    }
+    condition.notify_all();
+}
+
+void ResultWriter::timedOutput(const std::string& data) {
+    if (failed) return;
+
+    TraceSpan span{"write", "write", 0, data.size()};
+    auto start = std::chrono::steady_clock::now();
+    if (!output(data.data(), data.size())) failed = true;
+    outputTime += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void ResultWriter::writerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true) {
+        condition.wait(lock, [this] { return stopping || !writing.empty(); });
+        if (writing.empty()) break;
+
+        lock.unlock();
+        timedOutput(writing);
+        lock.lock();
+
+        writing.clear();
+        condition.notify_all();
+    }
+}
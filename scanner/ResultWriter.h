@@ -0,0 +1,108 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <tuple>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <atomic>
+
+#include "ScanUtils.h"
+#include "StructureLayout.h"
+
+typedef enum {
+    RESULT_FORMAT_NONE,
+    RESULT_FORMAT_TEXT,
+    RESULT_FORMAT_CSV,
+    RESULT_FORMAT_JSONL,
+    RESULT_FORMAT_BINARY
+} ResultFormat;
+
+// Details about each output format
+// { format, name }
+const std::vector<std::tuple<ResultFormat, std::string>> FORMAT_DETAILS = {
+    { RESULT_FORMAT_TEXT, "text" },
+    { RESULT_FORMAT_CSV, "csv" },
+    { RESULT_FORMAT_JSONL, "jsonl" },
+    { RESULT_FORMAT_BINARY, "binary" }
+};
+
+// Header of the binary format, followed by the LEB128-encoded deltas between consecutive offsets
+const char BINARY_RESULTS_MAGIC[4] = { 'W', 'L', 'K', 'R' };
+const uint32_t BINARY_RESULTS_VERSION = 1;
+
+// Destination of the formatted results, returns false when the data could not be written
+typedef std::function<bool(const char* data, size_t size)> ResultOutput;
+
+class ResultWriter {
+public:
+    static constexpr size_t BUFFER_SIZE = 4 * 1024 * 1024;
+    static constexpr std::chrono::milliseconds FLUSH_INTERVAL{100};
+
+    ResultWriter(const std::string& filename, ResultFormat format, const std::vector<ScannerField>& fields, bool async = false);
+    ResultWriter(ResultOutput output, ResultFormat format, const std::vector<ScannerField>& fields, bool async = false);
+    ~ResultWriter();
+
+    bool isOpen() const;
+
+    void write(const ScannerResult& result);
+    // hands the buffered results to the output now, for results that must be visible right away
+    void flush();
+    // false when some of the results could not be written, the output is then incomplete
+    bool close();
+
+    // set by the first failed output, the results written after it are dropped
+    bool hasFailed() const { return failed; }
+
+    // time spent handing formatted results to the output, on the writer thread with async writes;
+    // read while it writes, the output in progress is not counted yet
+    std::chrono::nanoseconds getOutputTime() const { return std::chrono::nanoseconds(outputTime.load()); }
+    size_t getMemoryUsage() const { return pending.capacity() + writing.capacity(); }
+
+    static ResultFormat getFormatByName(const std::string& name);
+
+    // formats a field value as in the csv (json = false) and jsonl (json = true) formats
+    static void appendValue(std::string& out, const FieldView& view, bool json);
+
+private:
+    void writeHeader();
+    void writeText(const ScannerResult& result);
+    void writeCsv(const ScannerResult& result);
+    void writeJsonl(const ScannerResult& result);
+    void writeBinary(const ScannerResult& result);
+
+    void appendHex(uint64_t value);
+    void appendDecimal(uint64_t value);
+
+    void writerLoop();
+    void start();
+    void timedOutput(const std::string& data);
+
+    int fd = -1;
+    bool opened = false;
+    ResultOutput output;
+    ResultFormat format;
+
+    StructureLayout layout;
+
+    size_t lastOffset = 0;
+
+    // the clock is only read every clockStride writes, the stride grows while results arrive quickly
+    std::chrono::steady_clock::time_point lastFlush;
+    size_t clockStride = 1;
+    size_t sinceClockCheck = 0;
+
+    std::string pending;
+    std::string writing;
+    std::atomic<std::chrono::nanoseconds::rep> outputTime{0};
+    std::atomic<bool> failed{false};
+
+    bool async;
+    bool stopping = false;
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable condition;
+};
@@ -0,0 +1,146 @@
+#include "ScanProgress.h"
+
+#include <string>
+#include <unistd.h>
+
+void ScanProgress::add(uint64_t bytes, uint64_t results) {
+    static std::atomic<size_t> nextSlot{0};
+    thread_local size_t slotIndex = nextSlot.fetch_add(1, std::memory_order_relaxed) % SLOT_COUNT;
+
+    Slot& slot = slots[slotIndex];
+    slot.bytes.fetch_add(bytes, std::memory_order_relaxed);
+    slot.results.fetch_add(results, std::memory_order_relaxed);
+}
+
+uint64_t ScanProgress::getBytes() const {
+    uint64_t bytes = 0;
+    for (const Slot& slot : slots) bytes += slot.bytes.load(std::memory_order_relaxed);
+    return bytes;
+}
+
+uint64_t ScanProgress::getResults() const {
+    uint64_t results = 0;
+    for (const Slot& slot : slots) results += slot.results.load(std::memory_order_relaxed);
+    return results;
+}
+
+ProgressReporter::ProgressReporter(const ScanProgress& progress, ProgressFormat format, std::chrono::milliseconds interval, FILE* output)
+    : progress(progress), format(format), interval(interval.count() > 0 ? interval : std::chrono::milliseconds(1000)), output(output),
+      terminal(isatty(fileno(output)) != 0) {
+    started = std::chrono::steady_clock::now();
+    lastTime = started;
+
+    thread = std::thread([this] { run(); });
+}
+
+ProgressReporter::~ProgressReporter() {
+    stop();
+}
+
+void ProgressReporter::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping) return;
+        stopping = true;
+    }
+
+    condition.notify_all();
+    thread.join();
+
+    report(true);
+}
+
+void ProgressReporter::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (!condition.wait_for(lock, interval, [this] { return stopping; })) {
+        lock.unlock();
+        report(false);
+        lock.lock();
+    }
+}
+
+static std::string formatSize(double bytes) {
+    char text[32];
+
+    if (bytes >= 1024.0 * 1024 * 1024) {
+        snprintf(text, sizeof(text), "%.2f GiB", bytes / (1024.0 * 1024 * 1024));
+    } else {
+        snprintf(text, sizeof(text), "%.1f MiB", bytes / (1024.0 * 1024));
+    }
+
+    return text;
+}
+
+static std::string formatDuration(double seconds) {
+    char text[32];
+    auto total = (uint64_t) (seconds + 0.5);
+
+    if (total >= 3600) {
+        snprintf(text, sizeof(text), "%luh%02lum", (unsigned long) (total / 3600), (unsigned long) (total % 3600 / 60));
+    } else if (total >= 60) {
+        snprintf(text, sizeof(text), "%lum%02lus", (unsigned long) (total / 60), (unsigned long) (total % 60));
+    } else {
+        snprintf(text, sizeof(text), "%lus", (unsigned long) total);
+    }
+
+    return text;
+}
+
+void ProgressReporter::report(bool done) {
+    auto now = std::chrono::steady_clock::now();
+    uint64_t bytes = progress.getBytes();
+    uint64_t results = progress.getResults();
+    uint64_t total = progress.getTotal();
+
+    double elapsed = std::chrono::duration<double>(now - started).count();
+    double sinceLast = std::chrono::duration<double>(now - lastTime).count();
+
+    // the rate of the last intervals, smoothed so the ETA does not jump around
+    if (sinceLast > 0) {
+        double current = (bytes - lastBytes) / sinceLast;
+        rate = lastBytes == 0 && rate == 0 ? current : 0.7 * rate + 0.3 * current;
+    }
+
+    lastTime = now;
+    lastBytes = bytes;
+
+    // the final line gives the average of the whole scan
+    double shownRate = done && elapsed > 0 ? bytes / elapsed : rate;
+    double eta = !done && total > bytes && rate > 0 ? (total - bytes) / rate : -1;
+
+    if (format == PROGRESS_FORMAT_JSON) {
+        // null when there is no estimate yet, or no total size
+        char etaText[32] = "null";
+        if (eta >= 0) snprintf(etaText, sizeof(etaText), "%.1f", eta);
+
+        fprintf(output, "{\"elapsed_seconds\":%.3f,\"bytes\":%lu,\"total_bytes\":%lu,\"bytes_per_second\":%.0f,\"eta_seconds\":%s,\"results\":%lu,\"done\":%s}\n",
+                elapsed, (unsigned long) bytes, (unsigned long) total, shownRate, etaText, (unsigned long) results, done ? "true" : "false");
+        fflush(output);
+        return;
+    }
+
+    std::string line = "* Scanned " + formatSize((double) bytes);
+
+    if (total > 0) {
+        char percent[32];
+        snprintf(percent, sizeof(percent), " (%.1f %%)", 100.0 * bytes / total);
+        line += " of " + formatSize((double) total) + percent;
+    }
+
+    char details[128];
+    snprintf(details, sizeof(details), ", %.2f GB/s, %lu results", shownRate / 1e9, (unsigned long) results);
+    line += details;
+
+    if (eta >= 0) line += ", ETA " + formatDuration(eta);
+    if (done) line += ", done in " + formatDuration(elapsed);
+
+    // a terminal shows a single line, updated in place
+    if (terminal) {
+        fprintf(output, "\r%s\033[K%s", line.c_str(), done ? "\n" : "");
+    } else {
+        fprintf(output, "%s\n", line.c_str());
+    }
+
+    fflush(output);
+}
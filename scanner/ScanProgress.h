@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+typedef enum {
+    PROGRESS_FORMAT_TEXT,
+    PROGRESS_FORMAT_JSON
+} ProgressFormat;
+
+// Bytes scanned and results found so far, added by the scanning threads once per chunk.
+//
+// Each thread adds to its own slot, on its own cache line, with relaxed atomics: the scan loop
+// never waits for the reader, and threads do not share a line unless there are more of them
+// than slots.
+class ScanProgress {
+public:
+    static constexpr size_t SLOT_COUNT = 64;
+
+    void add(uint64_t bytes, uint64_t results);
+
+    uint64_t getBytes() const;
+    uint64_t getResults() const;
+
+    // 0 when the size is unknown, like a compressed stream
+    void setTotal(uint64_t bytes) { total.store(bytes, std::memory_order_relaxed); }
+    uint64_t getTotal() const { return total.load(std::memory_order_relaxed); }
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> results{0};
+    };
+
+    Slot slots[SLOT_COUNT];
+    std::atomic<uint64_t> total{0};
+};
+
+// Prints the progress of a scan from its own thread, every interval until stopped.
+//
+// On a terminal the text format keeps rewriting the same line, otherwise it prints one line per
+// interval. The json format prints one object per line, the last one has "done": true.
+class ProgressReporter {
+public:
+    ProgressReporter(const ScanProgress& progress, ProgressFormat format, std::chrono::milliseconds interval, FILE* output = stderr);
+    ~ProgressReporter();
+
+    ProgressReporter(const ProgressReporter&) = delete;
+    ProgressReporter& operator=(const ProgressReporter&) = delete;
+
+    // prints the final state once
+    void stop();
+
+private:
+    void run();
+    void report(bool done);
+
+    const ScanProgress& progress;
+    ProgressFormat format;
+    std::chrono::milliseconds interval;
+    FILE* output;
+    bool terminal;
+
+    std::chrono::steady_clock::time_point started;
+    std::chrono::steady_clock::time_point lastTime;
+    uint64_t lastBytes = 0;
+    double rate = 0;
+
+    bool stopping = false;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::thread thread;
+};
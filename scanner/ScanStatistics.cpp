@@ -0,0 +1,129 @@
+#include "ScanStatistics.h"
+#include "PerfCounters.h"
+#include "ScanTrace.h"
+
+#include <cstdio>
+#include <sys/resource.h>
+
+void ScanStatistics::begin(ScanPhase phase) {
+    if (perfCounters != nullptr) perfCounters->begin(phase);
+    starts[phase] = std::chrono::steady_clock::now();
+}
+
+void ScanStatistics::end(ScanPhase phase) {
+    times[phase] += std::chrono::steady_clock::now() - starts[phase];
+    ScanTrace::span(std::get<std::string>(PHASE_DETAILS[phase]).c_str(), "phase", starts[phase]);
+    if (perfCounters != nullptr) perfCounters->end(phase);
+}
+
+void ScanStatistics::addTime(ScanPhase phase, std::chrono::nanoseconds time) {
+    times[phase] += time;
+}
+
+void ScanStatistics::setStructure(std::shared_ptr<const CompiledStructure> inputStructure) {
+    structure = std::move(inputStructure);
+    counters.resize(structure->getCriteriaCount());
+}
+
+double ScanStatistics::getSeconds(ScanPhase phase) const {
+    return std::chrono::duration<double>(times[phase]).count();
+}
+
+uint64_t ScanStatistics::peakResidentBytes() {
+    struct rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+
+    // kilobytes on Linux
+    return (uint64_t) usage.ru_maxrss * 1024;
+}
+
+// the name of each criteria of the structure, in the order of the counters
+static std::vector<std::tuple<size_t, std::string, std::string>> criteriaNames(const CompiledStructure& structure) {
+    std::vector<std::tuple<size_t, std::string, std::string>> names;
+    const std::vector<ScannerField>& fields = structure.getFields();
+
+    for (size_t i = 0; i < fields.size(); i++) {
+        std::string primitive = std::get<std::string>(PRIM_DETAILS[fields[i].primitive]);
+
+        for (const ScannerCriteria& criteria : fields[i].criterias) {
+            std::string name = "unknown";
+
+            for (const auto& details : CRIT_DETAILS) {
+                if (std::get<ScannerCriteriaType>(details) == criteria.type) name = std::get<std::vector<std::string>>(details)[0];
+            }
+
+            names.emplace_back(i, primitive, name);
+        }
+    }
+
+    return names;
+}
+
+void ScanStatistics::print(std::ostream& out) const {
+    char line[256];
+    double scanSeconds = getSeconds(SCAN_PHASE_SCAN);
+
+    out << "* Phases:";
+    for (const auto& details : PHASE_DETAILS) {
+        snprintf(line, sizeof(line), " %s %.3f ms", std::get<std::string>(details).c_str(), getSeconds(std::get<ScanPhase>(details)) * 1e3);
+        out << line;
+    }
+    out << std::endl;
+
+    snprintf(line, sizeof(line), "* Scanned %lu bytes with the %s engine, %.3f GB/s, %lu results.", (unsigned long) bytesScanned, engine.c_str(),
+             scanSeconds > 0 ? bytesScanned / scanSeconds / 1e9 : 0.0, (unsigned long) results);
+    out << line << std::endl;
+
+    if (structure) {
+        auto names = criteriaNames(*structure);
+
+        for (size_t i = 0; i < names.size() && i < counters.evaluated.size(); i++) {
+            uint64_t evaluated = counters.evaluated[i];
+            uint64_t rejected = counters.rejected[i];
+
+            snprintf(line, sizeof(line), "* Field %lu %s %s: %lu candidates, %lu rejected (%.3f %%).", (unsigned long) std::get<0>(names[i]),
+                     std::get<1>(names[i]).c_str(), std::get<2>(names[i]).c_str(), (unsigned long) evaluated, (unsigned long) rejected,
+                     evaluated > 0 ? 100.0 * rejected / evaluated : 0.0);
+            out << line << std::endl;
+        }
+    }
+
+    snprintf(line, sizeof(line), "* Peak RSS %.1f MiB, result buffers %.1f MiB.", peakResidentBytes() / 1048576.0, resultMemory / 1048576.0);
+    out << line << std::endl;
+}
+
+json ScanStatistics::toJson() const {
+    json phases = json::object();
+    for (const auto& details : PHASE_DETAILS) phases[std::get<std::string>(details)] = getSeconds(std::get<ScanPhase>(details));
+
+    double scanSeconds = getSeconds(SCAN_PHASE_SCAN);
+    json criterias = json::array();
+
+    if (structure) {
+        auto names = criteriaNames(*structure);
+
+        for (size_t i = 0; i < names.size() && i < counters.evaluated.size(); i++) {
+            uint64_t evaluated = counters.evaluated[i];
+
+            criterias.push_back({
+                { "field", std::get<0>(names[i]) },
+                { "type", std::get<1>(names[i]) },
+                { "criteria", std::get<2>(names[i]) },
+                { "candidates", evaluated },
+                { "rejected", counters.rejected[i] },
+                { "rejection_rate", evaluated > 0 ? (double) counters.rejected[i] / evaluated : 0.0 }
+            });
+        }
+    }
+
+    return {
+        { "phases_seconds", phases },
+        { "engine", engine },
+        { "bytes_scanned", bytesScanned },
+        { "gigabytes_per_second", scanSeconds > 0 ? bytesScanned / scanSeconds / 1e9 : 0.0 },
+        { "results", results },
+        { "criterias", criterias },
+        { "peak_rss_bytes", peakResidentBytes() },
+        { "result_memory_bytes", resultMemory }
+    };
+}
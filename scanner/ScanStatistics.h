@@ -0,0 +1,71 @@
+#pragma once
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "CompiledStructure.h"
+
+class PerfCounters;
+
+typedef enum {
+    SCAN_PHASE_LOAD,
+    SCAN_PHASE_PARSE,
+    SCAN_PHASE_SCAN,
+    SCAN_PHASE_WRITE,
+    SCAN_PHASE_COUNT
+} ScanPhase;
+
+// Details about each phase of a scan
+// { phase, name }
+const std::vector<std::tuple<ScanPhase, std::string>> PHASE_DETAILS = {
+    { SCAN_PHASE_LOAD, "load" },
+    { SCAN_PHASE_PARSE, "parse" },
+    { SCAN_PHASE_SCAN, "scan" },
+    { SCAN_PHASE_WRITE, "write" }
+};
+
+// What --stats reports about one scan: the time of each phase, the bytes scanned, how many offsets
+// reached each criteria and how many it rejected, and the memory used.
+class ScanStatistics {
+public:
+    void begin(ScanPhase phase);
+    void end(ScanPhase phase);
+    void addTime(ScanPhase phase, std::chrono::nanoseconds time);
+
+    // the hardware counters are read at the same phase boundaries
+    void setPerfCounters(PerfCounters* counters) { perfCounters = counters; }
+
+    void setStructure(std::shared_ptr<const CompiledStructure> inputStructure);
+    // filled by the scanner, merged from every thread
+    ScanCounters& getCounters() { return counters; }
+
+    void setEngine(const std::string& name) { engine = name; }
+    void setBytesScanned(uint64_t bytes) { bytesScanned = bytes; }
+    void setResults(uint64_t count) { results = count; }
+    void setResultMemory(uint64_t bytes) { resultMemory = bytes; }
+
+    double getSeconds(ScanPhase phase) const;
+    uint64_t getBytesScanned() const { return bytesScanned; }
+
+    void print(std::ostream& out) const;
+    json toJson() const;
+
+    // highest resident set size of the process so far
+    static uint64_t peakResidentBytes();
+
+private:
+    std::chrono::nanoseconds times[SCAN_PHASE_COUNT]{};
+    std::chrono::steady_clock::time_point starts[SCAN_PHASE_COUNT]{};
+
+    std::shared_ptr<const CompiledStructure> structure;
+    ScanCounters counters;
+    PerfCounters* perfCounters = nullptr;
+
+    std::string engine = "scan";
+    uint64_t bytesScanned = 0;
+    uint64_t results = 0;
+    uint64_t resultMemory = 0;
+};
@@ -0,0 +1,132 @@
+#include "ScanTrace.h"
+#include "ScanUtils.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+std::atomic<ScanTrace*> ScanTrace::active{nullptr};
+std::atomic<uint64_t> ScanTrace::nextGeneration{1};
+
+static pid_t currentThreadId() {
+    return (pid_t) syscall(SYS_gettid);
+}
+
+ScanTrace::ScanTrace(size_t capacity)
+    : capacity(capacity > 0 ? capacity : DEFAULT_CAPACITY),
+      generation(nextGeneration.fetch_add(1)),
+      mainThread(currentThreadId()),
+      origin(std::chrono::steady_clock::now()) {}
+
+ScanTrace::~ScanTrace() {
+    stop();
+}
+
+void ScanTrace::start() {
+    active.store(this);
+}
+
+void ScanTrace::stop() {
+    ScanTrace* expected = this;
+    active.compare_exchange_strong(expected, nullptr);
+}
+
+// the buffer of the calling thread, the generation tells a new trace from an old one at the same address
+ScanTrace::ThreadBuffer* ScanTrace::threadBuffer() {
+    thread_local uint64_t bufferGeneration = 0;
+    thread_local ThreadBuffer* buffer = nullptr;
+
+    if (bufferGeneration == generation) return buffer;
+
+    auto created = std::make_unique<ThreadBuffer>();
+    created->tid = currentThreadId();
+    created->events.resize(capacity);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    buffer = created.get();
+    bufferGeneration = generation;
+    buffers.push_back(std::move(created));
+
+    return buffer;
+}
+
+void ScanTrace::record(const char* name, const char* category, std::chrono::steady_clock::time_point begin,
+                       std::chrono::steady_clock::time_point end, uint64_t offset, uint64_t bytes) {
+    ThreadBuffer* buffer = threadBuffer();
+
+    auto since = [this](std::chrono::steady_clock::time_point time) {
+        return time > origin ? (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(time - origin).count() : 0;
+    };
+
+    uint64_t startTime = since(begin);
+    uint64_t endTime = since(end);
+
+    buffer->events[buffer->written % capacity] = TraceEvent{ name, category, startTime, endTime - startTime, offset, bytes };
+    buffer->written++;
+}
+
+size_t ScanTrace::getEventCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t count = 0;
+
+    for (const auto& buffer : buffers) count += std::min<uint64_t>(buffer->written, capacity);
+    return count;
+}
+
+uint64_t ScanTrace::getDroppedCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t dropped = 0;
+
+    for (const auto& buffer : buffers) dropped += buffer->written > capacity ? buffer->written - capacity : 0;
+    return dropped;
+}
+
+bool ScanTrace::save(const std::string& path) const {
+    std::ofstream file(path, std::ios::trunc);
+    if (!file.is_open()) return false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    pid_t pid = getpid();
+    bool first = true;
+
+    auto writeEvent = [&](const json& event) {
+        file << (first ? "\n" : ",\n") << event.dump();
+        first = false;
+    };
+
+    file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+
+    writeEvent({ { "name", "process_name" }, { "ph", "M" }, { "pid", pid }, { "args", { { "name", "walker" } } } });
+
+    for (const auto& buffer : buffers) {
+        std::string threadName = buffer->tid == mainThread ? "main" : "worker " + std::to_string(buffer->tid);
+        writeEvent({ { "name", "thread_name" }, { "ph", "M" }, { "pid", pid }, { "tid", buffer->tid }, { "args", { { "name", threadName } } } });
+
+        // oldest first, a full ring starts at its write position
+        uint64_t kept = std::min<uint64_t>(buffer->written, capacity);
+
+        for (uint64_t i = buffer->written - kept; i < buffer->written; i++) {
+            const TraceEvent& event = buffer->events[i % capacity];
+
+            // complete events, times in microseconds
+            writeEvent({
+                { "name", event.name },
+                { "cat", event.category },
+                { "ph", "X" },
+                { "ts", event.start / 1e3 },
+                { "dur", event.duration / 1e3 },
+                { "pid", pid },
+                { "tid", buffer->tid },
+                { "args", { { "offset", event.offset }, { "bytes", event.bytes } } }
+            });
+        }
+    }
+
+    uint64_t dropped = 0;
+    for (const auto& buffer : buffers) dropped += buffer->written > capacity ? buffer->written - capacity : 0;
+
+    file << "\n],\"otherData\":{\"dropped_spans\":" << dropped << "}}" << std::endl;
+
+    return file.good();
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+// One finished span, names and categories are string literals
+struct TraceEvent {
+    const char* name;
+    const char* category;
+    // nanoseconds since the trace started
+    uint64_t start;
+    uint64_t duration;
+    uint64_t offset;
+    uint64_t bytes;
+};
+
+// Spans of every thread during a scan, written in the Chrome Trace Event format read by Perfetto
+// and chrome://tracing.
+//
+// Each thread records into its own ring buffer, registered the first time it records, so threads
+// never share a lock or a cache line while tracing. When a buffer is full the oldest spans are
+// overwritten. At most one trace is active, spans are only recorded while it is.
+class ScanTrace {
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 64 * 1024;
+
+    explicit ScanTrace(size_t capacity = DEFAULT_CAPACITY);
+    ~ScanTrace();
+
+    ScanTrace(const ScanTrace&) = delete;
+    ScanTrace& operator=(const ScanTrace&) = delete;
+
+    // the threads must not record anymore when the trace is stopped or destroyed
+    void start();
+    void stop();
+
+    static ScanTrace* current() { return active.load(std::memory_order_relaxed); }
+
+    void record(const char* name, const char* category, std::chrono::steady_clock::time_point begin,
+                std::chrono::steady_clock::time_point end, uint64_t offset = 0, uint64_t bytes = 0);
+
+    // records the span when a trace is active
+    static void span(const char* name, const char* category, std::chrono::steady_clock::time_point begin,
+                     uint64_t offset = 0, uint64_t bytes = 0) {
+        ScanTrace* trace = current();
+        if (trace != nullptr) trace->record(name, category, begin, std::chrono::steady_clock::now(), offset, bytes);
+    }
+
+    size_t getEventCount() const;
+    // spans overwritten in full ring buffers
+    uint64_t getDroppedCount() const;
+
+    bool save(const std::string& path) const;
+
+private:
+    struct ThreadBuffer {
+        pid_t tid;
+        std::vector<TraceEvent> events;
+        // total recorded, the ring position is written % capacity
+        uint64_t written = 0;
+    };
+
+    ThreadBuffer* threadBuffer();
+
+    static std::atomic<ScanTrace*> active;
+    static std::atomic<uint64_t> nextGeneration;
+
+    size_t capacity;
+    uint64_t generation;
+    pid_t mainThread;
+    std::chrono::steady_clock::time_point origin;
+
+    mutable std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+};
+
+// Records the span of its scope in the active trace. Without an active trace, it costs a load and
+// a branch that is always taken the same way.
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name, const char* category, uint64_t offset = 0, uint64_t bytes = 0)
+        : trace(ScanTrace::current()) {
+        if (trace == nullptr) return;
+
+        this->name = name;
+        this->category = category;
+        this->offset = offset;
+        this->bytes = bytes;
+        begin = std::chrono::steady_clock::now();
+    }
+
+    ~TraceSpan() {
+        if (trace != nullptr) trace->record(name, category, begin, std::chrono::steady_clock::now(), offset, bytes);
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    // for sizes only known at the end of the span
+    void setBytes(uint64_t count) { bytes = count; }
+
+private:
+    ScanTrace* trace;
+    const char* name = nullptr;
+    const char* category = nullptr;
+    uint64_t offset = 0;
+    uint64_t bytes = 0;
+    std::chrono::steady_clock::time_point begin;
+};
@@ -1,6 +1,6 @@
 #include "ScanUtils.h"
 
-bool ScanUtils::matchesField(void *buffer, ScannerField field) {
+bool ScanUtils::matchesField(void *buffer, const ScannerField& field) {
     ScannerPrimitive primitive = field.primitive;
     bool matches = true;
 
@@ -95,6 +95,94 @@ void *ScanUtils::castAsPrimitiveType(const json& value, ScannerPrimitive primiti
     return nullptr;
 }
 
+void *ScanUtils::clonePrimitiveValue(const void* value, ScannerPrimitive primitive) {
+    if (value == nullptr) return nullptr;
+
+    switch (primitive) {
+        case SCANNER_PRIMITIVE_UINT8:
+            return (void*) new uint8_t(*(const uint8_t*) value);
+        case SCANNER_PRIMITIVE_UINT16:
+            return (void*) new uint16_t(*(const uint16_t*) value);
+        case SCANNER_PRIMITIVE_UINT32:
+            return (void*) new uint32_t(*(const uint32_t*) value);
+        case SCANNER_PRIMITIVE_UINT64:
+            return (void*) new uint64_t(*(const uint64_t*) value);
+        case SCANNER_PRIMITIVE_INT8:
+            return (void*) new int8_t(*(const int8_t*) value);
+        case SCANNER_PRIMITIVE_INT16:
+            return (void*) new int16_t(*(const int16_t*) value);
+        case SCANNER_PRIMITIVE_INT32:
+            return (void*) new int32_t(*(const int32_t*) value);
+        case SCANNER_PRIMITIVE_INT64:
+            return (void*) new int64_t(*(const int64_t*) value);
+        case SCANNER_PRIMITIVE_FLOAT:
+            return (void*) new float(*(const float*) value);
+        case SCANNER_PRIMITIVE_DOUBLE:
+            return (void*) new double(*(const double*) value);
+        case SCANNER_PRIMITIVE_POINTER:
+            return (void*) new uintptr_t(*(const uintptr_t*) value);
+        case SCANNER_PRIMITIVE_BYTES:
+            return (void*) new std::string(*(const std::string*) value);
+        case SCANNER_PRIMITIVE_STRING: {
+            char *str = new char[strlen((const char*) value) + 1];
+            strcpy(str, (const char*) value);
+            return (char *) str;
+        }
+        case SCANNER_PRIMITIVE_NONE:
+            break;
+    }
+
+    return nullptr;
+}
+
+void ScanUtils::freePrimitiveValue(void* value, ScannerPrimitive primitive) {
+    if (value == nullptr) return;
+
+    switch (primitive) {
+        case SCANNER_PRIMITIVE_UINT8:
+            delete (uint8_t*) value;
+            break;
+        case SCANNER_PRIMITIVE_UINT16:
+            delete (uint16_t*) value;
+            break;
+        case SCANNER_PRIMITIVE_UINT32:
+            delete (uint32_t*) value;
+            break;
+        case SCANNER_PRIMITIVE_UINT64:
+            delete (uint64_t*) value;
+            break;
+        case SCANNER_PRIMITIVE_INT8:
+            delete (int8_t*) value;
+            break;
+        case SCANNER_PRIMITIVE_INT16:
+            delete (int16_t*) value;
+            break;
+        case SCANNER_PRIMITIVE_INT32:
+            delete (int32_t*) value;
+            break;
+        case SCANNER_PRIMITIVE_INT64:
+            delete (int64_t*) value;
+            break;
+        case SCANNER_PRIMITIVE_FLOAT:
+            delete (float*) value;
+            break;
+        case SCANNER_PRIMITIVE_DOUBLE:
+            delete (double*) value;
+            break;
+        case SCANNER_PRIMITIVE_POINTER:
+            delete (uintptr_t*) value;
+            break;
+        case SCANNER_PRIMITIVE_BYTES:
+            delete (std::string*) value;
+            break;
+        case SCANNER_PRIMITIVE_STRING:
+            delete[] (char*) value;
+            break;
+        case SCANNER_PRIMITIVE_NONE:
+            break;
+    }
+}
+
 bool ScanUtils::matchesCriteria(void *buffer, ScannerCriteria criteria, ScannerPrimitive primitive, size_t size) {
     switch (primitive) {
         case SCANNER_PRIMITIVE_UINT8:
@@ -157,6 +245,22 @@ bool ScanUtils::comparePattern(void *buffer, const std::string& pattern, size_t
     return true;
 }
 
+std::vector<int> ScanUtils::parsePattern(const std::string& pattern) {
+    std::vector<int> bytes;
+
+    for (const std::string& token : ScanUtils::splitString(pattern, " ")) {
+        if (token == "?" || token == "??") {
+            bytes.push_back(-1);
+        } else if (!token.empty() && token.size() <= 2 && ScanUtils::isHex(token)) {
+            bytes.push_back(std::stoi(token, nullptr, 16));
+        } else {
+            return {};
+        }
+    }
+
+    return bytes;
+}
+
 std::vector<std::string> ScanUtils::splitString(const std::string& str, const std::string& delimiter) {
     std::vector<std::string> tokens;
     std::string::size_type lastPos = 0, pos = 0;
@@ -134,7 +134,7 @@ const std::vector<std::tuple<ScannerCriteriaType, std::vector<std::string>, std:
 
 class ScanUtils {
 public:
-    static bool matchesField(void* buffer, ScannerField field);
+    static bool matchesField(void* buffer, const ScannerField& field);
 
     static size_t getPrimitiveSize(ScannerPrimitive primitive);
     static size_t calculateStructureSize(const std::vector<ScannerField>& fields);
@@ -143,13 +143,18 @@ public:
     static ScannerCriteriaType getCriteriaByName(const std::string& name, bool isValueSet);
 
     static void* castAsPrimitiveType(const json& value, ScannerPrimitive primitive);
+    static void* clonePrimitiveValue(const void* value, ScannerPrimitive primitive);
+    static void freePrimitiveValue(void* value, ScannerPrimitive primitive);
 
     static bool comparePattern(void* buffer, const std::string& pattern, size_t maxSize);
+    // pattern bytes, -1 for wildcards, empty when the pattern is invalid
+    static std::vector<int> parsePattern(const std::string& pattern);
 
     static bool isPrimitiveSizeSet(ScannerPrimitive primitive);
 
-private:
     static bool matchesCriteria(void* buffer, ScannerCriteria criteria, ScannerPrimitive primitive, size_t size);
+
+private:
     static std::vector<std::string> splitString(const std::string& str, const std::string& delimiter);
     static bool isHex(const std::string& str);
 };
@@ -1,66 +1,241 @@
 #include "Scanner.h"
 
+#include <atomic>
+#include <deque>
+
 Scanner::Scanner() {
     buffer = nullptr;
     fields = std::vector<ScannerField>{};
+    structure = std::make_shared<CompiledStructure>(std::vector<ScannerField>{});
 }
 
 Scanner::~Scanner() {
-    delete[] buffer;
     fields.clear();
 }
 
 void Scanner::addField(ScannerField field) {
     fields.push_back(field);
+    structure = CompiledStructure::copyOf(fields);
 }
 
 void Scanner::setBuffer(char* inputBuffer, size_t inputBufferSize) {
     this->bufferSize = inputBufferSize;
-    this->buffer = new char[bufferSize];
-    memcpy(this->buffer, inputBuffer, bufferSize);
+    this->ownedBuffer.reset(new char[bufferSize]);
+    memcpy(this->ownedBuffer.get(), inputBuffer, bufferSize);
+    this->buffer = this->ownedBuffer.get();
+}
+
+void Scanner::setView(const uint8_t* data, size_t size) {
+    this->ownedBuffer.reset();
+    this->bufferSize = size;
+    this->buffer = (const char*) data;
 }
 
-std::vector<ScannerResult> Scanner::scan() {
-    std::vector<ScannerResult> results;
+ResultSet Scanner::scan() {
+    ResultSet results{structure->getSize(), buffer};
+    ResultSetSink sink{results};
+
+    scan(sink);
 
-    if (buffer == nullptr) return results;
-    if (fields.empty()) return results;
+    return results;
+}
 
-    size_t structureSize = ScanUtils::calculateStructureSize(fields);
+size_t Scanner::scan(ResultSink& sink) {
+    TraceSpan pass{"structure pass", "scan", 0, bufferSize};
 
-    for (size_t i = 0; i < bufferSize - structureSize; i++) {
-        size_t offset = 0;
+    if (pool != nullptr && pool->getThreadCount() > 1 && bufferSize > chunkSize) return scanParallel(sink);
+    if (progress != nullptr) return scanChunks(sink);
+    if (counters != nullptr) return structure->scan(buffer, bufferSize, sink, *counters);
+    return structure->scan(buffer, bufferSize, sink);
+}
 
-        for (const auto& field : fields) {
-            if (ScanUtils::matchesField(buffer + i + offset, field)) {
-                if (ScanUtils::isPrimitiveSizeSet(field.primitive)) {
-                    offset += field.size;
-                } else {
-                    offset += ScanUtils::getPrimitiveSize(field.primitive);
-                }
+size_t Scanner::scanReference(ResultSink& sink) const {
+    size_t count = 0;
+    size_t structureSize = structure->getSize();
+    const std::vector<ScannerField>& structureFields = structure->getFields();
+    const StructureLayout& layout = structure->getLayout();
+
+    if (buffer == nullptr) return count;
+    if (structureFields.empty()) return count;
+    if (structureSize > bufferSize) return count;
+
+    for (size_t i = 0; i + structureSize <= bufferSize; i++) {
+        bool matches = true;
+
+        for (size_t j = 0; j < structureFields.size() && matches; j++) {
+            matches = ScanUtils::matchesField((void*) (buffer + i + layout.getFieldOffset(j)), structureFields[j]);
+        }
+
+        if (!matches) continue;
+
+        count++;
+        if (!sink.push(ScannerResult{ structureSize, i, (void*) (buffer + i) })) break;
+    }
+
+    return count;
+}
+
+void Scanner::setCounters(ScanCounters* inputCounters) {
+    this->counters = inputCounters;
+}
+
+void Scanner::setProgress(ScanProgress* inputProgress) {
+    this->progress = inputProgress;
+}
+
+void Scanner::setThreadPool(ThreadPool* inputPool, size_t inputChunkSize) {
+    this->pool = inputPool;
+    this->chunkSize = inputChunkSize > 0 ? inputChunkSize : DEFAULT_CHUNK_SIZE;
+}
+
+size_t Scanner::scanParallel(ResultSink& sink) {
+    size_t count = 0;
+    size_t structureSize = structure->getSize();
+
+    if (buffer == nullptr) return count;
+    if (structure->isEmpty()) return count;
+    if (structureSize > bufferSize) return count;
+
+    // every chunk covers chunkSize starting positions and reads structureSize - 1 bytes past them
+    struct Chunk {
+        size_t start;
+        ResultSet results;
+        ScanCounters counters;
+        std::future<void> done;
+    };
+
+    size_t positions = bufferSize - structureSize + 1;
+    size_t chunkCount = (positions + chunkSize - 1) / chunkSize;
+    size_t window = pool->getThreadCount() * 2;
+
+    std::deque<Chunk> inFlight;
+    std::atomic<bool> stopped{false};
+    size_t nextChunk = 0;
+
+    auto submit = [&](size_t index) {
+        size_t start = index * chunkSize;
+        size_t end = std::min(start + chunkSize, positions);
+
+        inFlight.push_back(Chunk{ start, ResultSet{structureSize}, {}, {} });
+        ResultSet* results = &inFlight.back().results;
+        ScanCounters* chunkCounters = counters != nullptr ? &inFlight.back().counters : nullptr;
+        // the last chunk also covers the bytes no structure can start at
+        size_t chunkBytes = (end == positions ? bufferSize : end) - start;
+
+        inFlight.back().done = pool->submit([this, start, end, chunkBytes, structureSize, results, chunkCounters, &stopped] {
+            if (stopped.load(std::memory_order_relaxed)) return;
+
+            TraceSpan span{"chunk scan", "scan", start, end - start + structureSize - 1};
+            ResultSetSink chunkSink{*results};
+
+            if (chunkCounters != nullptr) {
+                structure->scan(buffer + start, end - start + structureSize - 1, chunkSink, *chunkCounters);
             } else {
-                break;
+                structure->scan(buffer + start, end - start + structureSize - 1, chunkSink);
+            }
+
+            if (progress != nullptr) progress->add(chunkBytes, results->size());
+        });
+    };
+
+    // only a bounded window of chunks is scanned ahead of the sink
+    while (nextChunk < chunkCount && inFlight.size() < window) submit(nextChunk++);
+
+    bool keepGoing = true;
+
+    try {
+        while (!inFlight.empty()) {
+            Chunk& chunk = inFlight.front();
+
+            {
+                TraceSpan wait{"wait", "scan", chunk.start};
+                chunk.done.get();
             }
+
+            TraceSpan merge{"merge", "scan", chunk.start};
+
+            if (counters != nullptr) counters->merge(chunk.counters);
+
+            for (const ScannerResult& result : chunk.results) {
+                if (!keepGoing) break;
+
+                size_t offset = chunk.start + result.offset;
+                count++;
+
+                if (!sink.push(ScannerResult{ structureSize, offset, (void*) (buffer + offset) })) {
+                    keepGoing = false;
+                    stopped.store(true, std::memory_order_relaxed);
+                }
+            }
+
+            inFlight.pop_front();
+            if (keepGoing && nextChunk < chunkCount) submit(nextChunk++);
         }
+    } catch (...) {
+        // the remaining tasks still reference this frame
+        stopped.store(true, std::memory_order_relaxed);
+        for (Chunk& chunk : inFlight) {
+            if (chunk.done.valid()) chunk.done.wait();
+        }
+        throw;
+    }
+
+    return count;
+}
+
+size_t Scanner::scanChunks(ResultSink& sink) {
+    size_t count = 0;
+    size_t structureSize = structure->getSize();
+
+    if (buffer == nullptr) return count;
+    if (structure->isEmpty()) return count;
+    if (structureSize > bufferSize) return count;
+
+    size_t positions = bufferSize - structureSize + 1;
+    bool keepGoing = true;
+
+    for (size_t start = 0; start < positions && keepGoing; start += chunkSize) {
+        size_t end = std::min(start + chunkSize, positions);
+        size_t found = 0;
 
-        if (offset == structureSize) {
-            results.push_back(ScannerResult{ structureSize, i, buffer + i });
+        CallbackSink shifted([&](const ScannerResult& result) {
+            size_t offset = start + result.offset;
+
+            found++;
+            keepGoing = sink.push(ScannerResult{ structureSize, offset, (void*) (buffer + offset) });
+
+            return keepGoing;
+        });
+
+        if (counters != nullptr) {
+            structure->scan(buffer + start, end - start + structureSize - 1, shifted, *counters);
+        } else {
+            structure->scan(buffer + start, end - start + structureSize - 1, shifted);
         }
+
+        count += found;
+        progress->add((end == positions ? bufferSize : end) - start, found);
     }
 
-    return results;
+    return count;
 }
 
 void Scanner::setFields(std::vector<ScannerField> inputFields) {
     this->fields = std::move(inputFields);
+    this->structure = CompiledStructure::copyOf(fields);
+}
+
+void Scanner::setStructure(std::shared_ptr<const CompiledStructure> inputStructure) {
+    this->fields = inputStructure->getFields();
+    this->structure = std::move(inputStructure);
 }
 
-void Scanner::saveResults(const std::vector<ScannerResult>& results, const std::string& filename) {
-    std::ofstream file(filename, std::ios::binary);
+bool Scanner::saveResults(const ResultSet& results, const std::string& filename, ResultFormat format, bool async) const {
+    ResultWriter writer{filename, format, structure->getFields(), async};
 
-    for (ScannerResult result : results) {
-        file << "0x" << std::hex << result.offset << std::endl;
+    for (const ScannerResult& result : results) {
+        writer.write(result);
     }
 
-    file.close();
+    return writer.isOpen() && writer.close();
 }
@@ -3,31 +3,73 @@
 
 #include <cstdio>
 #include <cstdlib>
+#include <cstdint>
 #include <vector>
 #include <cstring>
 #include <utility>
 #include <fstream>
+#include <memory>
 
 #include "ScanUtils.h"
+#include "ResultSet.h"
+#include "ResultWriter.h"
+#include "ResultSink.h"
+#include "CompiledStructure.h"
+#include "ThreadPool.h"
+#include "ScanTrace.h"
+#include "ScanProgress.h"
 
 class Scanner {
 public:
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 16 * 1024 * 1024;
+
     Scanner();
     ~Scanner();
 
     void addField(ScannerField field);
 
     void setFields(std::vector<ScannerField> inputFields);
+    void setStructure(std::shared_ptr<const CompiledStructure> inputStructure);
+
+    // copies the buffer, the scanner owns the copy
     void setBuffer(char* inputBuffer, size_t bufferSize);
+    // scans the caller's memory in place, it must outlive the scans
+    void setView(const uint8_t* data, size_t size);
+
+    // splits the scans in chunks running on the pool, results are still delivered in order
+    void setThreadPool(ThreadPool* inputPool, size_t inputChunkSize = DEFAULT_CHUNK_SIZE);
+
+    // counts the criteria tested by the next scans into counters, nullptr to stop counting
+    void setCounters(ScanCounters* inputCounters);
+
+    // adds the bytes and results of each chunk to progress, nullptr to stop.
+    // A single thread then also scans in chunks, so the progress moves during the scan.
+    void setProgress(ScanProgress* inputProgress);
 
-    std::vector<ScannerResult> scan();
+    ResultSet scan();
+    size_t scan(ResultSink& sink);
 
-    static void saveResults(const std::vector<ScannerResult>& results, const std::string& filename);
+    // the plain offset by offset loop, kept unoptimised: every other engine must return exactly its results
+    size_t scanReference(ResultSink& sink) const;
+
+    // false when the file could not be written
+    bool saveResults(const ResultSet& results, const std::string& filename, ResultFormat format = RESULT_FORMAT_TEXT, bool async = false) const;
 private:
+    size_t scanParallel(ResultSink& sink);
+    size_t scanChunks(ResultSink& sink);
+
     std::vector<ScannerField> fields;
+    std::shared_ptr<const CompiledStructure> structure;
 
     size_t bufferSize{};
-    char* buffer;
+    const char* buffer;
+    std::unique_ptr<char[]> ownedBuffer;
+
+    ThreadPool* pool = nullptr;
+    size_t chunkSize = DEFAULT_CHUNK_SIZE;
+
+    ScanCounters* counters = nullptr;
+    ScanProgress* progress = nullptr;
 };
 
 
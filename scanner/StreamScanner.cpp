@@ -0,0 +1,79 @@
+#include "StreamScanner.h"
+
+#include <algorithm>
+
+StreamScanner::StreamScanner(std::shared_ptr<const CompiledStructure> structure, ResultSink& sink)
+    : structure(std::move(structure)), sink(sink) {}
+
+void StreamScanner::reset() {
+    tail.clear();
+    position = 0;
+    stopped = false;
+}
+
+void StreamScanner::setCounters(ScanCounters* inputCounters) {
+    counters = inputCounters;
+    if (counters != nullptr) counters->resize(structure->getCriteriaCount());
+}
+
+bool StreamScanner::push(const ScannerResult& result) {
+    count++;
+    stopped = !sink.push(result);
+
+    return !stopped;
+}
+
+bool StreamScanner::feed(const char* data, size_t size) {
+    size_t structureSize = structure->getSize();
+
+    if (stopped) return false;
+    if (structureSize == 0 || size == 0) return true;
+
+    TraceSpan span{"chunk scan", "scan", position, size};
+    size_t countBefore = count;
+    uint64_t tailStart = position - tail.size();
+
+    // structures starting in the tail are completed by the first bytes of the new piece
+    if (!tail.empty()) {
+        size_t head = std::min(size, structureSize - 1);
+
+        window.assign(tail.begin(), tail.end());
+        window.insert(window.end(), data, data + head);
+
+        for (size_t i = 0; i < tail.size() && i + structureSize <= window.size(); i++) {
+            bool matches = counters != nullptr ? structure->matches(window.data() + i, *counters) : structure->matches(window.data() + i);
+            if (!matches) continue;
+            if (!push(ScannerResult{ structureSize, tailStart + i, (void*) (window.data() + i) })) return false;
+        }
+    }
+
+    // the rest of the piece is scanned in place
+    uint64_t base = position;
+
+    CallbackSink shifted([this, base](const ScannerResult& result) {
+        return push(ScannerResult{ result.valueSize, base + result.offset, result.value });
+    });
+
+    if (counters != nullptr) {
+        structure->scan(data, size, shifted, *counters);
+    } else {
+        structure->scan(data, size, shifted);
+    }
+
+    if (stopped) return false;
+
+    // keep the last structureSize - 1 bytes of tail + piece
+    size_t keep = structureSize - 1;
+
+    if (size >= keep) {
+        tail.assign(data + size - keep, data + size);
+    } else {
+        tail.insert(tail.end(), data, data + size);
+        if (tail.size() > keep) tail.erase(tail.begin(), tail.end() - keep);
+    }
+
+    position += size;
+    if (progress != nullptr) progress->add(size, count - countBefore);
+
+    return true;
+}
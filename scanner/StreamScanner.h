@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "CompiledStructure.h"
+#include "ResultSink.h"
+#include "ScanTrace.h"
+#include "ScanProgress.h"
+
+// Scans a stream fed in consecutive pieces, reporting offsets relative to the start of the stream.
+// The last structureSize - 1 bytes of each piece are kept, so a structure straddling two pieces is
+// found exactly once, when the piece that completes it arrives.
+class StreamScanner {
+public:
+    StreamScanner(std::shared_ptr<const CompiledStructure> structure, ResultSink& sink);
+
+    // scans the next bytes of the stream, returns false once the sink stopped the scan
+    bool feed(const char* data, size_t size);
+
+    // starts over at offset 0, for streams that were truncated
+    void reset();
+
+    // counts the criteria tested by the next pieces into counters, nullptr to stop counting
+    void setCounters(ScanCounters* inputCounters);
+    // adds the bytes and results of each piece to progress, nullptr to stop
+    void setProgress(ScanProgress* inputProgress) { progress = inputProgress; }
+
+    uint64_t getPosition() const { return position; }
+    size_t getCount() const { return count; }
+
+private:
+    bool push(const ScannerResult& result);
+
+    std::shared_ptr<const CompiledStructure> structure;
+    ResultSink& sink;
+
+    // bytes of the previous pieces that may still start a structure
+    std::vector<char> tail;
+    std::vector<char> window;
+
+    uint64_t position = 0;
+    size_t count = 0;
+    bool stopped = false;
+
+    ScanCounters* counters = nullptr;
+    ScanProgress* progress = nullptr;
+};
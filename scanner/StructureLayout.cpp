@@ -0,0 +1,26 @@
+#include "StructureLayout.h"
+
+StructureLayout::StructureLayout(const std::vector<ScannerField>& fields) {
+    for (const ScannerField& field : fields) {
+        size_t size = ScanUtils::isPrimitiveSizeSet(field.primitive) ? field.size : ScanUtils::getPrimitiveSize(field.primitive);
+
+        primitives.push_back(field.primitive);
+        offsets.push_back(structureSize);
+        sizes.push_back(size);
+
+        structureSize += size;
+    }
+}
+
+FieldView StructureLayout::field(const ScannerResult& result, size_t index) const {
+    const char* data = result.value != nullptr ? (const char*) result.value + offsets[index] : nullptr;
+    return FieldView{ primitives[index], data, sizes[index] };
+}
+
+void StructureLayout::fields(const ScannerResult& result, std::vector<FieldView>& views) const {
+    views.resize(primitives.size());
+
+    for (size_t i = 0; i < primitives.size(); i++) {
+        views[i] = field(result, i);
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+#include "ScanUtils.h"
+
+// Non-owning view over the bytes of one field of a result, decoded on demand
+struct FieldView {
+    ScannerPrimitive primitive;
+    const char* data;
+    size_t size;
+
+    template<typename T>
+    T as() const {
+        T value;
+        memcpy(&value, data, sizeof(T));
+        return value;
+    }
+
+    std::string_view bytes() const {
+        return { data, size };
+    }
+};
+
+// Position and size of every field of a structure, used to slice results into field views
+class StructureLayout {
+public:
+    StructureLayout() = default;
+    explicit StructureLayout(const std::vector<ScannerField>& fields);
+
+    size_t getFieldCount() const { return primitives.size(); }
+    size_t getFieldOffset(size_t index) const { return offsets[index]; }
+    size_t getFieldSize(size_t index) const { return sizes[index]; }
+    ScannerPrimitive getFieldPrimitive(size_t index) const { return primitives[index]; }
+    size_t getStructureSize() const { return structureSize; }
+
+    FieldView field(const ScannerResult& result, size_t index) const;
+    void fields(const ScannerResult& result, std::vector<FieldView>& views) const;
+
+private:
+    std::vector<ScannerPrimitive> primitives;
+    std::vector<size_t> offsets;
+    std::vector<size_t> sizes;
+    size_t structureSize = 0;
+};
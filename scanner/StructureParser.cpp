@@ -18,9 +18,26 @@ std::vector<ScannerField> StructureParser::parse() {
     }
 
     json data = json::parse(file);
+    fields = StructureParser::parseJson(data);
+
+    printf("Parsed %lu fields.\n", fields.size());
+
+    return fields;
+}
+
+std::shared_ptr<CompiledStructure> StructureParser::compile() {
+    return std::make_shared<CompiledStructure>(parse());
+}
+
+std::vector<ScannerField> StructureParser::parseString(const std::string& data) {
+    return StructureParser::parseJson(json::parse(data));
+}
+
+std::vector<ScannerField> StructureParser::parseJson(const json& data) {
+    std::vector<ScannerField> fields{};
 
     // start parsing
-    for (json::iterator it = data.begin(); it != data.end(); ++it) {
+    for (json::const_iterator it = data.begin(); it != data.end(); ++it) {
         json field = it.value();
 
         std::string type = field["type"];
@@ -75,8 +92,6 @@ std::vector<ScannerField> StructureParser::parse() {
         });
     }
 
-    printf("Parsed %lu fields.\n", fields.size());
-
     return fields;
 }
 
@@ -1,9 +1,11 @@
 #pragma once
 
 #include <fstream>
+#include <memory>
 
 #include "Scanner.h"
 #include "ScanUtils.h"
+#include "CompiledStructure.h"
 
 #include "../lib/json.h"
 
@@ -11,6 +13,10 @@ class StructureParser {
 public:
     explicit StructureParser(std::string filename);
     std::vector<ScannerField> parse();
+    std::shared_ptr<CompiledStructure> compile();
+
+    static std::vector<ScannerField> parseString(const std::string& data);
+    static std::vector<ScannerField> parseJson(const nlohmann::json& data);
 private:
     std::string filename;
 };
\ No newline at end of file
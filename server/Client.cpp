@@ -0,0 +1,35 @@
+#include "Client.h"
+
+#include <unistd.h>
+
+#include "Protocol.h"
+
+using json = nlohmann::json;
+
+Client::Client(std::string socketPath) : socketPath(std::move(socketPath)) {}
+
+json Client::request(const json& request, const std::function<void(const char*, size_t)>& onData) {
+    int fd = Protocol::connectUnix(socketPath);
+    if (fd < 0) return json{{"error", "failed to connect to " + socketPath}};
+
+    json response = json{{"error", "connection closed by the server"}};
+
+    if (Protocol::sendLine(fd, request.dump())) {
+        FrameType type;
+        std::string payload;
+
+        while (Protocol::readFrame(fd, type, payload)) {
+            if (type == FRAME_DATA) {
+                onData(payload.data(), payload.size());
+                continue;
+            }
+
+            json parsed = json::parse(payload, nullptr, false);
+            if (!parsed.is_discarded()) response = parsed;
+            break;
+        }
+    }
+
+    close(fd);
+    return response;
+}
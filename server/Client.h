@@ -0,0 +1,18 @@
+#pragma once
+
+#include <functional>
+#include <string>
+
+#include "../lib/json.h"
+
+// Client side of the scan server protocol, used by `walker query`
+class Client {
+public:
+    explicit Client(std::string socketPath);
+
+    // sends a request and hands every data frame to onData, returns the summary or an error object
+    nlohmann::json request(const nlohmann::json& request, const std::function<void(const char*, size_t)>& onData);
+
+private:
+    std::string socketPath;
+};
@@ -0,0 +1,125 @@
+#include "Protocol.h"
+
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static bool fillAddress(const std::string& socketPath, sockaddr_un& address) {
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+
+    if (socketPath.size() >= sizeof(address.sun_path)) return false;
+
+    memcpy(address.sun_path, socketPath.c_str(), socketPath.size());
+    return true;
+}
+
+int Protocol::listenUnix(const std::string& socketPath) {
+    sockaddr_un address{};
+    if (!fillAddress(socketPath, address)) return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+
+    // a stale socket file from a previous server would make bind fail
+    unlink(socketPath.c_str());
+
+    if (bind(fd, (sockaddr*) &address, sizeof(address)) != 0 || listen(fd, 64) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+int Protocol::connectUnix(const std::string& socketPath) {
+    sockaddr_un address{};
+    if (!fillAddress(socketPath, address)) return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+
+    if (connect(fd, (sockaddr*) &address, sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+bool Protocol::sendFrame(int fd, FrameType type, const char* data, size_t size) {
+    char header[5];
+    auto length = (uint32_t) size;
+
+    header[0] = (char) type;
+    memcpy(header + 1, &length, sizeof(length));
+
+    return sendAll(fd, header, sizeof(header)) && sendAll(fd, data, size);
+}
+
+bool Protocol::sendFrame(int fd, FrameType type, const std::string& payload) {
+    return sendFrame(fd, type, payload.data(), payload.size());
+}
+
+bool Protocol::readFrame(int fd, FrameType& type, std::string& payload) {
+    char header[5];
+    uint32_t length;
+
+    if (!readAll(fd, header, sizeof(header))) return false;
+
+    type = (FrameType) header[0];
+    memcpy(&length, header + 1, sizeof(length));
+
+    payload.resize(length);
+    return readAll(fd, payload.data(), length);
+}
+
+bool Protocol::sendLine(int fd, const std::string& line) {
+    return sendAll(fd, line.data(), line.size()) && sendAll(fd, "\n", 1);
+}
+
+bool Protocol::readLine(int fd, std::string& line) {
+    line.clear();
+    char c;
+
+    // requests are small and read once per connection, byte reads are fine here
+    while (line.size() < MAX_REQUEST_SIZE) {
+        if (!readAll(fd, &c, 1)) return false;
+        if (c == '\n') return true;
+        line += c;
+    }
+
+    return false;
+}
+
+bool Protocol::sendAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+
+        data += sent;
+        size -= sent;
+    }
+
+    return true;
+}
+
+bool Protocol::readAll(int fd, char* data, size_t size) {
+    while (size > 0) {
+        ssize_t received = recv(fd, data, size, 0);
+
+        if (received < 0 && errno == EINTR) continue;
+        if (received <= 0) return false;
+
+        data += received;
+        size -= received;
+    }
+
+    return true;
+}
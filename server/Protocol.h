@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Wire protocol between `walker serve` and `walker query`, over a Unix domain socket.
+// The client sends one JSON request terminated by a newline, the server answers with frames:
+// a type byte, a 32-bit payload length and the payload.
+typedef enum : char {
+    FRAME_DATA = 'D',  // formatted results, in the requested output format
+    FRAME_END = 'E',   // JSON summary, last frame of a successful request
+    FRAME_ERROR = 'X'  // JSON error message, last frame of a failed request
+} FrameType;
+
+class Protocol {
+public:
+    static constexpr size_t MAX_REQUEST_SIZE = 16 * 1024 * 1024;
+
+    static int listenUnix(const std::string& socketPath);
+    static int connectUnix(const std::string& socketPath);
+
+    static bool sendFrame(int fd, FrameType type, const char* data, size_t size);
+    static bool sendFrame(int fd, FrameType type, const std::string& payload);
+    static bool readFrame(int fd, FrameType& type, std::string& payload);
+
+    static bool sendLine(int fd, const std::string& line);
+    static bool readLine(int fd, std::string& line);
+
+private:
+    static bool sendAll(int fd, const char* data, size_t size);
+    static bool readAll(int fd, char* data, size_t size);
+};
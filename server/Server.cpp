@@ -0,0 +1,211 @@
+#include "Server.h"
+
+#include <cerrno>
+#include <iostream>
+#include <thread>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "Protocol.h"
+#include "../scanner/Scanner.h"
+#include "../scanner/StructureParser.h"
+
+using json = nlohmann::json;
+
+Server::Server(std::string socketPath, size_t threadCount) : socketPath(std::move(socketPath)), pool(threadCount) {}
+
+Server::~Server() {
+    stop();
+
+    // connection threads use the caches and the pool
+    std::unique_lock<std::mutex> lock(connectionsMutex);
+    connectionsDone.wait(lock, [this] { return activeConnections == 0; });
+}
+
+bool Server::start() {
+    listenFd = Protocol::listenUnix(socketPath);
+    if (listenFd < 0) return false;
+
+    running = true;
+    return true;
+}
+
+void Server::run() {
+    while (running) {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            break;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(connectionsMutex);
+            activeConnections++;
+        }
+
+        std::thread([this, fd] {
+            handleConnection(fd);
+            close(fd);
+
+            std::lock_guard<std::mutex> lock(connectionsMutex);
+            activeConnections--;
+            connectionsDone.notify_all();
+        }).detach();
+    }
+
+    running = false;
+}
+
+void Server::stop() {
+    int fd = listenFd.exchange(-1);
+    if (fd < 0) return;
+
+    running = false;
+
+    // wakes up the accept loop
+    shutdown(fd, SHUT_RDWR);
+    close(fd);
+    unlink(socketPath.c_str());
+}
+
+void Server::handleConnection(int fd) {
+    std::string line;
+    if (!Protocol::readLine(fd, line)) return;
+
+    json request = json::parse(line, nullptr, false);
+
+    if (request.is_discarded() || !request.is_object()) {
+        Protocol::sendFrame(fd, FRAME_ERROR, json{{"error", "invalid request"}}.dump());
+        return;
+    }
+
+    std::string command = request.value("command", "scan");
+
+    try {
+        if (command == "scan") {
+            handleScan(fd, request);
+        } else if (command == "status") {
+            handleStatus(fd);
+        } else if (command == "shutdown") {
+            Protocol::sendFrame(fd, FRAME_END, json{{"stopping", true}}.dump());
+            stop();
+        } else {
+            Protocol::sendFrame(fd, FRAME_ERROR, json{{"error", "unknown command: " + command}}.dump());
+        }
+    } catch (const std::exception& e) {
+        Protocol::sendFrame(fd, FRAME_ERROR, json{{"error", e.what()}}.dump());
+    }
+}
+
+void Server::handleScan(int fd, const json& request) {
+    if (!request.contains("file") || !request.contains("structure")) {
+        Protocol::sendFrame(fd, FRAME_ERROR, json{{"error", "scan requests need a file and a structure"}}.dump());
+        return;
+    }
+
+    std::string path = request["file"].get<std::string>();
+    std::shared_ptr<MappedFile> dump = loadDump(path);
+
+    if (dump == nullptr) {
+        Protocol::sendFrame(fd, FRAME_ERROR, json{{"error", "failed to map file: " + path}}.dump());
+        return;
+    }
+
+    std::shared_ptr<const CompiledStructure> structure = loadStructure(request["structure"]);
+
+    if (structure->isEmpty()) {
+        Protocol::sendFrame(fd, FRAME_ERROR, json{{"error", "the structure has no valid field"}}.dump());
+        return;
+    }
+
+    ResultFormat format = ResultWriter::getFormatByName(request.value("format", "text"));
+
+    if (format == RESULT_FORMAT_NONE) {
+        Protocol::sendFrame(fd, FRAME_ERROR, json{{"error", "unknown output format"}}.dump());
+        return;
+    }
+
+    size_t maxResults = request.value("max_results", (size_t) 0);
+    bool countOnly = request.value("count", false);
+
+    Scanner scanner{};
+    scanner.setStructure(structure);
+    scanner.setView(dump->data(), dump->size());
+    scanner.setThreadPool(&pool);
+
+    // formatted results are streamed back in data frames as the writer flushes them
+    bool connected = true;
+    ResultWriter writer{[fd, &connected](const char* data, size_t size) {
+        connected = connected && Protocol::sendFrame(fd, FRAME_DATA, data, size);
+        return connected;
+    }, format, structure->getFields()};
+
+    CountingSink counter{};
+    WriterSink output{writer};
+    TeeSink outputs{countOnly ? std::vector<ResultSink*>{&counter} : std::vector<ResultSink*>{&counter, &output}};
+
+    // a client that went away stops the scan
+    CallbackSink guard{[&outputs, &connected](const ScannerResult& result) {
+        return connected && outputs.push(result);
+    }};
+    LimitSink limiter{guard, maxResults > 0 ? maxResults : SIZE_MAX};
+
+    scanner.scan(limiter);
+    writer.close();
+
+    if (connected) {
+        Protocol::sendFrame(fd, FRAME_END, json{{"count", counter.getCount()}, {"size", dump->size()}}.dump());
+    }
+}
+
+void Server::handleStatus(int fd) {
+    json status = {{"threads", pool.getThreadCount()}};
+
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+
+        status["dumps"] = json::array();
+        for (const auto& dump : dumps) {
+            status["dumps"].push_back({{"file", dump.first}, {"size", dump.second->size()}});
+        }
+
+        status["structures"] = structures.size();
+    }
+
+    Protocol::sendFrame(fd, FRAME_END, status.dump());
+}
+
+std::shared_ptr<MappedFile> Server::loadDump(const std::string& path) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+
+    auto it = dumps.find(path);
+
+    // a dump rewritten on disk is mapped again, running scans keep the previous mapping alive
+    if (it != dumps.end() && it->second->isUpToDate()) return it->second;
+
+    auto dump = std::make_shared<MappedFile>();
+
+    if (!dump->open(path)) {
+        if (it != dumps.end()) dumps.erase(it);
+        return nullptr;
+    }
+
+    dumps[path] = dump;
+    return dump;
+}
+
+std::shared_ptr<const CompiledStructure> Server::loadStructure(const json& definition) {
+    // object keys are sorted by the json library, so equivalent definitions share an entry
+    std::string key = definition.dump();
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+
+    auto it = structures.find(key);
+    if (it != structures.end()) return it->second;
+
+    auto structure = std::make_shared<const CompiledStructure>(StructureParser::parseJson(definition));
+    structures[key] = structure;
+
+    return structure;
+}
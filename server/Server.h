@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "../lib/json.h"
+#include "../scanner/CompiledStructure.h"
+#include "../scanner/MappedFile.h"
+#include "../scanner/ThreadPool.h"
+
+// Long-running scan server listening on a Unix domain socket.
+// Dumps stay mapped and structures stay compiled between requests, every connection is served
+// on its own thread while the scans themselves share one thread pool.
+class Server {
+public:
+    Server(std::string socketPath, size_t threadCount);
+    ~Server();
+
+    bool start();
+    void run();
+    void stop();
+
+private:
+    void handleConnection(int fd);
+    void handleScan(int fd, const nlohmann::json& request);
+    void handleStatus(int fd);
+
+    std::shared_ptr<MappedFile> loadDump(const std::string& path);
+    std::shared_ptr<const CompiledStructure> loadStructure(const nlohmann::json& definition);
+
+    std::string socketPath;
+    std::atomic<int> listenFd{-1};
+
+    ThreadPool pool;
+
+    std::mutex cacheMutex;
+    std::map<std::string, std::shared_ptr<MappedFile>> dumps;
+    std::map<std::string, std::shared_ptr<const CompiledStructure>> structures;
+
+    std::atomic<bool> running{false};
+    std::mutex connectionsMutex;
+    std::condition_variable connectionsDone;
+    size_t activeConnections = 0;
+};
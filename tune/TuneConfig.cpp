@@ -0,0 +1,136 @@
+#include "TuneConfig.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sys/stat.h>
+
+#include "../scanner/ThreadPool.h"
+
+std::string TuneConfig::defaultPath() {
+    const char* configured = getenv("WALKER_TUNE_FILE");
+    if (configured != nullptr && *configured != '\0') return configured;
+
+    const char* xdgConfig = getenv("XDG_CONFIG_HOME");
+    if (xdgConfig != nullptr && *xdgConfig != '\0') return std::string(xdgConfig) + "/walker/tune.json";
+
+    const char* home = getenv("HOME");
+    if (home != nullptr && *home != '\0') return std::string(home) + "/.config/walker/tune.json";
+
+    return "/tmp/walker-tune.json";
+}
+
+StructureClass TuneConfig::classify(const CompiledStructure& structure) {
+    bool hasEquality = false;
+
+    for (const ScannerField& field : structure.getFields()) {
+        for (const ScannerCriteria& criteria : field.criterias) {
+            if (criteria.type == SCANNER_CRITERIA_BYTES_MATCH || criteria.type == SCANNER_CRITERIA_BYTES_NOT_MATCH) return STRUCTURE_CLASS_PATTERN;
+            if (criteria.type == SCANNER_CRITERIA_EQUAL) hasEquality = true;
+        }
+    }
+
+    return hasEquality ? STRUCTURE_CLASS_ANCHORED : STRUCTURE_CLASS_RANGE;
+}
+
+std::string TuneConfig::getClassName(StructureClass structureClass) {
+    for (const auto& details : STRUCTURE_CLASS_DETAILS) {
+        if (std::get<StructureClass>(details) == structureClass) return std::get<std::string>(details);
+    }
+
+    return "unknown";
+}
+
+bool TuneConfig::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file.is_open()) return false;
+
+    json config = json::parse(file, nullptr, false);
+    if (config.is_discarded() || !config.is_object()) return false;
+    if (config.value("version", 0u) != VERSION) return false;
+
+    coreCount = config.value("cores", (size_t) 0);
+    const json& classes = config.value("classes", json::object());
+
+    for (const auto& details : STRUCTURE_CLASS_DETAILS) {
+        StructureClass structureClass = std::get<StructureClass>(details);
+        auto entry = classes.find(std::get<std::string>(details));
+
+        tuned[structureClass] = entry != classes.end() && entry->is_object();
+        if (!tuned[structureClass]) continue;
+
+        settings[structureClass].threads = entry->value("threads", (size_t) 0);
+        settings[structureClass].chunkSize = entry->value("chunk_size", (size_t) 0);
+        settings[structureClass].bytesPerSecond = entry->value("bytes_per_second", 0.0);
+        tuned[structureClass] = settings[structureClass].threads > 0 && settings[structureClass].chunkSize > 0;
+    }
+
+    return true;
+}
+
+// creates the missing parents of path, like mkdir -p on its directory
+static bool makeParentDirectories(const std::string& path) {
+    for (size_t position = 1; position < path.size(); position++) {
+        if (path[position] != '/') continue;
+
+        std::string parent = path.substr(0, position);
+        if (mkdir(parent.c_str(), 0755) != 0 && errno != EEXIST) return false;
+    }
+
+    return true;
+}
+
+bool TuneConfig::save(const std::string& path) const {
+    json classes = json::object();
+
+    for (const auto& details : STRUCTURE_CLASS_DETAILS) {
+        StructureClass structureClass = std::get<StructureClass>(details);
+        if (!tuned[structureClass]) continue;
+
+        classes[std::get<std::string>(details)] = {
+            { "threads", settings[structureClass].threads },
+            { "chunk_size", settings[structureClass].chunkSize },
+            { "bytes_per_second", settings[structureClass].bytesPerSecond }
+        };
+    }
+
+    json config = {
+        { "version", VERSION },
+        { "cores", coreCount },
+        { "classes", classes }
+    };
+
+    if (!makeParentDirectories(path)) return false;
+
+    // written aside and renamed, a scan starting meanwhile reads the old file or the new one
+    std::string temporary = path + ".tmp";
+
+    {
+        std::ofstream file(temporary, std::ios::trunc);
+        if (!file.is_open()) return false;
+
+        file << config.dump(4) << std::endl;
+        if (!file.good()) return false;
+    }
+
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool TuneConfig::get(StructureClass structureClass, TuneSettings& result) const {
+    if (structureClass >= STRUCTURE_CLASS_COUNT || !tuned[structureClass]) return false;
+    if (coreCount != ThreadPool::defaultThreadCount()) return false;
+
+    result = settings[structureClass];
+    return true;
+}
+
+void TuneConfig::set(StructureClass structureClass, const TuneSettings& result) {
+    settings[structureClass] = result;
+    tuned[structureClass] = true;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "../scanner/CompiledStructure.h"
+
+typedef enum {
+    STRUCTURE_CLASS_ANCHORED,
+    STRUCTURE_CLASS_RANGE,
+    STRUCTURE_CLASS_PATTERN,
+    STRUCTURE_CLASS_COUNT
+} StructureClass;
+
+// Details about each class of structure the scan settings are tuned for
+// { class, name }
+const std::vector<std::tuple<StructureClass, std::string>> STRUCTURE_CLASS_DETAILS = {
+    { STRUCTURE_CLASS_ANCHORED, "anchored" },
+    { STRUCTURE_CLASS_RANGE, "range" },
+    { STRUCTURE_CLASS_PATTERN, "pattern" }
+};
+
+// The scan settings measured fastest for a class of structures
+struct TuneSettings {
+    size_t threads = 0;
+    size_t chunkSize = 0;
+    double bytesPerSecond = 0;
+};
+
+// The settings chosen by `walker tune` for this machine, read by every scan.
+//
+// The file also records the number of cores it was measured with, settings measured on another
+// machine (a home directory shared between hosts) are not used.
+class TuneConfig {
+public:
+    static constexpr uint32_t VERSION = 1;
+
+    // $WALKER_TUNE_FILE, or walker/tune.json in the user config directory
+    static std::string defaultPath();
+
+    // structures with a pattern criteria are pattern-heavy, otherwise those with an equality are
+    // anchored on a constant, and the others only test ranges
+    static StructureClass classify(const CompiledStructure& structure);
+    static std::string getClassName(StructureClass structureClass);
+
+    bool load(const std::string& path);
+    bool save(const std::string& path) const;
+
+    // false when the class was not tuned, or was tuned on another machine
+    bool get(StructureClass structureClass, TuneSettings& settings) const;
+    void set(StructureClass structureClass, const TuneSettings& settings);
+
+    size_t getCoreCount() const { return coreCount; }
+    void setCoreCount(size_t cores) { coreCount = cores; }
+
+private:
+    size_t coreCount = 0;
+    TuneSettings settings[STRUCTURE_CLASS_COUNT]{};
+    bool tuned[STRUCTURE_CLASS_COUNT]{};
+};
@@ -0,0 +1,147 @@
+#include "Tuner.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <random>
+
+#include "../scanner/Scanner.h"
+#include "../scanner/StructureParser.h"
+
+static const size_t MIN_CHUNK_SIZE = 1024 * 1024;
+// smallest part of the dump measured, so chunk sizes can still be compared
+static const size_t MIN_MEASURE_SIZE = 8 * 1024 * 1024;
+
+Tuner::Tuner(size_t bufferSize, size_t repeat, uint64_t seed) : repeat(std::max<size_t>(repeat, 1)) {
+    std::mt19937_64 random {seed};
+
+    // words like those of a memory dump: zeros, small counters, heap pointers and noise
+    buffer.resize(bufferSize / 8 * 8);
+
+    for (size_t i = 0; i < buffer.size(); i += 8) {
+        uint64_t word = random();
+
+        switch (word % 10) {
+            case 0: case 1: case 2: case 3:
+                word = 0;
+                break;
+            case 4: case 5:
+                word = (word >> 8) % 4096;
+                break;
+            case 6: case 7:
+                word = 0x00007f0000000000ULL | ((word >> 8) & 0xfffffffff8ULL);
+                break;
+            default:
+                break;
+        }
+
+        memcpy(buffer.data() + i, &word, sizeof(word));
+    }
+}
+
+std::shared_ptr<CompiledStructure> Tuner::calibrationStructure(StructureClass structureClass) {
+    json fields;
+
+    switch (structureClass) {
+        case STRUCTURE_CLASS_ANCHORED:
+            fields = json::parse(R"([
+                { "type": "uint32", "criterias": [ { "type": "eq", "value": 322420463 } ] },
+                { "type": "pointer", "criterias": [ { "type": "notnullptr" } ] },
+                { "type": "uint64", "criterias": [ { "type": "any" } ] }
+            ])");
+            break;
+        case STRUCTURE_CLASS_RANGE:
+            fields = json::parse(R"([
+                { "type": "uint32", "criterias": [ { "type": "gte", "value": 1 }, { "type": "lte", "value": 4096 } ] },
+                { "type": "uint32", "criterias": [ { "type": "lt", "value": 65536 } ] },
+                { "type": "pointer", "criterias": [ { "type": "notnullptr" } ] }
+            ])");
+            break;
+        default:
+            fields = json::parse(R"([
+                { "type": "bytes", "size": 12, "criterias": [ { "type": "match", "value": "48 8B 05 ?? ?? ?? ?? 48 85 C0 74 ??" } ] },
+                { "type": "bytes", "size": 8, "criterias": [ { "type": "not_match", "value": "00 00 00 00 00 00 00 00" } ] }
+            ])");
+            break;
+    }
+
+    return std::make_shared<CompiledStructure>(StructureParser::parseJson(fields));
+}
+
+std::vector<size_t> Tuner::threadCandidates(size_t cores) {
+    std::vector<size_t> candidates;
+
+    for (size_t threads = 1; threads < cores; threads *= 2) candidates.push_back(threads);
+    candidates.push_back(std::max<size_t>(cores, 1));
+
+    return candidates;
+}
+
+std::vector<size_t> Tuner::chunkCandidates(size_t threads, size_t length) {
+    std::vector<size_t> candidates;
+    size_t largest = std::max(MIN_CHUNK_SIZE, length / std::max<size_t>(threads, 1));
+
+    for (size_t chunkSize = MIN_CHUNK_SIZE; chunkSize <= largest; chunkSize *= 4) candidates.push_back(chunkSize);
+
+    return candidates;
+}
+
+double Tuner::measure(const std::shared_ptr<const CompiledStructure>& structure, size_t length, size_t threads, size_t chunkSize, size_t runs) {
+    Scanner scanner;
+    scanner.setStructure(structure);
+    scanner.setView((const uint8_t*) buffer.data(), length);
+
+    if (threads > 1) {
+        std::unique_ptr<ThreadPool>& pool = pools[threads];
+        if (!pool) pool = std::make_unique<ThreadPool>(threads);
+
+        scanner.setThreadPool(pool.get(), chunkSize);
+    }
+
+    double best = 0;
+
+    for (size_t i = 0; i < runs; i++) {
+        CountingSink sink{};
+
+        auto start = std::chrono::steady_clock::now();
+        scanner.scan(sink);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (seconds > 0) best = std::max(best, length / seconds);
+    }
+
+    return best;
+}
+
+TuneSettings Tuner::tune(StructureClass structureClass, const std::function<void(const TuneMeasure&)>& onMeasure) {
+    std::shared_ptr<CompiledStructure> structure = calibrationStructure(structureClass);
+    TuneSettings best {1, Scanner::DEFAULT_CHUNK_SIZE, 0};
+    size_t cores = ThreadPool::defaultThreadCount();
+
+    // enough bytes for every thread to scan about MEASURE_SECONDS
+    double probe = measure(structure, std::min(MIN_CHUNK_SIZE, buffer.size()), 1, MIN_CHUNK_SIZE, 1);
+    size_t length = (size_t) std::min<double>(buffer.size(), std::max<double>(MIN_MEASURE_SIZE, probe * MEASURE_SECONDS * cores)) / 8 * 8;
+
+    auto consider = [&](size_t threads, size_t chunkSize) {
+        double bytesPerSecond = measure(structure, length, threads, chunkSize, repeat);
+        if (onMeasure) onMeasure(TuneMeasure{ structureClass, threads, chunkSize, bytesPerSecond });
+
+        if (bytesPerSecond > best.bytesPerSecond) best = TuneSettings{ threads, chunkSize, bytesPerSecond };
+    };
+
+    for (size_t threads : threadCandidates(cores)) {
+        consider(threads, std::min(Scanner::DEFAULT_CHUNK_SIZE, std::max(MIN_CHUNK_SIZE, length / threads)));
+    }
+
+    // a single thread scans the buffer at once, the chunk size does not apply
+    if (best.threads > 1) {
+        size_t threads = best.threads;
+        size_t measured = best.chunkSize;
+
+        for (size_t chunkSize : chunkCandidates(threads, length)) {
+            if (chunkSize != measured) consider(threads, chunkSize);
+        }
+    }
+
+    return best;
+}
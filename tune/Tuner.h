@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "../scanner/CompiledStructure.h"
+#include "../scanner/ThreadPool.h"
+
+#include "TuneConfig.h"
+
+// One measured configuration
+struct TuneMeasure {
+    StructureClass structureClass;
+    size_t threads;
+    size_t chunkSize;
+    double bytesPerSecond;
+};
+
+// Finds the fastest thread count and chunk size of each structure class on this machine, by
+// scanning a synthetic dump in memory with a representative structure of the class.
+//
+// The powers of two below the number of cores and the number of cores are measured with the default
+// chunk size, then every chunk size with the fastest thread count. Each measure keeps the best of a few scans. A
+// first scan of 1 MiB sizes the part of the dump scanned for a class, so that a measure takes
+// about MEASURE_SECONDS even for slow structures.
+class Tuner {
+public:
+    static constexpr size_t DEFAULT_BUFFER_SIZE = 256 * 1024 * 1024;
+    static constexpr size_t DEFAULT_REPEAT = 3;
+    static constexpr double MEASURE_SECONDS = 0.5;
+
+    Tuner(size_t bufferSize, size_t repeat, uint64_t seed = 1);
+
+    // the structure scanned to tune a class
+    static std::shared_ptr<CompiledStructure> calibrationStructure(StructureClass structureClass);
+
+    // 1, 2, 4... below cores, and cores itself
+    static std::vector<size_t> threadCandidates(size_t cores);
+    // the chunk sizes worth trying for length bytes, from 1 MiB to a chunk per thread
+    static std::vector<size_t> chunkCandidates(size_t threads, size_t length);
+
+    TuneSettings tune(StructureClass structureClass, const std::function<void(const TuneMeasure&)>& onMeasure = nullptr);
+
+private:
+    double measure(const std::shared_ptr<const CompiledStructure>& structure, size_t length, size_t threads, size_t chunkSize, size_t runs);
+
+    std::vector<char> buffer;
+    size_t repeat;
+
+    // created once per thread count, the threads are started outside the measures
+    std::map<size_t, std::unique_ptr<ThreadPool>> pools;
+};